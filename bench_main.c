@@ -0,0 +1,327 @@
+/*
+ * Benchmarks of the tester's own hot paths.
+ * Every result is a line "<name> <value> <unit>", medians of several rounds,
+ * so the output can be compared from build to build.
+ * Build and run it by: make bench
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "consts.h"
+#include "libsys.h"
+#include "libprocs.h"
+#include "compare.h"
+#include "store.h"
+#include "file.h"
+#include "runtime.h"
+#include "judge.h"
+
+#define ROUNDS			7
+#define SPAWNS			200
+#define FOLDER_FILES	2000
+#define SUITE_CASES		200
+#define TRIVIAL_PROG	"/bin/cat"
+
+extern int Verbose_mode;
+
+static char work_dir[ FILE_NAME_LEN + 1 ];
+
+static double now_us()
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double( const void* a, const void* b )
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : ( x > y );
+}
+
+static double median( double* v, int n )
+{
+    qsort( v, n, sizeof( double ), cmp_double );
+    return n % 2 ? v[ n / 2 ] : ( v[ n / 2 - 1 ] + v[ n / 2 ] ) / 2;
+}
+
+static void report( const char* name, double value, const char* unit )
+{
+    printf( "%-36s %14.3f %s\n", name, value, unit );
+    fflush( stdout );
+}
+
+static int write_file( const char* fname, const char* data, long long len )
+{
+    long long done;
+    int fd, ret;
+
+    if ( ( fd = open( fname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR ) ) == -1 )
+        return 0;
+
+    for ( done = 0; done < len; done += ret )
+        if ( ( ret = write( fd, data + done, len - done ) ) <= 0 ) break;
+
+    close( fd );
+    return done == len;
+}
+
+/*
+ * Microseconds per run, through run_program() and by a bare fork/exec/wait.
+ */
+static void bench_spawn()
+{
+    char* argv[2] = { TRIVIAL_PROG, NULL };
+    double sup[ ROUNDS ], bare[ ROUNDS ], t;
+    struct RESCONS rc = { 10000, 1 << 20, 0 };
+    struct RESUSE ru;
+    int i, r, ret, fd;
+    pid_t pid;
+
+    for ( r = 0; r < ROUNDS; ++r ) {
+        t = now_us();
+        for ( i = 0; i < SPAWNS; ++i )
+            run_program( argv[0], "/dev/null", "/dev/null", NULL,
+                         &rc, &ru, &ret, argv );
+        sup[r] = ( now_us() - t ) / SPAWNS;
+
+        t = now_us();
+        for ( i = 0; i < SPAWNS; ++i ) {
+            if ( ( pid = fork() ) == 0 ) {
+                // The same standard files as run_program gives
+                fd = open( "/dev/null", O_RDWR );
+                dup2( fd, 0 );
+                dup2( fd, 1 );
+                execvp( argv[0], argv );
+                _exit( -1 );
+            }
+            waitpid( pid, &ret, 0 );
+        }
+        bare[r] = ( now_us() - t ) / SPAWNS;
+    }
+
+    report( "spawn.run_program", median( sup, ROUNDS ), "us/run" );
+    report( "spawn.bare_exec", median( bare, ROUNDS ), "us/run" );
+    report( "spawn.supervision_overhead",
+            median( sup, ROUNDS ) - median( bare, ROUNDS ), "us/run" );
+}
+
+// Numbers separated by spaces and newlines, about len bytes
+static char* make_tokens( long long len, long long* plen )
+{
+    char* buf;
+    long long n = 0;
+    int k = 0;
+
+    if ( ( buf = ( char* )malloc( len + 32 ) ) == NULL ) return NULL;
+
+    while ( n < len ) {
+        n += sprintf( buf + n, "%d.%03d%c", k * 7919 % 100000, k % 1000,
+                      k % 10 == 9 ? '\n' : ' ' );
+        ++k;
+    }
+
+    *plen = n;
+    return buf;
+}
+
+/*
+ * MB/s of every comparator and of the answer digest, by size.
+ */
+static void bench_compare()
+{
+    static const long long sizes[] = { 64 << 10, 1 << 20, 16 << 20 };
+    static const char* modes[] = { "token", "float", "lines" };
+    struct cmp_opt_t opt;
+    struct answer_hash_t h;
+    struct answer_t a;
+    char name[64], *std, *out;
+    double v[ ROUNDS ], t;
+    long long len;
+    int i, m, r;
+
+    for ( i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++i ) {
+        if ( ( std = make_tokens( sizes[i], &len ) ) == NULL ) return;
+        if ( ( out = ( char* )malloc( len ) ) == NULL ) {
+            free( std );
+            return;
+        }
+        memcpy( out, std, len );
+
+        for ( m = 0; m < sizeof( modes ) / sizeof( modes[0] ); ++m ) {
+            parse_compare_mode( modes[m], &opt );
+
+            for ( r = 0; r < ROUNDS; ++r ) {
+                t = now_us();
+                compare_buffers( std, len, out, len, &opt );
+                v[r] = len / ( now_us() - t );
+            }
+
+            sprintf( name, "compare.%s.%lldKB", modes[m], sizes[i] >> 10 );
+            report( name, median( v, ROUNDS ), "MB/s" );
+        }
+
+        for ( r = 0; r < ROUNDS; ++r ) {
+            t = now_us();
+            answer_hash_init( &h );
+            answer_hash_update( &h, out, len );
+            answer_hash_final( &h, &a );
+            v[r] = len / ( now_us() - t );
+        }
+
+        sprintf( name, "compare.digest.%lldKB", sizes[i] >> 10 );
+        report( name, median( v, ROUNDS ), "MB/s" );
+
+        free( std );
+        free( out );
+    }
+}
+
+/*
+ * Files/s through get_next_file() and map_file().
+ */
+static void bench_folder()
+{
+    char in_dir[ FILE_NAME_LEN + 1 ], out_dir[ FILE_NAME_LEN + 1 ];
+    char path[ FILE_NAME_LEN + 1 ], fout[ FILE_NAME_LEN + 1 ];
+    struct dir_info_t *di_in, *di_out;
+    struct suf_pat_t* psuf;
+    double v[ ROUNDS ], t;
+    int i, r, n;
+
+    sprintf( in_dir, "%s/fin", work_dir );
+    sprintf( out_dir, "%s/fout", work_dir );
+    if ( ( di_in = open_folder( in_dir ) ) == NULL ) return;
+    if ( ( di_out = open_folder( out_dir ) ) == NULL ) {
+        close_folder( di_in );
+        return;
+    }
+
+    for ( i = 0; i < FOLDER_FILES; ++i ) {
+        sprintf( path, "%s/case%d.in", in_dir, i );
+        write_file( path, "1 2\n", 4 );
+        sprintf( path, "%s/case%d.out", out_dir, i );
+        write_file( path, "3\n", 2 );
+    }
+
+    psuf = detect_pattern( in_dir, out_dir );
+
+    for ( r = 0; r < ROUNDS; ++r ) {
+        reopen_folder( di_in );
+        t = now_us();
+        for ( n = 0; get_next_file( di_in, path ); ++n )
+            if ( psuf != NULL )
+                map_file( psuf, di_out -> folder_name, path, fout );
+        v[r] = n / ( now_us() - t ) * 1e6;
+    }
+
+    report( "folder.iterate", median( v, ROUNDS ), "files/s" );
+
+    close_pattern( psuf );
+    close_folder( di_in );
+    close_folder( di_out );
+}
+
+/*
+ * Cases/s of a whole judge run, a trivial program against a folder suite.
+ */
+static void bench_judge( const char* mode_name, int checker )
+{
+    struct sys_arg_t arg;
+    char in_dir[ FILE_NAME_LEN + 1 ], out_dir[ FILE_NAME_LEN + 1 ];
+    char tmp_dir[ FILE_NAME_LEN + 1 ], path[ FILE_NAME_LEN + 1 ];
+    char name[64];
+    double v[ ROUNDS ], t;
+    int i, r, fd_stdout, fd_null;
+
+    sprintf( in_dir, "%s/sin", work_dir );
+    sprintf( out_dir, "%s/sout", work_dir );
+    sprintf( tmp_dir, "%s/stmp", work_dir );
+
+    memset( &arg, 0, sizeof( arg ) );
+    arg.res_cons.time_limit = 10000;
+    arg.res_cons.mem_limit = 1 << 20;
+    arg.num_of_progs = 1;
+    arg.in_fd = arg.out_fd = -1;
+    arg.progs = malloc2d( 1, FILE_NAME_LEN );
+    arg.resp = ( struct RESUSE** )malloc2d( 1, sizeof( struct RESUSE ) );
+    arg.cmp_opt.mode = CMP_TOKEN;
+
+    if ( arg.progs == NULL || arg.resp == NULL || !runtime_open( &arg ) ||
+         ( arg.di_in = open_folder( in_dir ) ) == NULL ||
+         ( arg.di_out = open_folder( out_dir ) ) == NULL ||
+         ( arg.di_temp = open_folder( tmp_dir ) ) == NULL ) return;
+
+    strcpy( arg.progs[0], TRIVIAL_PROG );
+
+    for ( i = 0; i < SUITE_CASES; ++i ) {
+        sprintf( path, "%s/c%d.in", in_dir, i );
+        sprintf( name, "%d %d\n", i, i * 3 );
+        write_file( path, name, strlen( name ) );
+        sprintf( path, "%s/c%d.out", out_dir, i );
+        write_file( path, name, strlen( name ) );
+    }
+
+    arg.sp_inout = detect_pattern( in_dir, out_dir );
+    load_input( &arg, INPUT_BY_FOLDER );
+    load_res_gen( &arg, RESULT_BY_FOLDER );
+    load_checker( &arg, checker );
+
+    // The verdicts are not wanted here
+    fflush( stdout );
+    fd_stdout = dup( 1 );
+    fd_null = open( "/dev/null", O_WRONLY );
+
+    for ( r = 0; r < ROUNDS; ++r ) {
+        reopen_folder( arg.di_in );
+        arg.passed_cases = 0;
+
+        dup2( fd_null, 1 );
+        t = now_us();
+        judge( &arg );
+        fflush( stdout );
+        v[r] = arg.passed_cases / ( now_us() - t ) * 1e6;
+        dup2( fd_stdout, 1 );
+    }
+    close( fd_stdout );
+    close( fd_null );
+
+    sprintf( name, "judge.%s", mode_name );
+    report( name, median( v, ROUNDS ), "cases/s" );
+
+    runtime_close( &arg );
+    unstage_file( &arg.in_fd );
+    unstage_file( &arg.out_fd );
+    close_pattern( arg.sp_inout );
+    close_folder( arg.di_in );
+    close_folder( arg.di_out );
+    close_folder( arg.di_temp );
+    free2d( arg.progs, 1 );
+    free2d( (char**)arg.resp, 1 );
+}
+
+int main( int argc, char** argv )
+{
+    sprintf( work_dir, "bench_%d", getpid() );
+    if ( mkdir( work_dir, S_IRWXU ) == -1 ) {
+        fprintf( stderr, "Create %s failed.\n", work_dir );
+        return -1;
+    }
+
+    bench_spawn();
+    bench_compare();
+    bench_folder();
+    bench_judge( "diff", CHECK_BY_COMPARISON );
+    bench_judge( "token", CHECK_BY_TOKENS );
+
+    remove_folder( work_dir );
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * The interface of in-process special judges.
+ * Build a checker as a shared object exporting these symbols, e.g.
+ *   gcc -shared -fPIC my_spj.c -o my_spj.so
+ * and pass it by -j, tester loads it once and calls it for every case.
+ * By richardxx, 2009.6
+ */
+
+#ifndef CHECKER_H
+#define CHECKER_H
+
+/*
+ * A read only view of a file.
+ * data maps the whole file, len is its length;
+ * fd is positioned at the beginning, or -1 if the file is not available.
+ */
+struct checker_view_t
+{
+    int fd;
+    const char* data;
+    long long len;
+};
+
+/*
+ * Optional, called once after loading.
+ * Return 0 if the checker is ready.
+ */
+typedef int (*FP_CHECKER_INIT)( void );
+
+/*
+ * Mandatory, judge one case.
+ * Arg1 is the input, Arg2 the standard answer (may be unavailable), Arg3 the output.
+ * Return RES_AC, RES_WA or RES_PE of libprocs.h, anything else is treated as a checker error.
+ */
+typedef int (*FP_CHECKER_CHECK)( const struct checker_view_t*,
+                                 const struct checker_view_t*,
+                                 const struct checker_view_t* );
+
+/*
+ * Optional, called once before unloading.
+ */
+typedef void (*FP_CHECKER_FINI)( void );
+
+#define CHECKER_INIT_SYM	"checker_init"
+#define CHECKER_CHECK_SYM	"checker_check"
+#define CHECKER_FINI_SYM	"checker_fini"
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Token and line comparators.
+ * The buffers are scanned once, tokens are never copied except
+ * the few bytes needed to parse a number.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libprocs.h"
+#include "compare.h"
+
+#define NUMBER_LEN		64
+
+#define IS_SPACE( c )	( (c) == ' ' || (c) == '\n' || (c) == '\t' || \
+						  (c) == '\r' || (c) == '\v' || (c) == '\f' )
+
+/*
+ * A line in a buffer.
+ */
+struct line_t
+{
+    const char* p;
+    long long len;
+};
+
+/*
+ * Find the next token starting from *Arg3.
+ * Return 0 if there's none left.
+ */
+static int
+next_token( const char* buf, long long len, long long* pos,
+            const char** tok, long long* tlen )
+{
+    long long i = *pos, beg;
+
+    while ( i < len && IS_SPACE( buf[i] ) ) ++i;
+    if ( i == len ) {
+        *pos = i;
+        return 0;
+    }
+
+    for ( beg = i; i < len && !IS_SPACE( buf[i] ); ++i );
+
+    *tok = buf + beg;
+    *tlen = i - beg;
+    *pos = i;
+    return 1;
+}
+
+// Parse a whole token as a number
+static int to_number( const char* tok, long long len, double* pv )
+{
+    char num[ NUMBER_LEN ], *end;
+
+    if ( len >= NUMBER_LEN ) return 0;
+    memcpy( num, tok, len );
+    num[len] = 0;
+
+    *pv = strtod( num, &end );
+    return end == num + len && isfinite( *pv );
+}
+
+static int
+same_token( const char* t1, long long l1,
+            const char* t2, long long l2,
+            const struct cmp_opt_t* opt )
+{
+    double v1, v2, diff;
+
+    if ( l1 == l2 && memcmp( t1, t2, l1 ) == 0 ) return 1;
+    if ( opt -> mode != CMP_FLOAT ) return 0;
+
+    if ( !to_number( t1, l1, &v1 ) || !to_number( t2, l2, &v2 ) ) return 0;
+
+    diff = fabs( v1 - v2 );
+    return diff <= opt -> eps || diff <= opt -> eps * fabs( v1 );
+}
+
+static int
+compare_tokens( const char* std, long long std_len,
+                const char* out, long long out_len,
+                const struct cmp_opt_t* opt )
+{
+    long long p1 = 0, p2 = 0, l1, l2;
+    const char *t1, *t2;
+    int r1, r2;
+
+    while ( 1 ) {
+        r1 = next_token( std, std_len, &p1, &t1, &l1 );
+        r2 = next_token( out, out_len, &p2, &t2, &l2 );
+
+        if ( r1 != r2 ) return RES_WA;
+        if ( r1 == 0 ) break;
+        if ( !same_token( t1, l1, t2, l2, opt ) ) return RES_WA;
+    }
+
+    return RES_AC;
+}
+
+static int cmp_line( const void* a, const void* b )
+{
+    const struct line_t *l1 = a, *l2 = b;
+    int ret;
+
+    ret = memcmp( l1 -> p, l2 -> p, l1 -> len < l2 -> len ? l1 -> len : l2 -> len );
+    if ( ret != 0 ) return ret;
+
+    return l1 -> len < l2 -> len ? -1 : ( l1 -> len > l2 -> len );
+}
+
+/*
+ * Split into lines with trailing blanks removed, blank lines are dropped.
+ * Return the number of lines, -1 if out of memory.
+ */
+static long long
+split_lines( const char* buf, long long len, struct line_t** plines )
+{
+    struct line_t* lines;
+    long long i, beg, end, n, cap;
+
+    for ( cap = 1, i = 0; i < len; ++i )
+        if ( buf[i] == '\n' ) ++cap;
+
+    lines = ( struct line_t* )malloc( cap * sizeof( struct line_t ) );
+    if ( lines == NULL ) return -1;
+
+    for ( n = 0, beg = 0; beg < len; beg = i + 1 ) {
+        for ( i = beg; i < len && buf[i] != '\n'; ++i );
+
+        for ( end = i; end > beg && IS_SPACE( buf[ end - 1 ] ); --end );
+        if ( end == beg ) continue;
+
+        lines[n].p = buf + beg;
+        lines[n].len = end - beg;
+        ++n;
+    }
+
+    *plines = lines;
+    return n;
+}
+
+static int
+compare_lines( const char* std, long long std_len,
+               const char* out, long long out_len )
+{
+    struct line_t *l1 = NULL, *l2 = NULL;
+    long long n1, n2, i;
+    int res = RES_AC;
+
+    n1 = split_lines( std, std_len, &l1 );
+    n2 = split_lines( out, out_len, &l2 );
+
+    if ( n1 < 0 || n2 < 0 ) res = RES_VE;
+    else if ( n1 != n2 ) res = RES_WA;
+    else {
+        qsort( l1, n1, sizeof( struct line_t ), cmp_line );
+        qsort( l2, n2, sizeof( struct line_t ), cmp_line );
+
+        for ( i = 0; i < n1; ++i )
+            if ( cmp_line( l1 + i, l2 + i ) != 0 ) {
+                res = RES_WA;
+                break;
+            }
+    }
+
+    free( l1 );
+    free( l2 );
+    return res;
+}
+
+int parse_compare_mode( const char* desc, struct cmp_opt_t* opt )
+{
+    opt -> eps = DEFAULT_EPS;
+
+    if ( strcmp( desc, "diff" ) == 0 ) opt -> mode = CMP_DIFF;
+    else if ( strcmp( desc, "token" ) == 0 ) opt -> mode = CMP_TOKEN;
+    else if ( strcmp( desc, "lines" ) == 0 ) opt -> mode = CMP_LINES;
+    else if ( strncmp( desc, "float", 5 ) == 0 ) {
+        opt -> mode = CMP_FLOAT;
+        if ( desc[5] == '=' ) opt -> eps = atof( desc + 6 );
+        else if ( desc[5] != 0 ) return 0;
+        if ( opt -> eps < 0 ) return 0;
+    }
+    else
+        return 0;
+
+    return 1;
+}
+
+int compare_buffers( const char* std, long long std_len,
+                     const char* out, long long out_len,
+                     const struct cmp_opt_t* opt )
+{
+    if ( opt -> mode == CMP_LINES )
+        return compare_lines( std, std_len, out, out_len );
+
+    return compare_tokens( std, std_len, out, out_len, opt );
+}
@@ -0,0 +1,41 @@
+/*
+ * Built-in output comparison, without spawning anything.
+ * All comparators work on whole files mapped in memory.
+ * By richardxx, 2009.6
+ */
+
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#define CMP_DIFF		0		// byte-exact by 'diff', the default
+#define CMP_TOKEN		1		// whitespace separated tokens, exact
+#define CMP_FLOAT		2		// tokens, numbers within an epsilon
+#define CMP_LINES		3		// the same lines in any order
+
+#define DEFAULT_EPS		1e-6
+
+struct cmp_opt_t
+{
+    int mode;
+    
+    // Absolute or relative error allowed in CMP_FLOAT mode
+    double eps;
+};
+
+/*
+ * Parse a mode description: diff, token, float[=EPS] or lines.
+ * Return 0 if it is not recognized, otherwise 1.
+ */
+extern int
+parse_compare_mode( const char*, struct cmp_opt_t* );
+
+/*
+ * Compare an output (Arg3, Arg4) to the standard answer (Arg1, Arg2).
+ * Return RES_AC or RES_WA, RES_VE if out of memory.
+ */
+extern int
+compare_buffers( const char*, long long,
+                 const char*, long long,
+                 const struct cmp_opt_t* );
+
+#endif
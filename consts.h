@@ -14,5 +14,27 @@
 
 #define VERSION				"Build 2.0 final"
 #define TESTER_RC			".auto_tester_rc.txt"
+#define TESTER_JOURNAL		".tester_journal"
+#define WORKER_CACHE_DIR	".tester_cache"
+#define PCH_CACHE_DIR		WORKER_CACHE_DIR "/pch"
+
+// Workers serve the loopback unless told a host, and admit only who knows the secret
+#define DEFAULT_WORKER_HOST	"127.0.0.1"
+#define WORKER_SECRET_ENV	"TESTER_SECRET"
+
+// Default limits of the tested programs, ms and KB
+#define DEFAULT_WAIT_TIME	10000
+#define DEFAULT_MEMORY_SIZE	( ~(1 << (sizeof(int) * 8 - 1) ) >> 10 )
+#define DEFAULT_OUTPUT_SIZE	( 256 << 10 )
+
+// Re-runs of a noisy isolated run
+#define DEFAULT_RERUNS		3
+
+// Cases of a run, and runs of the null program measuring the launch overhead
+#define DEFAULT_RUNS		10
+#define DEFAULT_CALIB_RUNS	100
+
+// Least time limit (ms) of a relative limit
+#define DEFAULT_TIME_FLOOR	100
 
 #endif
@@ -0,0 +1,1220 @@
+/*
+ * Coordinator/worker protocol, one text line per request:
+ *
+ *   (from the worker) HELLO <nonce>
+ *   AUTH <hash of the nonce and the secret>
+ *                                    -> OK, otherwise the connection is closed
+ *   HAVE <hash>                      -> YES | NO
+ *   PUT <hash> <length>, raw bytes   -> OK | ERR
+ *   JOB <progs> <std> <time> <mem> <output> <checker hash | -> <check mode> <compare mode> <eps>
+ *                                    (check mode is a CHECK_BY_* of runtime.h)
+ *   PROG <hash>                      (one per program)
+ *   CASE <id> <input hash> <output hash | ->
+ *                                    (hashes of compressed files carry the suffix, e.g. <hash>.gz)
+ *   END                              -> RES <id> <prog> <result> <time> <mem> <output> ... DONE
+ *
+ * Nothing is taken from a coordinator before it proves it knows the secret
+ * shared through $TESTER_SECRET.
+ * Workers fork a session for every connection, so one worker host serves
+ * several coordinators at once.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include "consts.h"
+#include "hash.h"
+#include "file.h"
+#include "libsys.h"
+#include "libprocs.h"
+#include "runtime.h"
+#include "judge.h"
+#include "report.h"
+#include "scratch.h"
+#include "dist.h"
+
+#define LINE_LEN		( FILE_NAME_LEN + 256 )
+#define CHUNK_SIZE		65536
+#define SYNC_BATCH		256
+#define MAX_WORKERS		64
+#define NO_HASH			"-"
+
+extern int Verbose_mode;
+
+/*
+ * Buffered end of a connection.
+ */
+struct conn_t
+{
+    int fd;
+    int beg, end;
+    char buf[ CHUNK_SIZE ];
+};
+
+/*
+ * A case known by the coordinator.
+ */
+struct dist_case_t
+{
+    char *name, *in_path, *out_path;
+    int generated;
+    unsigned long long seed;
+    char in_hash[ HASH_HEX_LEN + 1 ];
+    char out_hash[ HASH_HEX_LEN + 1 ];
+};
+
+/*
+ * A case received by a worker.
+ */
+struct job_case_t
+{
+    int id;
+    char in_hash[ HASH_HEX_LEN + 1 ];
+    char out_hash[ HASH_HEX_LEN + 1 ];
+    char in_name[ HASH_HEX_LEN + SUFFIX_LEN + 1 ];
+    char out_name[ HASH_HEX_LEN + SUFFIX_LEN + 1 ];
+};
+
+struct dist_res_t
+{
+    int res, time, mem;
+    long long out;
+    int got;
+};
+
+struct worker_t
+{
+    char host[ OPTION_LEN + 1 ];
+    char port[ 16 ];
+    struct conn_t* conn;
+    const int* ids;         // The cases of its shard, ascending
+    int num;
+    int done, lost;
+};
+
+
+// =================== Connection ===================
+
+static struct conn_t* conn_open( int fd )
+{
+    struct conn_t* c;
+
+    c = ( struct conn_t* )malloc( sizeof( struct conn_t ) );
+    if ( c == NULL ) return NULL;
+
+    c -> fd = fd;
+    c -> beg = c -> end = 0;
+    return c;
+}
+
+static void conn_close( struct conn_t* c )
+{
+    if ( c == NULL ) return;
+    close( c -> fd );
+    free( c );
+}
+
+static int send_all( int fd, const char* p, int len )
+{
+    int ret;
+
+    while ( len > 0 ) {
+        ret = send( fd, p, len, MSG_NOSIGNAL );
+        if ( ret == -1 ) {
+            if ( errno == EINTR ) continue;
+            return 0;
+        }
+        p += ret;
+        len -= ret;
+    }
+
+    return 1;
+}
+
+static int send_line( struct conn_t* c, const char* fmt, ... )
+{
+    char line[ LINE_LEN ];
+    va_list args;
+    int len;
+
+    va_start( args, fmt );
+    len = vsnprintf( line, LINE_LEN, fmt, args );
+    va_end( args );
+
+    if ( len < 0 || len >= LINE_LEN ) return 0;
+    return send_all( c -> fd, line, len );
+}
+
+// Read more data into the buffer, return 0 on EOF or error
+static int conn_fill( struct conn_t* c )
+{
+    int ret;
+
+    if ( c -> beg > 0 ) {
+        memmove( c -> buf, c -> buf + c -> beg, c -> end - c -> beg );
+        c -> end -= c -> beg;
+        c -> beg = 0;
+    }
+
+    if ( c -> end == CHUNK_SIZE ) return 0;
+
+    do {
+        ret = recv( c -> fd, c -> buf + c -> end, CHUNK_SIZE - c -> end, 0 );
+    } while ( ret == -1 && errno == EINTR );
+
+    if ( ret <= 0 ) return 0;
+    c -> end += ret;
+    return 1;
+}
+
+static int conn_has_line( struct conn_t* c )
+{
+    return memchr( c -> buf + c -> beg, '\n', c -> end - c -> beg ) != NULL;
+}
+
+/*
+ * Read a line without the trailing '\n'.
+ * Return the length, or -1 when the peer is gone.
+ */
+static int recv_line( struct conn_t* c, char* line, int len )
+{
+    char* p;
+    int n;
+
+    while ( ( p = memchr( c -> buf + c -> beg, '\n',
+                          c -> end - c -> beg ) ) == NULL ) {
+        if ( !conn_fill( c ) ) return -1;
+    }
+
+    n = p - ( c -> buf + c -> beg );
+    if ( n >= len ) n = len - 1;
+    memcpy( line, c -> buf + c -> beg, n );
+    line[n] = 0;
+    c -> beg = p - c -> buf + 1;
+
+    return n;
+}
+
+// Move Arg3 bytes from the connection to a file, digesting them on the way
+static int recv_to_file( struct conn_t* c, int fd, long long len, char* hex )
+{
+    struct hash_ctx_t ctx;
+    unsigned char digest[ HASH_LEN ];
+    int n, ok = 1;
+
+    hash_init( &ctx );
+    while ( len > 0 ) {
+        if ( c -> beg == c -> end && !conn_fill( c ) ) return 0;
+
+        n = c -> end - c -> beg;
+        if ( n > len ) n = len;
+
+        hash_update( &ctx, c -> buf + c -> beg, n );
+        if ( ok && write( fd, c -> buf + c -> beg, n ) != n ) ok = 0;
+        c -> beg += n;
+        len -= n;
+    }
+
+    hash_final( &ctx, digest );
+    hash_to_hex( digest, hex );
+    return ok;
+}
+
+
+// =================== Secret ===================
+
+// The secret shared by workers and coordinators, NULL if there's none
+static const char* shared_secret()
+{
+    const char* s = getenv( WORKER_SECRET_ENV );
+    return s != NULL && s[0] ? s : NULL;
+}
+
+// A fresh challenge, as hex
+static int make_nonce( char* hex )
+{
+    unsigned char raw[ HASH_LEN ];
+    int fd, ok;
+
+    if ( ( fd = open( "/dev/urandom", O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+    ok = ( read( fd, raw, HASH_LEN ) == HASH_LEN );
+    close( fd );
+
+    if ( ok ) hash_to_hex( raw, hex );
+    return ok;
+}
+
+// The answer to challenge Arg1, the secret itself never goes over the wire
+static void prove_secret( const char* nonce, const char* secret, char* hex )
+{
+    struct hash_ctx_t ctx;
+    unsigned char digest[ HASH_LEN ];
+
+    hash_init( &ctx );
+    hash_update( &ctx, nonce, strlen( nonce ) + 1 );
+    hash_update( &ctx, secret, strlen( secret ) );
+    hash_final( &ctx, digest );
+    hash_to_hex( digest, hex );
+}
+
+// Compare answers in a time not telling where they differ
+static int same_proof( const char* got, const char* expect )
+{
+    int i, diff = 0;
+
+    if ( strlen( got ) != HASH_HEX_LEN ) return 0;
+    for ( i = 0; i < HASH_HEX_LEN; ++i ) diff |= got[i] ^ expect[i];
+    return diff == 0;
+}
+
+
+// =================== Cache ===================
+
+static int valid_hash( const char* hex )
+{
+    return strlen( hex ) == HASH_HEX_LEN &&
+        strspn( hex, "0123456789abcdef" ) == HASH_HEX_LEN;
+}
+
+static void cache_path( const char* hex, char* path )
+{
+    sprintf( path, "%s/%s", WORKER_CACHE_DIR, hex );
+}
+
+/*
+ * Split a file of a CASE line into its hash and the name telling its compression.
+ */
+static int parse_case_file( const char* tok, char* hex, char* name )
+{
+    int n;
+
+    n = strspn( tok, "0123456789abcdef" );
+    if ( n != HASH_HEX_LEN || strlen( tok ) > HASH_HEX_LEN + SUFFIX_LEN ||
+         ( tok[n] != 0 && get_decompressor( tok ) == NULL ) ) return 0;
+
+    memcpy( hex, tok, n );
+    hex[n] = 0;
+    strcpy( name, tok );
+    return 1;
+}
+
+static int cache_has( const char* hex )
+{
+    char path[ FILE_NAME_LEN + 1 ];
+    struct stat st;
+
+    cache_path( hex, path );
+    return stat( path, &st ) == 0 && S_ISREG( st.st_mode );
+}
+
+/*
+ * Store an uploaded file, it only becomes visible when its digest checks.
+ */
+static int cache_put( struct conn_t* c, const char* hex, long long len )
+{
+    char path[ FILE_NAME_LEN + 1 ], tmp[ FILE_NAME_LEN + 1 ];
+    char got[ HASH_HEX_LEN + 1 ];
+    int fd, ok;
+
+    cache_path( hex, path );
+    sprintf( tmp, "%s.%d", path, getpid() );
+
+    if ( ( fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRWXU ) ) == -1 )
+        return 0;
+
+    ok = recv_to_file( c, fd, len, got );
+    close( fd );
+
+    if ( ok && strcmp( got, hex ) == 0 &&
+         rename( tmp, path ) == 0 ) return 1;
+
+    unlink( tmp );
+    return 0;
+}
+
+
+// =================== Worker ===================
+
+static int worker_job( struct conn_t* c, struct sys_arg_t* proto,
+                       const char* header )
+{
+    struct sys_arg_t job;
+    struct job_case_t *cases = NULL, *pc;
+    char line[ LINE_LEN ], chk[ LINE_LEN ], hex[ LINE_LEN ];
+    char in_tok[ LINE_LEN ], out_tok[ LINE_LEN ], out_path[ FILE_NAME_LEN + 1 ];
+    int i, j, num, cap, ok, check, by_checker;
+    int *verdicts = NULL;
+
+    job = *proto;
+    if ( sscanf( header, "JOB %d %d %d %d %d %s %d %d %lf", &job.num_of_progs,
+                 &job.std_inx, &job.res_cons.time_limit,
+                 &job.res_cons.mem_limit, &job.res_cons.out_limit, chk,
+                 &check, &job.cmp_opt.mode, &job.cmp_opt.eps ) != 9 ||
+         job.num_of_progs <= 0 || job.num_of_progs > ARGUMENTS_NUM ||
+         job.std_inx < 0 || job.std_inx >= job.num_of_progs )
+        return 0;
+
+    // A checker comes with the modes running one, and only with them
+    by_checker = ( check == CHECK_BY_JUDGE || check == CHECK_BY_PLUGIN );
+    if ( !by_checker && check != CHECK_BY_COMPARISON && check != CHECK_BY_TOKENS ) return 0;
+    if ( by_checker != ( strcmp( chk, NO_HASH ) != 0 ) ) return 0;
+
+    job.progs = malloc2d( job.num_of_progs, FILE_NAME_LEN );
+    job.resp = ( struct RESUSE** )malloc2d( job.num_of_progs,
+                                            sizeof( struct RESUSE ) );
+    verdicts = ( int* )malloc( job.num_of_progs * sizeof( int ) );
+
+    // The job has a runtime of its own
+    job.rt = NULL;
+    ok = ( job.progs != NULL && job.resp != NULL && verdicts != NULL &&
+           runtime_open( &job ) );
+
+    // Programs and checker are executed straight from the cache
+    for ( i = 0; ok && i < job.num_of_progs; ++i ) {
+        if ( recv_line( c, line, LINE_LEN ) < 0 ||
+             sscanf( line, "PROG %s", hex ) != 1 ||
+             !valid_hash( hex ) || !cache_has( hex ) ) {
+            ok = 0;
+            break;
+        }
+        cache_path( hex, job.progs[i] );
+        chmod( job.progs[i], S_IRWXU );
+    }
+
+    if ( ok && by_checker ) {
+        if ( !valid_hash( chk ) || !cache_has( chk ) ) ok = 0;
+        else {
+            cache_path( chk, job.checker_prog );
+            chmod( job.checker_prog, S_IRWXU );
+        }
+    }
+    else
+        job.checker_prog[0] = 0;
+
+    // Receive the whole shard before answering, the coordinator is still writing
+    num = cap = 0;
+    while ( ok ) {
+        if ( recv_line( c, line, LINE_LEN ) < 0 ) {
+            ok = 0;
+            break;
+        }
+        if ( strcmp( line, "END" ) == 0 ) break;
+
+        if ( num == cap ) {
+            cap = ( cap == 0 ? 256 : cap * 2 );
+            pc = ( struct job_case_t* )realloc( cases,
+                                                cap * sizeof( struct job_case_t ) );
+            if ( pc == NULL ) {
+                ok = 0;
+                break;
+            }
+            cases = pc;
+        }
+
+        pc = cases + num;
+        if ( sscanf( line, "CASE %d %127s %127s", &pc -> id, in_tok, out_tok ) != 3 ||
+             !parse_case_file( in_tok, pc -> in_hash, pc -> in_name ) ||
+             !cache_has( pc -> in_hash ) ||
+             ( strcmp( out_tok, NO_HASH ) != 0 &&
+               ( !parse_case_file( out_tok, pc -> out_hash, pc -> out_name ) ||
+                 !cache_has( pc -> out_hash ) ) ) ) {
+            ok = 0;
+            break;
+        }
+        if ( strcmp( out_tok, NO_HASH ) == 0 ) strcpy( pc -> out_hash, NO_HASH );
+        ++num;
+    }
+
+    // Only a checker the coordinator declares a plugin is loaded into the worker
+    if ( ok && check == CHECK_BY_PLUGIN &&
+         !load_checker_plugin( &job, job.checker_prog ) ) {
+        fprintf( stderr, "Load checker plugin %s failed.\n", chk );
+        ok = 0;
+    }
+
+    if ( ok ) {
+        load_checker( &job, check );
+
+        if ( Verbose_mode )
+            printf( "Worker %d: judging %d cases\n", getpid(), num );
+
+        for ( i = 0; ok && i < num; ++i ) {
+            pc = cases + i;
+            cache_path( pc -> in_hash, job.case_file );
+            if ( !stage_file( job.case_file, pc -> in_name, job.input_file,
+                              &job.in_fd ) ) {
+                ok = 0;
+                break;
+            }
+
+            if ( strcmp( pc -> out_hash, NO_HASH ) != 0 ) {
+                cache_path( pc -> out_hash, out_path );
+                if ( !stage_file( out_path, pc -> out_name, job.output_file,
+                                  &job.out_fd ) ) {
+                    ok = 0;
+                    break;
+                }
+                load_res_gen( &job, OOPS );
+            }
+            else
+                load_res_gen( &job, RESULT_BY_GENERATOR );
+
+            for ( j = 0; j < job.num_of_progs; ++j )
+                memset( job.resp[j], 0, sizeof( struct RESUSE ) );
+
+            if ( !judge_case( &job, verdicts ) ) {
+                for ( j = 0; j < job.num_of_progs; ++j )
+                    verdicts[j] = RES_SE;
+            }
+
+            for ( j = 0; ok && j < job.num_of_progs; ++j )
+                ok = send_line( c, "RES %d %d %d %d %d %lld\n", pc -> id, j,
+                                verdicts[j], time_used( job.resp[j] ),
+                                mem_used( job.resp[j] ),
+                                out_used( job.resp[j] ) );
+        }
+
+        unstage_file( &job.in_fd );
+        unstage_file( &job.out_fd );
+        ok = ok && send_line( c, "DONE\n" );
+    }
+
+    runtime_close( &job );
+    free( cases );
+    free( verdicts );
+    free2d( job.progs, job.num_of_progs );
+    free2d( (char**)job.resp, job.num_of_progs );
+
+    return ok;
+}
+
+static void worker_session( int fd, struct sys_arg_t* parg )
+{
+    struct sys_arg_t proto;
+    struct conn_t* c;
+    char line[ LINE_LEN ], hex[ LINE_LEN ];
+    char nonce[ HASH_HEX_LEN + 1 ], proof[ HASH_HEX_LEN + 1 ];
+    char scratch[ DIR_NAME_LEN + 1 ];
+    long long len;
+
+    if ( ( c = conn_open( fd ) ) == NULL ) return;
+
+    // The coordinator proves the secret before anything else
+    if ( !make_nonce( nonce ) || !send_line( c, "HELLO %s\n", nonce ) ||
+         recv_line( c, line, LINE_LEN ) < 0 ||
+         sscanf( line, "AUTH %127s", hex ) != 1 ) {
+        conn_close( c );
+        return;
+    }
+
+    prove_secret( nonce, shared_secret(), proof );
+    if ( !same_proof( hex, proof ) || !send_line( c, "OK\n" ) ) {
+        if ( Verbose_mode ) printf( "Worker %d: refused a coordinator\n", getpid() );
+        conn_close( c );
+        return;
+    }
+
+    // Concurrent sessions must not share the scratch folder
+    proto = *parg;
+    sprintf( scratch, "%ss%d", parg -> di_temp -> folder_name, getpid() );
+    if ( ( proto.di_temp = open_folder( scratch ) ) == NULL ) {
+        conn_close( c );
+        return;
+    }
+
+    while ( recv_line( c, line, LINE_LEN ) >= 0 ) {
+
+        if ( sscanf( line, "HAVE %s", hex ) == 1 ) {
+            if ( !send_line( c, valid_hash( hex ) && cache_has( hex ) ?
+                             "YES\n" : "NO\n" ) ) break;
+        }
+        else if ( sscanf( line, "PUT %s %lld", hex, &len ) == 2 ) {
+            if ( !valid_hash( hex ) || len < 0 ) break;
+            if ( !send_line( c, cache_put( c, hex, len ) ?
+                             "OK\n" : "ERR\n" ) ) break;
+        }
+        else if ( strncmp( line, "JOB ", 4 ) == 0 ) {
+            if ( !worker_job( c, &proto, line ) ) break;
+        }
+        else
+            break;
+    }
+
+    // The worker deletes it in the background
+    close_folder( proto.di_temp );
+    scratch_retire( scratch );
+    conn_close( c );
+}
+
+int worker_serve( const char* host, int port, struct sys_arg_t* parg )
+{
+    struct addrinfo hints, *res, *p;
+    char service[ 16 ];
+    int lfd = -1, fd, opt = 1;
+    pid_t pid;
+
+    if ( shared_secret() == NULL ) {
+        fprintf( stderr, "Set the secret shared with the coordinators in $%s first.\n",
+                 WORKER_SECRET_ENV );
+        return 0;
+    }
+
+    if ( !folder_exist( WORKER_CACHE_DIR ) &&
+         mkdir( WORKER_CACHE_DIR, S_IRWXU ) == -1 ) {
+        fprintf( stderr, "Create cache folder %s failed.\n", WORKER_CACHE_DIR );
+        return 0;
+    }
+
+    // Sessions retire their scratch folders into the trash
+    if ( scratch_init( parg -> di_temp -> folder_name ) ) scratch_sweep();
+
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    sprintf( service, "%d", port );
+
+    if ( getaddrinfo( host[0] ? host : NULL, service, &hints, &res ) == 0 ) {
+        for ( p = res; p != NULL; p = p -> ai_next ) {
+            lfd = socket( p -> ai_family, p -> ai_socktype | SOCK_CLOEXEC, p -> ai_protocol );
+            if ( lfd == -1 ) continue;
+            setsockopt( lfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof( opt ) );
+            if ( bind( lfd, p -> ai_addr, p -> ai_addrlen ) == 0 &&
+                 listen( lfd, 16 ) == 0 ) break;
+            close( lfd );
+            lfd = -1;
+        }
+        freeaddrinfo( res );
+    }
+
+    if ( lfd == -1 ) {
+        fprintf( stderr, "Listen on %s:%d failed.\n", host[0] ? host : "*", port );
+        return 0;
+    }
+
+    signal( SIGPIPE, SIG_IGN );
+    printf( "Worker is listening on %s:%d.\n", host[0] ? host : "*", port );
+    fflush( stdout );
+
+    while ( 1 ) {
+        fd = accept( lfd, NULL, NULL );
+        if ( fd == -1 ) {
+            if ( errno == EINTR ) continue;
+            break;
+        }
+        fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+        // Reap finished sessions, and delete what they left
+        while ( waitpid( -1, NULL, WNOHANG ) > 0 );
+        scratch_sweep();
+
+        pid = fork();
+        if ( pid == 0 ) {
+            close( lfd );
+            worker_session( fd, parg );
+            exit( 0 );
+        }
+        else if ( pid == -1 ) {
+            fprintf( stderr, "The system call fork failed.\n" );
+        }
+
+        close( fd );
+    }
+
+    close( lfd );
+    scratch_drain();
+    return 1;
+}
+
+
+// =================== Coordinator ===================
+
+static int connect_worker( struct worker_t* pw )
+{
+    struct addrinfo hints, *res, *p;
+    char line[ LINE_LEN ], nonce[ LINE_LEN ], proof[ HASH_HEX_LEN + 1 ];
+    int fd = -1;
+
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ( getaddrinfo( pw -> host, pw -> port, &hints, &res ) != 0 ) return 0;
+
+    for ( p = res; p != NULL; p = p -> ai_next ) {
+        fd = socket( p -> ai_family, p -> ai_socktype | SOCK_CLOEXEC, p -> ai_protocol );
+        if ( fd == -1 ) continue;
+        if ( connect( fd, p -> ai_addr, p -> ai_addrlen ) == 0 ) break;
+        close( fd );
+        fd = -1;
+    }
+    freeaddrinfo( res );
+
+    if ( fd == -1 ) return 0;
+    if ( ( pw -> conn = conn_open( fd ) ) == NULL ) {
+        close( fd );
+        return 0;
+    }
+
+    // Answer the challenge of the worker
+    if ( recv_line( pw -> conn, line, LINE_LEN ) < 0 ||
+         sscanf( line, "HELLO %127s", nonce ) != 1 ||
+         strlen( nonce ) != HASH_HEX_LEN ) goto refused;
+
+    prove_secret( nonce, shared_secret(), proof );
+    if ( send_line( pw -> conn, "AUTH %s\n", proof ) &&
+         recv_line( pw -> conn, line, LINE_LEN ) >= 0 &&
+         strcmp( line, "OK" ) == 0 ) return 1;
+
+  refused:
+    fprintf( stderr, "Worker %s:%s refused the secret.\n", pw -> host, pw -> port );
+    conn_close( pw -> conn );
+    pw -> conn = NULL;
+    return 0;
+}
+
+static int parse_workers( const char* hosts, struct worker_t* workers )
+{
+    char item[ OPTION_LEN + 1 ], *p;
+    int n, len;
+
+    for ( n = 0; *hosts && n < MAX_WORKERS; ) {
+        len = strcspn( hosts, "," );
+        if ( len > 0 && len <= OPTION_LEN ) {
+            memcpy( item, hosts, len );
+            item[len] = 0;
+
+            if ( ( p = strrchr( item, ':' ) ) != NULL &&
+                 strlen( p + 1 ) < sizeof( workers[n].port ) ) {
+                *p = 0;
+                strcpy( workers[n].host, item );
+                strcpy( workers[n].port, p + 1 );
+                workers[n].conn = NULL;
+                workers[n].lost = 0;
+                ++n;
+            }
+            else
+                fprintf( stderr, "Ignore worker \"%s\", expect host:port.\n", item );
+        }
+
+        hosts += len;
+        if ( *hosts == ',' ) ++hosts;
+    }
+
+    return n;
+}
+
+static int put_file( struct conn_t* c, const char* hex, const char* path )
+{
+    char line[ LINE_LEN ];
+    struct stat st;
+    off_t off = 0;
+    int fd, ret;
+
+    if ( ( fd = open( path, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+    if ( fstat( fd, &st ) == -1 ||
+         !send_line( c, "PUT %s %lld\n", hex, (long long)st.st_size ) ) {
+        close( fd );
+        return 0;
+    }
+
+    while ( off < st.st_size ) {
+        ret = sendfile( c -> fd, fd, &off, st.st_size - off );
+        if ( ret <= 0 ) {
+            if ( ret == -1 && errno == EINTR ) continue;
+            break;
+        }
+    }
+    close( fd );
+
+    return off == st.st_size &&
+        recv_line( c, line, LINE_LEN ) >= 0 && strcmp( line, "OK" ) == 0;
+}
+
+/*
+ * Make sure the worker has all the files, only the missing ones are shipped.
+ * The questions are sent in batches to save round trips.
+ */
+static int sync_files( struct conn_t* c, char** hashes, char** paths, int n )
+{
+    char line[ LINE_LEN ];
+    char missing[ SYNC_BATCH ];
+    int i, beg, end;
+
+    for ( beg = 0; beg < n; beg = end ) {
+        end = ( beg + SYNC_BATCH < n ? beg + SYNC_BATCH : n );
+
+        for ( i = beg; i < end; ++i )
+            if ( !send_line( c, "HAVE %s\n", hashes[i] ) ) return 0;
+
+        for ( i = beg; i < end; ++i ) {
+            if ( recv_line( c, line, LINE_LEN ) < 0 ) return 0;
+            missing[ i - beg ] = ( strcmp( line, "YES" ) != 0 );
+        }
+
+        for ( i = beg; i < end; ++i ) {
+            if ( !missing[ i - beg ] ) continue;
+            if ( !put_file( c, hashes[i], paths[i] ) ) {
+                fprintf( stderr, "Upload %s failed.\n", paths[i] );
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Enumerate cases by the loaded input strategy.
+ * Inputs living in the scratch folder are overwritten by the next one, keep a copy.
+ */
+static int collect_cases( struct sys_arg_t* parg,
+                          struct dist_case_t** pcases, int* pnum )
+{
+    struct dist_case_t *cases = NULL, *pc;
+    char buf[ FILE_NAME_LEN + 1 ];
+    const char* base;
+    int num = 0, cap = 0, tmp_len;
+
+    tmp_len = strlen( parg -> di_temp -> folder_name );
+
+    while ( get_next_input( parg ) ) {
+        if ( num == cap ) {
+            cap = ( cap == 0 ? 256 : cap * 2 );
+            pc = ( struct dist_case_t* )realloc( cases,
+                                                 cap * sizeof( struct dist_case_t ) );
+            if ( pc == NULL ) goto error_code;
+            cases = pc;
+        }
+
+        pc = cases + num;
+        memset( pc, 0, sizeof( struct dist_case_t ) );
+        ++num;
+
+        if ( strncmp( parg -> input_file, parg -> di_temp -> folder_name,
+                      tmp_len ) == 0 ) {
+            sprintf( buf, "%sgen_%d.txt", parg -> di_temp -> folder_name, num );
+            if ( rename( parg -> input_file, buf ) == -1 ) goto error_code;
+            pc -> in_path = strdup( buf );
+            sprintf( buf, "gen_%d", num );
+            pc -> name = strdup( buf );
+            pc -> generated = 1;
+            pc -> seed = parg -> case_seed;
+        }
+        else {
+            // Compressed files are shipped as they are
+            base = strrchr( parg -> case_file, '/' );
+            pc -> in_path = strdup( parg -> case_file );
+            pc -> name = strdup( base == NULL ? parg -> case_file : base + 1 );
+
+            if ( parg -> sp_inout != NULL &&
+                 map_file( parg -> sp_inout, parg -> di_out -> folder_name,
+                           parg -> case_file, buf ) )
+                pc -> out_path = strdup( buf );
+        }
+
+        if ( pc -> in_path == NULL || pc -> name == NULL ||
+             !hash_file( pc -> in_path, pc -> in_hash, NULL ) ) goto error_code;
+
+        if ( pc -> out_path == NULL )
+            strcpy( pc -> out_hash, NO_HASH );
+        else if ( !hash_file( pc -> out_path, pc -> out_hash, NULL ) ) {
+            fprintf( stderr, "Read %s failed.\n", pc -> out_path );
+            goto error_code;
+        }
+    }
+
+    *pcases = cases;
+    *pnum = num;
+    return 1;
+
+  error_code:
+    *pcases = cases;
+    *pnum = num;
+    return 0;
+}
+
+// The compression suffix of a case file, or "" if it is plain
+static const char* compression_of( const char* path )
+{
+    return path == NULL ? "" : path + strip_compression( path );
+}
+
+static void release_cases( struct dist_case_t* cases, int num )
+{
+    int i;
+
+    if ( cases == NULL ) return;
+    for ( i = 0; i < num; ++i ) {
+        free( cases[i].name );
+        free( cases[i].in_path );
+        free( cases[i].out_path );
+    }
+    free( cases );
+}
+
+/*
+ * How the workers check the results, picked as options_prepare() does.
+ */
+static int check_mode( struct sys_arg_t* parg )
+{
+    int len = strlen( parg -> checker_prog );
+
+    if ( len == 0 )
+        return parg -> cmp_opt.mode != CMP_DIFF ? CHECK_BY_TOKENS : CHECK_BY_COMPARISON;
+
+    return len > 3 && strcmp( parg -> checker_prog + len - 3, ".so" ) == 0 ?
+        CHECK_BY_PLUGIN : CHECK_BY_JUDGE;
+}
+
+/*
+ * Ship everything a shard needs, then the job itself.
+ */
+static int start_shard( struct sys_arg_t* parg, struct worker_t* pw,
+                        struct dist_case_t* cases,
+                        char prog_hash[][ HASH_HEX_LEN + 1 ],
+                        const char* chk_hash )
+{
+    char **hashes, **paths;
+    int i, k, n, ok;
+
+    n = parg -> num_of_progs + 1 + pw -> num * 2;
+    hashes = ( char** )malloc( n * sizeof( char* ) );
+    paths = ( char** )malloc( n * sizeof( char* ) );
+    if ( hashes == NULL || paths == NULL ) {
+        free( hashes );
+        free( paths );
+        return 0;
+    }
+
+    n = 0;
+    for ( i = 0; i < parg -> num_of_progs; ++i, ++n ) {
+        hashes[n] = prog_hash[i];
+        paths[n] = parg -> progs[i];
+    }
+    if ( parg -> checker_prog[0] ) {
+        hashes[n] = (char*)chk_hash;
+        paths[n++] = parg -> checker_prog;
+    }
+    for ( k = 0; k < pw -> num; ++k ) {
+        i = pw -> ids[k];
+        hashes[n] = cases[i].in_hash;
+        paths[n++] = cases[i].in_path;
+        if ( cases[i].out_path != NULL ) {
+            hashes[n] = cases[i].out_hash;
+            paths[n++] = cases[i].out_path;
+        }
+    }
+
+    ok = sync_files( pw -> conn, hashes, paths, n );
+    free( hashes );
+    free( paths );
+    if ( !ok ) return 0;
+
+    if ( !send_line( pw -> conn, "JOB %d %d %d %d %d %s %d %d %.17g\n",
+                     parg -> num_of_progs, parg -> std_inx,
+                     parg -> res_cons.time_limit,
+                     parg -> res_cons.mem_limit,
+                     parg -> res_cons.out_limit,
+                     parg -> checker_prog[0] ? chk_hash : NO_HASH,
+                     check_mode( parg ),
+                     parg -> cmp_opt.mode, parg -> cmp_opt.eps ) )
+        return 0;
+
+    for ( i = 0; i < parg -> num_of_progs; ++i )
+        if ( !send_line( pw -> conn, "PROG %s\n", prog_hash[i] ) ) return 0;
+
+    for ( k = 0; k < pw -> num; ++k ) {
+        i = pw -> ids[k];
+        if ( !send_line( pw -> conn, "CASE %d %s%s %s%s\n", i,
+                         cases[i].in_hash, compression_of( cases[i].in_path ),
+                         cases[i].out_hash, compression_of( cases[i].out_path ) ) )
+            return 0;
+    }
+
+    return send_line( pw -> conn, "END\n" );
+}
+
+static int cmp_int( const void* a, const void* b )
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+// Whether case Arg2 was sent to the worker
+static int in_shard( struct worker_t* pw, int id )
+{
+    return bsearch( &id, pw -> ids, pw -> num, sizeof( int ), cmp_int ) != NULL;
+}
+
+// Whether every program has a result on the case
+static int case_judged( struct dist_res_t* pr, int nprogs )
+{
+    int j;
+
+    for ( j = 0; j < nprogs; ++j )
+        if ( !pr[j].got ) return 0;
+    return 1;
+}
+
+/*
+ * Read the streamed results until every worker says DONE or goes away.
+ * A lost worker is closed, the cases it didn't finish are left without results.
+ */
+static void collect_results( struct worker_t* workers, int nw,
+                             struct dist_res_t* results, int nprogs )
+{
+    struct pollfd pfd[ MAX_WORKERS ];
+    struct dist_res_t r;
+    char line[ LINE_LEN ];
+    int i, id, prog, left, lost;
+
+    for ( left = 0, i = 0; i < nw; ++i )
+        if ( !workers[i].done ) ++left;
+
+    while ( left > 0 ) {
+        for ( i = 0; i < nw; ++i ) {
+            pfd[i].fd = ( workers[i].done ? -1 : workers[i].conn -> fd );
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        if ( poll( pfd, nw, -1 ) == -1 ) {
+            if ( errno == EINTR ) continue;
+            break;
+        }
+
+        for ( i = 0; i < nw; ++i ) {
+            if ( workers[i].done || pfd[i].revents == 0 ) continue;
+
+            lost = 0;
+            do {
+                if ( recv_line( workers[i].conn, line, LINE_LEN ) < 0 ) {
+                    lost = 1;
+                    break;
+                }
+
+                if ( strcmp( line, "DONE" ) == 0 ) {
+                    workers[i].done = 1;
+                    break;
+                }
+
+                if ( sscanf( line, "RES %d %d %d %d %d %lld", &id, &prog,
+                             &r.res, &r.time, &r.mem, &r.out ) == 6 &&
+                     in_shard( workers + i, id ) &&
+                     prog >= 0 && prog < nprogs &&
+                     r.res >= RES_NORMAL && r.res < RES_CODES ) {
+                    r.got = 1;
+                    results[ id * nprogs + prog ] = r;
+                }
+            } while ( conn_has_line( workers[i].conn ) );
+
+            if ( lost ) {
+                fprintf( stderr, "Worker %s:%s is lost.\n",
+                         workers[i].host, workers[i].port );
+                conn_close( workers[i].conn );
+                workers[i].conn = NULL;
+                workers[i].lost = workers[i].done = 1;
+            }
+
+            if ( workers[i].done ) --left;
+        }
+    }
+}
+
+int dist_judge( struct sys_arg_t* parg, const char* hosts )
+{
+    struct worker_t workers[ MAX_WORKERS ];
+    struct dist_case_t* cases = NULL;
+    struct dist_res_t* results = NULL;
+    char (*prog_hash)[ HASH_HEX_LEN + 1 ] = NULL;
+    char chk_hash[ HASH_HEX_LEN + 1 ];
+    const char* interp = interpreter_of( parg -> gen_prog );
+    struct prog_stat_t* stats = NULL;
+    struct dist_res_t* pr;
+    int *pending = NULL;
+    int i, j, k, nw, ncases = 0, shard, failed, ok = 0;
+    int left = 0, live, last_left, last_live;
+    long long start = phase_clock();
+
+    signal( SIGPIPE, SIG_IGN );
+
+    if ( shared_secret() == NULL ) {
+        fprintf( stderr, "Set the secret shared with the workers in $%s first.\n",
+                 WORKER_SECRET_ENV );
+        return 0;
+    }
+
+    if ( ( nw = parse_workers( hosts, workers ) ) == 0 ) {
+        fprintf( stderr, "No worker specified.\n" );
+        return 0;
+    }
+
+    if ( !collect_cases( parg, &cases, &ncases ) ) {
+        fprintf( stderr, "Collect cases failed.\n" );
+        goto release_code;
+    }
+
+    prog_hash = malloc( parg -> num_of_progs * sizeof( *prog_hash ) );
+    results = ( struct dist_res_t* )malloc( ( ncases + 1 ) * parg -> num_of_progs *
+                                            sizeof( struct dist_res_t ) );
+    stats = ( struct prog_stat_t* )malloc( parg -> num_of_progs *
+                                           sizeof( struct prog_stat_t ) );
+    pending = ( int* )malloc( ( ncases + 1 ) * sizeof( int ) );
+    if ( prog_hash == NULL || results == NULL || stats == NULL || pending == NULL )
+        goto release_code;
+
+    for ( i = 0; i < parg -> num_of_progs; ++i ) stat_init( stats + i, 0 );
+
+    for ( i = 0; i < ncases * parg -> num_of_progs; ++i ) {
+        results[i].res = RES_NOT_CHECK;
+        results[i].time = results[i].mem = results[i].got = 0;
+        results[i].out = 0;
+    }
+
+    for ( i = 0; i < parg -> num_of_progs; ++i )
+        if ( !hash_file( parg -> progs[i], prog_hash[i], NULL ) ) {
+            fprintf( stderr, "Read %s failed.\n", parg -> progs[i] );
+            goto release_code;
+        }
+
+    if ( parg -> checker_prog[0] &&
+         !hash_file( parg -> checker_prog, chk_hash, NULL ) ) {
+        fprintf( stderr, "Read %s failed.\n", parg -> checker_prog );
+        goto release_code;
+    }
+
+    /*
+     * What is left goes out in contiguous shards, one per live worker,
+     * until every case is judged or a round changes nothing.
+     */
+    for ( last_left = last_live = -1; ; last_left = left, last_live = live ) {
+        for ( left = i = 0; i < ncases; ++i ) {
+            pr = results + i * parg -> num_of_progs;
+            if ( case_judged( pr, parg -> num_of_progs ) ) continue;
+
+            // Results of a lost worker on an unfinished case are dropped
+            for ( j = 0; j < parg -> num_of_progs; ++j ) {
+                pr[j].res = RES_NOT_CHECK;
+                pr[j].time = pr[j].mem = pr[j].got = 0;
+                pr[j].out = 0;
+            }
+            pending[ left++ ] = i;
+        }
+
+        for ( live = i = 0; i < nw; ++i )
+            if ( !workers[i].lost ) ++live;
+
+        if ( left == 0 || live == 0 ) break;
+        if ( left == last_left && live == last_live ) break;
+        if ( last_left != -1 )
+            fprintf( stderr, "Retry %d cases on %d workers.\n", left, live );
+
+        shard = ( left + live - 1 ) / live;
+        for ( k = i = 0; i < nw; ++i ) {
+            workers[i].done = 1;
+            if ( workers[i].lost ) continue;
+
+            workers[i].ids = pending + k;
+            workers[i].num = ( k + shard < left ? shard : left - k );
+            k += workers[i].num;
+            if ( workers[i].num == 0 ) continue;
+
+            if ( workers[i].conn == NULL && !connect_worker( &workers[i] ) ) {
+                fprintf( stderr, "Connect to worker %s:%s failed.\n",
+                         workers[i].host, workers[i].port );
+                workers[i].lost = 1;
+                continue;
+            }
+
+            if ( Verbose_mode )
+                printf( "Send %d cases from %d to %s:%s\n", workers[i].num,
+                        workers[i].ids[0] + 1, workers[i].host, workers[i].port );
+
+            if ( !start_shard( parg, &workers[i], cases, prog_hash, chk_hash ) ) {
+                fprintf( stderr, "Start shard on worker %s:%s failed.\n",
+                         workers[i].host, workers[i].port );
+                conn_close( workers[i].conn );
+                workers[i].conn = NULL;
+                workers[i].lost = 1;
+                continue;
+            }
+
+            workers[i].done = 0;
+        }
+
+        collect_results( workers, nw, results, parg -> num_of_progs );
+    }
+
+    if ( left > 0 )
+        fprintf( stderr, "%d cases are not judged, no worker could take them.\n", left );
+
+    // Merge into the usual report
+    failed = 0;
+    for ( i = 0; i < ncases; ++i ) {
+        printf( "Test %d (%s):\n", i + 1, cases[i].name );
+        parg -> case_seed = cases[i].seed;
+        report_case( parg, i + 1, cases[i].generated ? NULL : cases[i].name );
+
+        for ( j = 0; j < parg -> num_of_progs; ++j ) {
+            pr = results + i * parg -> num_of_progs + j;
+
+            print_result( j, pr -> time, -1, pr -> mem, pr -> out, pr -> res );
+            report_result( parg, j, pr -> res, pr -> time, -1, pr -> mem, pr -> out, NULL );
+
+            // Workers report in ms, without the details
+            if ( pr -> res != RES_NOT_CHECK )
+                stat_add( stats + j, pr -> time * 1000LL, -1, pr -> mem, NULL,
+                          i + 1, cases[i].name );
+        }
+        report_case_end( parg );
+
+        for ( j = 0; j < parg -> num_of_progs; ++j )
+            if ( results[ i * parg -> num_of_progs + j ].res != RES_AC ) break;
+        if ( j < parg -> num_of_progs ) {
+            ++failed;
+            if ( cases[i].generated )
+                printf( "Reproduce the input by: %s%s%s %llu %d\n",
+                        interp ? interp : "", interp ? " " : "",
+                        parg -> gen_prog, cases[i].seed, i + 1 );
+        }
+
+        putchar( '\n' );
+    }
+
+    printf( "Summary:\n" );
+    for ( j = 0; j < parg -> num_of_progs; ++j )
+        print_summary( stats[j].time_us / 1000, -1, stats[j].mem_kb, stats[j].runs );
+    for ( j = 0; j < parg -> num_of_progs; ++j )
+        print_stat( j, stats + j );
+    printf( "Failed cases: %d/%d\n", failed, ncases );
+
+    // Phases are timed by the workers, only the whole time is known here
+    parg -> judge_ns += phase_clock() - start;
+    report_close( parg, stats );
+
+    ok = 1;
+
+  release_code:
+    for ( i = 0; i < nw; ++i ) conn_close( workers[i].conn );
+    release_cases( cases, ncases );
+    free( prog_hash );
+    free( results );
+    free( stats );
+    free( pending );
+
+    return ok;
+}
@@ -0,0 +1,30 @@
+/*
+ * Spread a testing run across several judge hosts.
+ * The coordinator splits the case list into shards and ships them to workers,
+ * workers keep programs and data in a cache named by content hash.
+ * By richardxx, 2009.6
+ */
+
+#ifndef DIST_H
+#define DIST_H
+
+#include "type_def.h"
+
+/*
+ * Serve judge requests on host Arg1 ("" for every address), port Arg2, until killed.
+ * Only coordinators knowing the secret in $TESTER_SECRET are served.
+ * Arg3 supplies the temporary folder used for scratch data.
+ * Return 0 if the address cannot be served or no secret is set.
+ */
+extern
+int worker_serve( const char*, int, struct sys_arg_t* );
+
+/*
+ * Judge all cases on the workers listed in Arg2, "host:port,host:port...".
+ * Results are merged and printed as the local judge does.
+ * Return 0 if unexpected errors occurred, otherwise 1.
+ */
+extern
+int dist_judge( struct sys_arg_t*, const char* );
+
+#endif
@@ -8,6 +8,7 @@
  * Revised in 2009.1
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -17,14 +18,33 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
+#include <ftw.h>
 #include "file.h"
 
 #define MAGIC_NUMBER_LEN			4
 #define MAGIC_TYPE				2
 #define CHUNK_SIZE				4096
+#define WALK_FDS				32
 
 const int magic_number[] = { 0x7f454c46, 0xcafebabe };
-static char tmp_buf[ CHUNK_SIZE + 1 ];
+
+// Compressed data files and the programs decompressing them to stdout
+static const char* compress_suffix[] = { ".gz", ".zst", NULL };
+static const char* decompressor[] = { "gzip", "zstd" };
+
+static int compress_type( const char* fname )
+{
+    int i, len, slen;
+
+    len = strlen( fname );
+    for ( i = 0; compress_suffix[i] != NULL; ++i ) {
+        slen = strlen( compress_suffix[i] );
+        if ( len > slen &&
+             strcmp( fname + len - slen, compress_suffix[i] ) == 0 ) return i;
+    }
+
+    return -1;
+}
 
 /*
  * Create this folder if doesn't exist.
@@ -91,16 +111,85 @@ int reopen_folder( struct dir_info_t* my_dir )
     return 1;
 }
 
+// Where copy_entry() copies the tree to, nftw() takes no context
+static __thread const char* copy_dest;
+static __thread int copy_src_len;
+
+static int copy_entry( const char* path, const struct stat* st, int flag, struct FTW* pf )
+{
+    char dest[ FILE_NAME_LEN + 1 ], link[ FILE_NAME_LEN + 1 ];
+    int len;
+
+    sprintf( dest, "%s%s", copy_dest, path + copy_src_len );
+
+    switch ( flag ) {
+        case FTW_D:
+            return ( mkdir( dest, S_IRWXU ) == -1 && errno != EEXIST ) ? -1 : 0;
+
+        case FTW_SL:
+        case FTW_SLN:
+            if ( ( len = readlink( path, link, FILE_NAME_LEN ) ) == -1 ) return -1;
+            link[ len ] = 0;
+            return symlink( link, dest ) == -1 ? -1 : 0;
+
+        case FTW_F:
+            return file_copy( path, dest ) ? 0 : -1;
+    }
+
+    return -1;
+}
+
+static int remove_entry( const char* path, const struct stat* st, int flag, struct FTW* pf )
+{
+    // Somebody else may be removing it too
+    return ( remove( path ) == -1 && errno != ENOENT ) ? -1 : 0;
+}
+
+/*
+ * Like mv, a folder moved onto an existing one goes inside it.
+ * A rename never replaces anything, across file systems the folder is copied.
+ */
 int rename_folder( const char* p1, const char* p2 )
 {
-    sprintf( tmp_buf, "mv %s %s", p1, p2 );
-    return system( tmp_buf ) == 0 ? 1 : 0;
+    char src[ FILE_NAME_LEN + 1 ], dest[ FILE_NAME_LEN + 1 ];
+    const char* base;
+    int len;
+
+    strcpy( src, p1 );
+    for ( len = strlen( src ); len > 1 && src[ len - 1 ] == '/'; --len ) src[ len - 1 ] = 0;
+
+    if ( folder_exist( p2 ) ) {
+        base = strrchr( src, '/' );
+        sprintf( dest, "%s/%s", p2, base == NULL ? src : base + 1 );
+    }
+    else
+        strcpy( dest, p2 );
+
+    if ( renameat2( AT_FDCWD, src, AT_FDCWD, dest, RENAME_NOREPLACE ) == 0 )
+        return 1;
+
+    // Some file systems can't promise not to replace
+    if ( errno == EINVAL && access( dest, F_OK ) == -1 &&
+         rename( src, dest ) == 0 ) return 1;
+    
+    if ( errno != EXDEV ) return 0;
+
+    copy_dest = dest;
+    copy_src_len = strlen( src );
+    if ( nftw( src, copy_entry, WALK_FDS, FTW_PHYS ) != 0 ) {
+        remove_folder( dest );
+        return 0;
+    }
+    
+    return remove_folder( src );
 }
 
 int remove_folder( const char* path )
 {
-    sprintf( tmp_buf, "rm -rf %s", path );
-    return system( tmp_buf ) == 0 ? 1 : 0;
+    if ( nftw( path, remove_entry, WALK_FDS, FTW_DEPTH | FTW_PHYS ) == 0 )
+        return 1;
+
+    return errno == ENOENT;
 }
 
 int close_folder( struct dir_info_t* my_dir )
@@ -123,6 +212,7 @@ struct suf_pat_t* detect_pattern( const char* indir, const char* outdir )
     DIR *dir_in, *dir_out;
     struct dirent *dirent_in, *dirent_out;
     struct suf_pat_t* psuf_ret;
+    char name_in[ FILE_NAME_LEN + 1 ], name_out[ FILE_NAME_LEN + 1 ];
 
     // Request resource
     dir_in = opendir( indir );
@@ -154,6 +244,10 @@ struct suf_pat_t* detect_pattern( const char* indir, const char* outdir )
         break;
     }
 
+    // Compression doesn't take part in the pattern
+    strcpy( name_in, dirent_in -> d_name );
+    name_in[ strip_compression( name_in ) ] = 0;
+
     // Check if there's an entry with corressponding prefix
     while ( flag == 0 ) {
       
@@ -162,22 +256,25 @@ struct suf_pat_t* detect_pattern( const char* indir, const char* outdir )
             // Empty output folder
             goto release_code;
         }
-        if ( strcmp( dirent_in -> d_name, "." ) == 0 ||
-             strcmp( dirent_in -> d_name, ".." ) == 0 ) continue;
+        if ( strcmp( dirent_out -> d_name, "." ) == 0 ||
+             strcmp( dirent_out -> d_name, ".." ) == 0 ) continue;
+
+        strcpy( name_out, dirent_out -> d_name );
+        name_out[ strip_compression( name_out ) ] = 0;
         
         for ( i = 0;
-              dirent_in -> d_name[ i ] && dirent_out -> d_name[ i ];
+              name_in[ i ] && name_out[ i ];
               ++i ) {
-            if ( dirent_in -> d_name[ i ] != dirent_out -> d_name[ i ] ) break;
-            if ( dirent_in -> d_name[ i ] == '.' ) {
+            if ( name_in[ i ] != name_out[ i ] ) break;
+            if ( name_in[ i ] == '.' ) {
                 flag = 1;
                 break;
             }
         }
 
         // If neither of them has dot separated suffix
-        if ( dirent_in -> d_name[i] == dirent_out -> d_name[i] &&
-             dirent_in -> d_name[i] == 0 ) {
+        if ( name_in[i] == name_out[i] &&
+             name_in[i] == 0 ) {
             flag = 1;
             continue;
         }
@@ -188,22 +285,22 @@ struct suf_pat_t* detect_pattern( const char* indir, const char* outdir )
             psuf_ret -> out_suffix[ SUFFIX_LEN - 1 ] = 0;
             
             for ( k = i;
-                  dirent_in -> d_name[k] && k - i + 1 < SUFFIX_LEN - 1;
+                  name_in[k] && k - i + 1 < SUFFIX_LEN - 1;
                   ++k )
-                psuf_ret -> in_suffix[ k - i ] = dirent_in -> d_name[k];
+                psuf_ret -> in_suffix[ k - i ] = name_in[k];
 
             // Length of suffix of input files exceed the limit
-            if ( dirent_in -> d_name[k] != 0 ) goto release_code;
+            if ( name_in[k] != 0 ) goto release_code;
             psuf_ret -> in_suffix[ k - i ] = 0;
             psuf_ret -> in_len = k - i;
             
             for ( k = i;
-                  dirent_out -> d_name[k] && k - i + 1 < SUFFIX_LEN - 1;
+                  name_out[k] && k - i + 1 < SUFFIX_LEN - 1;
                   ++k )
-                psuf_ret -> out_suffix[ k - i ] = dirent_out -> d_name[k];
+                psuf_ret -> out_suffix[ k - i ] = name_out[k];
 
             // Length of suffix of ouput files exceed the limit
-            if ( dirent_out -> d_name[k] != 0 ) goto release_code;
+            if ( name_out[k] != 0 ) goto release_code;
             psuf_ret -> out_suffix[ k - i ] = 0;
             psuf_ret -> out_len = k - i;
         }
@@ -222,6 +319,8 @@ struct suf_pat_t* detect_pattern( const char* indir, const char* outdir )
 
 /*
  * Don't touch anything if the suffix of input file miss the the detected pattern.
+ * Compression suffixes are seen through on both sides:
+ * the output may be stored plainly or compressed, whichever exists.
  */
 int map_file( const struct suf_pat_t* psuf, const char* out_dir, 
               const char* fin, char* fout )
@@ -229,7 +328,7 @@ int map_file( const struct suf_pat_t* psuf, const char* out_dir,
     int i, j, k;
     int len_in;
 
-    for ( i = psuf -> in_len - 1, j = ( len_in = strlen( fin ) ) - 1;
+    for ( i = psuf -> in_len - 1, j = ( len_in = strip_compression( fin ) ) - 1;
           i > -1 && j > -1;
           --i, --j )
         if ( psuf -> in_suffix[ i ] != fin[ j ] ) return 0;
@@ -246,7 +345,16 @@ int map_file( const struct suf_pat_t* psuf, const char* out_dir,
         fout[ i ] = psuf -> out_suffix[j];
     
     fout[ i ] = 0;
-    
+
+    if ( access( fout, F_OK ) == 0 ) return 1;
+
+    for ( j = 0; compress_suffix[j] != NULL; ++j ) {
+        strcpy( fout + i, compress_suffix[j] );
+        if ( access( fout, F_OK ) == 0 ) return 1;
+    }
+
+    // Nothing there, report the plain name
+    fout[ i ] = 0;
     return 1;
 }
 
@@ -255,33 +363,38 @@ void close_pattern( struct suf_pat_t* psuf )
     if ( psuf != NULL ) free( psuf );
 }
 
+const char* get_decompressor( const char* fname )
+{
+    int t;
+
+    t = compress_type( fname );
+    return t == -1 ? NULL : decompressor[t];
+}
+
+int strip_compression( const char* fname )
+{
+    int t, len;
+
+    len = strlen( fname );
+    t = compress_type( fname );
+    return t == -1 ? len : len - strlen( compress_suffix[t] );
+}
+
 /*
  * Note that the file is not actually opened.
  */
 int file_exist( const char* fname )
 {
-    extern int errno;
+    struct stat st;
 
-    errno = 0;
-    if ( open( fname, O_CREAT | O_EXCL ) == -1 
-         && errno == EEXIST ) {
-        return 1;
-    }
-    
-    return 0;
+    return ( stat( fname, &st ) == 0 );
 }
 
 int folder_exist( const char* folder )
 {
-    extern int errno;
+    struct stat st;
 
-    errno = 0;
-    if ( open( folder, O_WRONLY ) == -1
-         && errno == EISDIR ) {
-        return 1;
-    }
-    
-    return 0;
+    return ( stat( folder, &st ) == 0 && S_ISDIR( st.st_mode ) );
 }
 
 // Exam the magic number of an executable file
@@ -291,7 +404,7 @@ int is_binary_file( const char* fname )
     int fd, number;
     char buf[ MAGIC_NUMBER_LEN + 1 ];
     
-    if ( ( fd = open( fname, O_RDONLY ) ) == -1 )
+    if ( ( fd = open( fname, O_RDONLY | O_CLOEXEC ) ) == -1 )
         // Unexpected error, maybe this file doesn't exist?
         return 0;
 
@@ -315,20 +428,21 @@ int is_binary_file( const char* fname )
 // Copy file
 int file_copy( const char* psrc, const char* pdest )
 {
+    char buf[ CHUNK_SIZE ];
     int ret, fd1, fd2;
 
-    if ( ( fd1 = open( psrc, O_RDONLY ) ) == -1 ) {
+    if ( ( fd1 = open( psrc, O_RDONLY | O_CLOEXEC ) ) == -1 ) {
         return 0;
     }
 
-    if ( ( fd2 = open( pdest, O_CREAT | O_WRONLY | O_TRUNC,
+    if ( ( fd2 = open( pdest, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
                        S_IRUSR | S_IWUSR ) ) == -1 ) {
         close( fd1 );
         return 0;
     }
 
-    while ( (ret = read( fd1, tmp_buf, CHUNK_SIZE )) ) {
-        if ( write( fd2, tmp_buf, ret ) < ret ) {
+    while ( (ret = read( fd1, buf, CHUNK_SIZE )) ) {
+        if ( write( fd2, buf, ret ) < ret ) {
 #ifdef DEBUG
             fprintf( stderr, "Write %s error.\n", pdest );
 #endif
@@ -65,15 +65,15 @@ extern int
 reopen_folder( struct dir_info_t* );
 
 /*
- * Rename a folder using 'mv' command.
- * From Arg1 to Arg2.
+ * Move a folder from Arg1 to Arg2, into Arg2 if that is a folder.
+ * It is renamed in place, or copied and removed across file systems.
  */
 extern int
 rename_folder( const char*, const char* );
 
 /*
- * Delete a folder using 'rm' command.
- * Delete all files reside in this folder.
+ * Delete a folder and all files reside in this folder.
+ * A missing folder is not an error.
  */
 extern int
 remove_folder( const char* );
@@ -121,6 +121,20 @@ map_file( const struct suf_pat_t*, const char*,
 extern void
 close_pattern( struct suf_pat_t* );
 
+/*
+ * Tell how a data file is compressed, by its suffix (.gz or .zst).
+ * Return the program decompressing it to the standard output,
+ * or NULL if the file is not compressed.
+ */
+extern const char*
+get_decompressor( const char* );
+
+/*
+ * Return the length of the name Arg1 without its compression suffix.
+ */
+extern int
+strip_compression( const char* );
+
 /*
  * To check if a particular file is exist.
  * Return 0 if file doesn't exist, 1 does. 
@@ -0,0 +1,275 @@
+/*
+ * Every class is fitted in log space: log t = log c + log f(n), so each size
+ * weighs the same whatever its time, and the class leaving the smallest
+ * residual wins. The exponent is the slope of log t over log n.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "consts.h"
+#include "libprocs.h"
+#include "runtime.h"
+#include "judge.h"
+#include "report.h"
+#include "growth.h"
+
+#define DEFAULT_SIZE_REPS	3
+
+// A larger class and this much larger exponent make a program worse than the reference
+#define WORSE_EXPONENT		0.15
+
+static double f_one( double n ) { (void)n; return 1; }
+static double f_log( double n ) { return log( n ); }
+static double f_n( double n ) { return n; }
+static double f_nlog( double n ) { return n * log( n ); }
+static double f_n2( double n ) { return n * n; }
+static double f_n2log( double n ) { return n * n * log( n ); }
+static double f_n3( double n ) { return n * n * n; }
+
+// From the slowest growing up
+static const struct
+{
+    const char* name;
+    double (*f)( double );
+} classes[] = {
+    { "O(1)", f_one },
+    { "O(log n)", f_log },
+    { "O(n)", f_n },
+    { "O(n log n)", f_nlog },
+    { "O(n^2)", f_n2 },
+    { "O(n^2 log n)", f_n2log },
+    { "O(n^3)", f_n3 },
+    { NULL, NULL }
+};
+
+struct growth_t
+{
+    double exponent;
+    int cls;
+    double coef;            // log c of the class
+};
+
+int growth_parse( struct sys_arg_t* parg, const char* spec )
+{
+    const char* p = spec;
+    char* end;
+    long long n;
+
+    parg -> num_sizes = 0;
+    parg -> size_reps = DEFAULT_SIZE_REPS;
+    parg -> predict_size = 0;
+
+    while ( 1 ) {
+        n = strtoll( p, &end, 10 );
+        if ( end == p || n < 2 || parg -> num_sizes == MAX_SIZES ) return 0;
+        parg -> sizes[ parg -> num_sizes++ ] = n;
+
+        p = end;
+        if ( *p != ',' ) break;
+        ++p;
+    }
+
+    if ( *p == 'x' ) {
+        parg -> size_reps = strtol( p + 1, &end, 10 );
+        if ( end == p + 1 || parg -> size_reps <= 0 ) return 0;
+        p = end;
+    }
+
+    if ( *p == '@' ) {
+        parg -> predict_size = strtoll( p + 1, &end, 10 );
+        if ( end == p + 1 || parg -> predict_size < 2 ) return 0;
+        p = end;
+    }
+
+    return *p == 0 && parg -> num_sizes >= 2;
+}
+
+/*
+ * User and system time: where the split between them is sampled by ticks,
+ * their sum is still exact, which small sizes need.
+ */
+static long long cpu_us( struct RESUSE* resp )
+{
+    return time_used_us( resp ) +
+        resp -> ru.ru_stime.tv_sec * 1000000LL + resp -> ru.ru_stime.tv_usec;
+}
+
+static int cmp_ll( const void* a, const void* b )
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return x < y ? -1 : ( x > y );
+}
+
+// Median in place
+static long long median( long long* v, int n )
+{
+    qsort( v, n, sizeof( long long ), cmp_ll );
+    return v[ n / 2 ];
+}
+
+static void fit( const long long* sizes, const double* us, int n, struct growth_t* pg )
+{
+    double x, y, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double c, r, best = -1;
+    int i, k;
+
+    for ( i = 0; i < n; ++i ) {
+        x = log( (double)sizes[i] );
+        y = log( us[i] );
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    x = n * sxx - sx * sx;
+    pg -> exponent = ( x > 0 ? ( n * sxy - sx * sy ) / x : 0 );
+
+    for ( k = 0; classes[k].name != NULL; ++k ) {
+        for ( c = 0, i = 0; i < n; ++i )
+            c += log( us[i] ) - log( classes[k].f( sizes[i] ) );
+        c /= n;
+
+        for ( r = 0, i = 0; i < n; ++i ) {
+            y = log( us[i] ) - log( classes[k].f( sizes[i] ) ) - c;
+            r += y * y;
+        }
+
+        if ( best < 0 || r < best ) {
+            best = r;
+            pg -> cls = k;
+            pg -> coef = c;
+        }
+    }
+}
+
+int growth_judge( struct sys_arg_t* parg )
+{
+    int np = parg -> num_of_progs, ns = parg -> num_sizes, reps = parg -> size_reps;
+    long long *times = NULL, *v = NULL, target, us;
+    double* med = NULL;
+    int *verdicts = NULL, *wrong = NULL;
+    struct prog_stat_t* stats = NULL;
+    struct growth_t* growth = NULL;
+    struct growth_t* ref;
+    const char* interp = interpreter_of( parg -> gen_prog );
+    int j, s, r, case_no, corrected, ok = 0;
+    long long start;
+
+    if ( ( times = ( long long* )malloc( ns * reps * np * sizeof( long long ) ) ) == NULL ||
+         ( v = ( long long* )malloc( reps * sizeof( long long ) ) ) == NULL ||
+         ( med = ( double* )malloc( ns * np * sizeof( double ) ) ) == NULL ||
+         ( verdicts = ( int* )malloc( np * sizeof( int ) ) ) == NULL ||
+         ( wrong = ( int* )calloc( np, sizeof( int ) ) ) == NULL ||
+         ( stats = ( struct prog_stat_t* )malloc( np * sizeof( struct prog_stat_t ) ) ) == NULL ||
+         ( growth = ( struct growth_t* )malloc( np * sizeof( struct growth_t ) ) ) == NULL ) {
+#ifdef DEBUG
+        fprintf( stderr, "Out of memory: %s(%d)\n",
+                 __FILE__, __LINE__ );
+#endif
+        goto release_code;
+    }
+
+    for ( j = 0; j < np; ++j )
+        stat_init( stats + j, parg -> calib_runs > 0 );
+
+    target = ( parg -> predict_size > 0 ? parg -> predict_size : parg -> sizes[ ns - 1 ] );
+    // Cases made ahead would get the size of the time they were started
+    parg -> gen_jobs = 1;
+    parg -> runs = ns * reps;
+    case_no = 1;
+    start = phase_clock();
+
+    for ( s = 0; s < ns; ++s ) {
+        parg -> case_size = parg -> sizes[s];
+
+        for ( r = 0; r < reps; ++r, ++case_no ) {
+            if ( !get_next_input( parg ) ) {
+                printf( "Generate size %lld failed, terminated.\n", parg -> sizes[s] );
+                goto release_code;
+            }
+
+            if ( !judge_case( parg, verdicts ) ) {
+                printf( "Get standard answer error, terminated.\n" );
+                goto release_code;
+            }
+
+            report_case( parg, case_no, NULL );
+
+            for ( j = 0; j < np; ++j ) {
+                corrected = ( parg -> calib_runs > 0 ?
+                              time_corrected( parg -> resp[j], &(parg -> res_cons) ) : -1 );
+                us = time_used_us( parg -> resp[j] );
+
+                report_result( parg, j, verdicts[j], time_used( parg -> resp[j] ), corrected,
+                               mem_used( parg -> resp[j] ), out_used( parg -> resp[j] ),
+                               parg -> resp[j] );
+                stat_add( stats + j, us, corrected, mem_used( parg -> resp[j] ),
+                          parg -> resp[j], case_no, NULL );
+
+                // Only the time after the launch overhead grows with the size
+                us = cpu_us( parg -> resp[j] );
+                if ( parg -> calib_runs > 0 ) us -= parg -> res_cons.cpu_overhead;
+                times[ ( s * reps + r ) * np + j ] = ( us < 1 ? 1 : us );
+
+                if ( verdicts[j] != RES_AC && !wrong[j] ) {
+                    wrong[j] = 1;
+                    printf( "Prog %5d: %s at size %lld, reproduce the input by: %s%s%s %llu %d %lld\n",
+                            j, pres_text[ verdicts[j] ], parg -> sizes[s],
+                            interp ? interp : "", interp ? " " : "", parg -> gen_prog,
+                            parg -> case_seed, case_no, parg -> sizes[s] );
+                }
+            }
+
+            report_case_end( parg );
+        }
+
+        // Median over the repetitions
+        printf( "Size = %12lld:", parg -> sizes[s] );
+        for ( j = 0; j < np; ++j ) {
+            for ( r = 0; r < reps; ++r ) v[r] = times[ ( s * reps + r ) * np + j ];
+            us = median( v, reps );
+            med[ j * ns + s ] = us;
+            printf( "%s Prog %d = %.3fms", j > 0 ? "," : "", j, us / 1000.0 );
+        }
+        putchar( '\n' );
+        fflush( stdout );
+    }
+
+    parg -> judge_ns += phase_clock() - start;
+
+    for ( j = 0; j < np; ++j )
+        fit( parg -> sizes, med + j * ns, ns, growth + j );
+
+    ref = growth + parg -> std_inx;
+    printf( "\nGrowth, predicted at size %lld:\n", target );
+    for ( j = 0; j < np; ++j ) {
+        printf( "Prog %5d: Exponent = %5.2f, Predicted = %12.3fms, Best fit = %s",
+                j, growth[j].exponent,
+                exp( growth[j].coef ) * classes[ growth[j].cls ].f( target ) / 1000.0,
+                classes[ growth[j].cls ].name );
+
+        if ( j == parg -> std_inx )
+            printf( ", standard program" );
+        else if ( growth[j].cls > ref -> cls &&
+                  growth[j].exponent > ref -> exponent + WORSE_EXPONENT )
+            printf( ", scales worse than the standard program" );
+        putchar( '\n' );
+    }
+
+    report_close( parg, stats );
+    ok = 1;
+
+  release_code:
+    free( times );
+    free( v );
+    free( med );
+    free( verdicts );
+    free( wrong );
+    free( stats );
+    free( growth );
+    return ok;
+}
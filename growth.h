@@ -0,0 +1,30 @@
+/*
+ * Empirical complexity: the generator is given growing sizes, every program
+ * is timed at each size, and its times are fitted against the usual
+ * complexity classes.
+ * By richardxx, 2009.6
+ */
+
+#ifndef GROWTH_H
+#define GROWTH_H
+
+#include "type_def.h"
+
+/*
+ * Read the sizes "N1,N2,...[xREPS][@SIZE]" into Arg1: the generator is run
+ * REPS times at every size, the times are predicted at SIZE (the largest size by default).
+ * Return 0 if Arg2 is malformed.
+ */
+extern
+int growth_parse( struct sys_arg_t*, const char* );
+
+/*
+ * Time all programs at the sizes, and print the growth of each one:
+ * its exponent, the class fitting best and the predicted time.
+ * Programs scaling worse than the standard program are flagged.
+ * Return 0 if unexpected errors occurred, otherwise 1.
+ */
+extern
+int growth_judge( struct sys_arg_t* );
+
+#endif
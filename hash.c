@@ -0,0 +1,159 @@
+/*
+ * SHA-256 as described in FIPS 180-2.
+ * Small and dependency free, we only need it to name files by content.
+ * By richardxx, 2009.6
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "hash.h"
+
+#define CHUNK_SIZE		65536
+
+#define ROR( x, n )		( ( (x) >> (n) ) | ( (x) << ( 32 - (n) ) ) )
+#define CH( x, y, z )	( ( (x) & (y) ) ^ ( ~(x) & (z) ) )
+#define MAJ( x, y, z )	( ( (x) & (y) ) ^ ( (x) & (z) ) ^ ( (y) & (z) ) )
+#define EP0( x )		( ROR( x, 2 ) ^ ROR( x, 13 ) ^ ROR( x, 22 ) )
+#define EP1( x )		( ROR( x, 6 ) ^ ROR( x, 11 ) ^ ROR( x, 25 ) )
+#define SIG0( x )		( ROR( x, 7 ) ^ ROR( x, 18 ) ^ ( (x) >> 3 ) )
+#define SIG1( x )		( ROR( x, 17 ) ^ ROR( x, 19 ) ^ ( (x) >> 10 ) )
+
+static const unsigned int k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void transform( struct hash_ctx_t* ctx, const unsigned char* data )
+{
+    unsigned int a, b, c, d, e, f, g, h, t1, t2, m[64];
+    int i;
+
+    for ( i = 0; i < 16; ++i )
+        m[i] = ( data[i*4] << 24 ) | ( data[i*4+1] << 16 ) |
+            ( data[i*4+2] << 8 ) | data[i*4+3];
+    for ( ; i < 64; ++i )
+        m[i] = SIG1( m[i-2] ) + m[i-7] + SIG0( m[i-15] ) + m[i-16];
+
+    a = ctx -> state[0]; b = ctx -> state[1];
+    c = ctx -> state[2]; d = ctx -> state[3];
+    e = ctx -> state[4]; f = ctx -> state[5];
+    g = ctx -> state[6]; h = ctx -> state[7];
+
+    for ( i = 0; i < 64; ++i ) {
+        t1 = h + EP1( e ) + CH( e, f, g ) + k[i] + m[i];
+        t2 = EP0( a ) + MAJ( a, b, c );
+        h = g; g = f; f = e;
+        e = d + t1;
+        d = c; c = b; b = a;
+        a = t1 + t2;
+    }
+
+    ctx -> state[0] += a; ctx -> state[1] += b;
+    ctx -> state[2] += c; ctx -> state[3] += d;
+    ctx -> state[4] += e; ctx -> state[5] += f;
+    ctx -> state[6] += g; ctx -> state[7] += h;
+}
+
+void hash_init( struct hash_ctx_t* ctx )
+{
+    ctx -> state[0] = 0x6a09e667; ctx -> state[1] = 0xbb67ae85;
+    ctx -> state[2] = 0x3c6ef372; ctx -> state[3] = 0xa54ff53a;
+    ctx -> state[4] = 0x510e527f; ctx -> state[5] = 0x9b05688c;
+    ctx -> state[6] = 0x1f83d9ab; ctx -> state[7] = 0x5be0cd19;
+    ctx -> bits = 0;
+    ctx -> used = 0;
+}
+
+void hash_update( struct hash_ctx_t* ctx, const void* pdata, unsigned long len )
+{
+    const unsigned char* p = (const unsigned char*)pdata;
+    int n;
+
+    ctx -> bits += (unsigned long long)len << 3;
+
+    // Fill a partial block first
+    if ( ctx -> used > 0 ) {
+        n = 64 - ctx -> used;
+        if ( (unsigned long)n > len ) n = len;
+        memcpy( ctx -> block + ctx -> used, p, n );
+        ctx -> used += n;
+        p += n;
+        len -= n;
+        if ( ctx -> used < 64 ) return;
+        transform( ctx, ctx -> block );
+        ctx -> used = 0;
+    }
+
+    for ( ; len >= 64; p += 64, len -= 64 )
+        transform( ctx, p );
+
+    memcpy( ctx -> block, p, len );
+    ctx -> used = len;
+}
+
+void hash_final( struct hash_ctx_t* ctx, unsigned char* digest )
+{
+    int i;
+
+    ctx -> block[ ctx -> used++ ] = 0x80;
+    if ( ctx -> used > 56 ) {
+        memset( ctx -> block + ctx -> used, 0, 64 - ctx -> used );
+        transform( ctx, ctx -> block );
+        ctx -> used = 0;
+    }
+
+    memset( ctx -> block + ctx -> used, 0, 56 - ctx -> used );
+    for ( i = 0; i < 8; ++i )
+        ctx -> block[ 63 - i ] = ( ctx -> bits >> ( i * 8 ) ) & 0xff;
+    transform( ctx, ctx -> block );
+
+    for ( i = 0; i < 32; ++i )
+        digest[i] = ( ctx -> state[ i >> 2 ] >> ( 24 - ( i & 3 ) * 8 ) ) & 0xff;
+}
+
+void hash_to_hex( const unsigned char* digest, char* hex )
+{
+    static const char digits[] = "0123456789abcdef";
+    int i;
+
+    for ( i = 0; i < HASH_LEN; ++i ) {
+        hex[ i*2 ] = digits[ digest[i] >> 4 ];
+        hex[ i*2 + 1 ] = digits[ digest[i] & 15 ];
+    }
+    hex[ HASH_HEX_LEN ] = 0;
+}
+
+int hash_file( const char* fname, char* hex, long long* plen )
+{
+    struct hash_ctx_t ctx;
+    unsigned char buf[ CHUNK_SIZE ], digest[ HASH_LEN ];
+    long long tot = 0;
+    int fd, ret;
+
+    if ( ( fd = open( fname, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+
+    hash_init( &ctx );
+    while ( ( ret = read( fd, buf, CHUNK_SIZE ) ) > 0 ) {
+        hash_update( &ctx, buf, ret );
+        tot += ret;
+    }
+    close( fd );
+
+    if ( ret < 0 ) return 0;
+
+    hash_final( &ctx, digest );
+    hash_to_hex( digest, hex );
+    if ( plen != NULL ) *plen = tot;
+
+    return 1;
+}
@@ -0,0 +1,38 @@
+/*
+ * Content hashing used to identify programs and test data.
+ * A plain SHA-256, so equal digests can be trusted as equal contents.
+ * By richardxx, 2009.6
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#define HASH_LEN		32
+#define HASH_HEX_LEN	( HASH_LEN * 2 )
+
+struct hash_ctx_t
+{
+    unsigned int state[8];
+    unsigned long long bits;
+    unsigned char block[64];
+    int used;
+};
+
+extern void hash_init( struct hash_ctx_t* );
+extern void hash_update( struct hash_ctx_t*, const void*, unsigned long );
+extern void hash_final( struct hash_ctx_t*, unsigned char* );
+
+/*
+ * Convert a digest to its lower case hex form.
+ * Arg2 must hold at least HASH_HEX_LEN + 1 characters.
+ */
+extern void hash_to_hex( const unsigned char*, char* );
+
+/*
+ * Digest a whole file.
+ * Arg2 receives the hex digest, Arg3 (if not NULL) the file length.
+ * Return 0 if the file cannot be read, otherwise 1.
+ */
+extern int hash_file( const char*, char*, long long* );
+
+#endif
@@ -4,27 +4,49 @@
  * These functions are automatically inserted by GCC, you cannot find callsites anywhere.
  * Specially notice the attributes attached to each function.
  *
+ * Every thread appends fixed size binary records to its own ring buffer,
+ * a background thread drains the rings into trace_tester.bin.
+ * Nothing is formatted while the tester runs, use trace2json to read the trace.
+ * A full ring drops records rather than waiting, the loss is recorded.
+ * Only the process that started tracing is traced, forked children are not.
+ *
  * By richardxx, 2009.4
+ * Revised in 2009.6
  */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <errno.h>
-#include <sys/time.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "trace.h"
 
-/*
- * Use a stack to manage the time consumming records.
- * Actually, all items are in reverse order.
- */
-struct stack_item
+#define RING_SIZE		65536	// records, a power of 2
+#define MAX_THREADS		64
+#define FLUSH_INTERVAL	10		// ms
+
+struct trace_ring_t
 {
-    struct timeval t;
-    struct stack_item *next;
+    struct trace_rec_t recs[ RING_SIZE ];
+    uint64_t head, tail;        // head written by the owner, tail by the flusher
+    uint64_t dropped;
+    uint32_t tid;
 };
 
-static struct stack_item *stk_head = NULL;
-static struct stack_item *cached_stk_head = NULL;
-static FILE *__flog = NULL;
+static struct trace_ring_t* rings[ MAX_THREADS ];
+static int num_rings = 0;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct trace_ring_t* my_ring = NULL;
+
+// A bare descriptor, a forked child has no stdio buffer of it to flush
+static int fd_log = -1;
+static pthread_t flusher;
+static volatile int running = 0;
+static int flusher_started = 0;
+static pid_t owner = 0;
 
 /*
  * Declarations (Must?)
@@ -41,58 +63,194 @@ __attribute__ ((no_instrument_function, constructor));
 void main_destructor( void )
 __attribute__ ((no_instrument_function, destructor));
 
+void trace_anchor( void )
+__attribute__ ((no_instrument_function, noinline));
 
+static void record( void*, uint32_t )
+__attribute__ ((no_instrument_function));
 
-void __cyg_profile_func_enter( void *this, void *callsite )
+static void write_log( const void*, size_t )
+__attribute__ ((no_instrument_function));
+
+static void flush_rings( void )
+__attribute__ ((no_instrument_function));
+
+static void* flusher_main( void* )
+__attribute__ ((no_instrument_function));
+
+static void stop_in_child( void )
+__attribute__ ((no_instrument_function));
+
+
+void trace_anchor( void )
 {
-    struct stack_item *p;
+}
+
+static void record( void* fn, uint32_t type )
+{
+    struct trace_ring_t* r = my_ring;
+    struct trace_rec_t* p;
+    struct timespec ts;
+    uint64_t h;
+
+    if ( !running ) return;
 
-    if ( cached_stk_head != NULL ) {
-        p = cached_stk_head;
-        cached_stk_head = cached_stk_head -> next;
+    if ( r == NULL ) {
+        // First record of this thread
+        r = ( struct trace_ring_t* )calloc( 1, sizeof( struct trace_ring_t ) );
+        if ( r == NULL ) return;
+        r -> tid = (uint32_t)syscall( SYS_gettid );
+
+        pthread_mutex_lock( &rings_lock );
+        if ( num_rings < MAX_THREADS ) rings[ num_rings++ ] = r;
+        else {
+            free( r );
+            r = NULL;
+        }
+        pthread_mutex_unlock( &rings_lock );
+
+        if ( ( my_ring = r ) == NULL ) return;
     }
-    else {
-        p = (struct stack_item*)malloc( sizeof( struct stack_item ) );
+
+    h = r -> head;
+    if ( h - __atomic_load_n( &r -> tail, __ATOMIC_ACQUIRE ) == RING_SIZE ) {
+        ++r -> dropped;
+        return;
     }
-    
-    gettimeofday( &(p->t), NULL );
-    fprintf( __flog, "E%p\n", (int*)this );
-    
-    p->next = stk_head;
-    stk_head = p;
+
+    clock_gettime( CLOCK_MONOTONIC_RAW, &ts );
+
+    p = r -> recs + ( h & ( RING_SIZE - 1 ) );
+    p -> ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    p -> fn = (uint64_t)(uintptr_t)fn;
+    p -> tid = r -> tid;
+    p -> type = type;
+
+    __atomic_store_n( &r -> head, h + 1, __ATOMIC_RELEASE );
+}
+
+void __cyg_profile_func_enter( void *this, void *callsite )
+{
+    record( this, TRACE_ENTER );
 }
 
 void __cyg_profile_func_exit( void *this, void *callsite )
 {
-    struct stack_item *p;
-    struct timeval now;
-    int res;
-    
-    p = stk_head;
-    stk_head = stk_head -> next;
-
-    gettimeofday( &now, NULL );
-    res = (now.tv_sec - p->t.tv_sec) * 1000 + (now.tv_usec - p->t.tv_usec) / 1000;
-    fprintf( __flog, "X%p %d\n", (int*)this, res );
-
-    p -> next = cached_stk_head;
-    cached_stk_head = p;
+    record( this, TRACE_EXIT );
+}
+
+static void write_log( const void* buf, size_t len )
+{
+    ssize_t ret;
+
+    while ( len > 0 && ( ret = write( fd_log, buf, len ) ) > 0 ) {
+        buf = (const char*)buf + ret;
+        len -= ret;
+    }
+}
+
+/*
+ * Move everything recorded so far to the file.
+ */
+static void flush_rings( void )
+{
+    struct trace_ring_t* r;
+    struct trace_rec_t drop;
+    uint64_t h, t, n;
+    int i, cnt;
+
+    pthread_mutex_lock( &rings_lock );
+    cnt = num_rings;
+    pthread_mutex_unlock( &rings_lock );
+
+    for ( i = 0; i < cnt; ++i ) {
+        r = rings[i];
+        h = __atomic_load_n( &r -> head, __ATOMIC_ACQUIRE );
+        t = r -> tail;
+
+        while ( t < h ) {
+            // Up to the end of the ring at a time
+            n = RING_SIZE - ( t & ( RING_SIZE - 1 ) );
+            if ( n > h - t ) n = h - t;
+            write_log( r -> recs + ( t & ( RING_SIZE - 1 ) ),
+                       n * sizeof( struct trace_rec_t ) );
+            t += n;
+        }
+
+        __atomic_store_n( &r -> tail, t, __ATOMIC_RELEASE );
+
+        n = __atomic_exchange_n( &r -> dropped, 0, __ATOMIC_RELAXED );
+        if ( n > 0 ) {
+            memset( &drop, 0, sizeof( drop ) );
+            drop.fn = n;
+            drop.tid = r -> tid;
+            drop.type = TRACE_DROP;
+            write_log( &drop, sizeof( drop ) );
+        }
+    }
+}
+
+static void* flusher_main( void* arg )
+{
+    struct timespec gap = { 0, FLUSH_INTERVAL * 1000000 };
+
+    while ( running ) {
+        nanosleep( &gap, NULL );
+        flush_rings();
+    }
+
+    return NULL;
+}
+
+/*
+ * A forked child neither records nor touches the parent's file.
+ */
+static void stop_in_child( void )
+{
+    running = 0;
 }
 
 void main_constructor( void )
 {
-    __flog = fopen( "trace_tester.txt", "w" );
-    if ( __flog == NULL ) {
+    struct trace_header_t header;
+    ssize_t len;
+
+    fd_log = open( TRACE_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if ( fd_log == -1 ) {
 #ifdef DEBUG
         fprintf( stderr, "Profile program failed, caused by:\n" );
         perror( NULL );
 #endif
         exit(-1);
     }
+
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, TRACE_MAGIC, TRACE_MAGIC_LEN );
+    header.version = TRACE_VERSION;
+    header.pid = owner = getpid();
+    header.anchor = (uint64_t)(uintptr_t)trace_anchor;
+    len = readlink( "/proc/self/exe", header.exe, TRACE_PATH_LEN - 1 );
+    if ( len > 0 ) header.exe[ len ] = 0;
+    write_log( &header, sizeof( header ) );
+
+    pthread_atfork( NULL, NULL, stop_in_child );
+
+    // Without the flusher, records are kept until the rings are full
+    running = 1;
+    flusher_started = ( pthread_create( &flusher, NULL, flusher_main, NULL ) == 0 );
 }
 
 void main_destructor( void )
 {
-    if ( __flog != NULL )
-        fclose( __flog );
+    if ( fd_log == -1 ) return;
+
+    // The flusher doesn't exist in a forked child
+    if ( getpid() != owner ) return;
+
+    running = 0;
+    if ( flusher_started ) pthread_join( flusher, NULL );
+
+    flush_rings();
+    close( fd_log );
+    fd_log = -1;
 }
@@ -0,0 +1,273 @@
+/*
+ * The journal is text: a header line naming the run, then a line per case
+ *   <id> <seed> <time limit> <programs> <14 numbers per program> :<name>
+ * the numbers being the verdict, the corrected time, the output size and the
+ * resource usage of the program, so a resumed run sums up exactly as the
+ * interrupted one would have.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "consts.h"
+#include "hash.h"
+#include "libprocs.h"
+#include "runtime.h"
+#include "report.h"
+#include "journal.h"
+
+#define JOURNAL_MAGIC	"tester-journal 1"
+
+// Numbers per program in a line
+#define RES_FIELDS		14
+
+// The journal is flushed to disk this often (ms)
+#define SYNC_INTERVAL	1000
+
+struct jcase_t
+{
+    int id, limit;
+    unsigned long long seed;
+    char* name;
+    long long* f;
+};
+
+// Cases of the resumed run, case k at k - 1
+static struct jcase_t* cases = NULL;
+static int num_cases = 0;
+
+static FILE* fp = NULL;
+static int opened = 0, num_progs = 0;
+static long long last_sync = 0;
+static char file_name[ FILE_NAME_LEN + 1 ];
+static char digest[ HASH_HEX_LEN + 1 ];
+
+// Read a case line into Arg1, return 0 if malformed
+static int parse_case( struct jcase_t* pc, char* line )
+{
+    char *p = line, *end;
+    int i, np;
+
+    pc -> id = strtol( p, &end, 10 );
+    pc -> seed = strtoull( end, &end, 10 );
+    pc -> limit = strtol( end, &end, 10 );
+    np = strtol( end, &end, 10 );
+    if ( np != num_progs ) return 0;
+
+    if ( ( pc -> f = ( long long* )malloc( np * RES_FIELDS * sizeof( long long ) ) ) == NULL )
+        return 0;
+
+    for ( i = 0; i < np * RES_FIELDS; ++i ) {
+        p = end;
+        pc -> f[i] = strtoll( p, &end, 10 );
+        if ( end == p ) break;
+    }
+
+    if ( i < np * RES_FIELDS || strncmp( end, " :", 2 ) != 0 ||
+         ( pc -> name = strdup( end + 2 ) ) == NULL ) {
+        free( pc -> f );
+        return 0;
+    }
+
+    return 1;
+}
+
+// Load the cases of the journal, return the length of the whole lines
+static long load_cases( FILE* jfp )
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    struct jcase_t* p;
+    long valid = ftell( jfp );
+    int max_cases = 0;
+
+    while ( ( len = getline( &line, &size, jfp ) ) > 0 && line[ len - 1 ] == '\n' ) {
+        line[ len - 1 ] = 0;
+
+        if ( num_cases == max_cases ) {
+            max_cases = ( max_cases == 0 ? 256 : max_cases * 2 );
+            p = ( struct jcase_t* )realloc( cases, max_cases * sizeof( struct jcase_t ) );
+            if ( p == NULL ) break;
+            cases = p;
+        }
+
+        if ( !parse_case( cases + num_cases, line ) ) break;
+        if ( cases[ num_cases ].id != num_cases + 1 ) {
+            free( cases[ num_cases ].f );
+            free( cases[ num_cases ].name );
+            break;
+        }
+
+        ++num_cases;
+        valid = ftell( jfp );
+    }
+
+    free( line );
+    return valid;
+}
+
+int journal_open( struct sys_arg_t* parg, const char* fname, const char* run, int resume )
+{
+    char header[ 256 ], d[ HASH_HEX_LEN + 1 ];
+    unsigned long long seed;
+    FILE* jfp;
+    long valid;
+
+    strncpy( file_name, fname, FILE_NAME_LEN );
+    strncpy( digest, run, HASH_HEX_LEN );
+    num_progs = parg -> num_of_progs;
+    opened = 0;
+
+    // A new journal is created by the first case, the old one is kept until then
+    if ( !resume ) return 1;
+
+    if ( ( jfp = fopen( fname, "re" ) ) == NULL ) return 0;
+
+    if ( fgets( header, sizeof( header ), jfp ) == NULL ||
+         sscanf( header, JOURNAL_MAGIC " %64s %llu", d, &seed ) != 2 ||
+         strcmp( d, digest ) != 0 ) {
+        fclose( jfp );
+        return 0;
+    }
+
+    valid = load_cases( jfp );
+    fclose( jfp );
+
+    // Cut what the crash left of the last line, and go on after it
+    if ( truncate( fname, valid ) == -1 ||
+         ( fp = fopen( fname, "ae" ) ) == NULL ) return 0;
+
+    opened = 1;
+    last_sync = phase_clock();
+    parg -> seed = seed;
+    return 1;
+}
+
+int journal_has( int id )
+{
+    return id >= 1 && id <= num_cases;
+}
+
+static void set_tv( struct timeval* tv, long long us )
+{
+    tv -> tv_sec = us / 1000000;
+    tv -> tv_usec = us % 1000000;
+}
+
+int journal_replay( struct sys_arg_t* parg, int id, int* verdicts, int* corrected )
+{
+    struct jcase_t* pc = cases + id - 1;
+    struct RESUSE* resp;
+    char name[ FILE_NAME_LEN + 1 ];
+    long long* f;
+    int i;
+
+    // The inputs must be the ones of the interrupted run
+    if ( phase_of_input( parg ) == PHASE_GENERATOR ) {
+        if ( pc -> seed != parg -> case_seed ) return 0;
+    }
+    else {
+        case_name( parg, name );
+        if ( strcmp( name, pc -> name ) != 0 ) return 0;
+    }
+
+    parg -> case_cons = parg -> res_cons;
+    parg -> case_cons.time_limit = pc -> limit;
+
+    for ( i = 0; i < num_progs; ++i ) {
+        f = pc -> f + i * RES_FIELDS;
+        resp = parg -> resp[i];
+        memset( resp, 0, sizeof( struct RESUSE ) );
+
+        verdicts[i] = f[0];
+        corrected[i] = f[1];
+        resp -> out_bytes = f[2];
+        set_tv( &( resp -> ru.ru_utime ), f[3] );
+        set_tv( &( resp -> ru.ru_stime ), f[4] );
+        resp -> ru.ru_maxrss = f[5];
+        resp -> ru.ru_minflt = f[6];
+        resp -> ru.ru_majflt = f[7];
+        resp -> ru.ru_nvcsw = f[8];
+        resp -> ru.ru_nivcsw = f[9];
+        resp -> ru.ru_inblock = f[10];
+        resp -> ru.ru_oublock = f[11];
+        resp -> noisy = f[12];
+        resp -> reruns = f[13];
+    }
+
+    return 1;
+}
+
+void journal_write( struct sys_arg_t* parg, int id, const int* verdicts, const int* corrected )
+{
+    struct RESUSE* resp;
+    char name[ FILE_NAME_LEN + 1 ];
+    long long now;
+    int i;
+
+    if ( fp == NULL ) {
+        // Tried once only
+        if ( opened ) return;
+        opened = 1;
+
+        if ( ( fp = fopen( file_name, "we" ) ) == NULL ) {
+            fprintf( stderr, "Warning: the journal %s can't be written.\n", file_name );
+            return;
+        }
+
+        fprintf( fp, JOURNAL_MAGIC " %s %llu\n", digest, parg -> seed );
+        last_sync = phase_clock();
+    }
+
+    name[0] = 0;
+    if ( phase_of_input( parg ) != PHASE_GENERATOR ) case_name( parg, name );
+
+    fprintf( fp, "%d %llu %d %d", id, parg -> case_seed,
+             parg -> case_cons.time_limit, num_progs );
+
+    for ( i = 0; i < num_progs; ++i ) {
+        resp = parg -> resp[i];
+        fprintf( fp, " %d %d %lld %lld %lld %ld %ld %ld %ld %ld %ld %ld %d %d",
+                 verdicts[i], corrected[i], resp -> out_bytes, time_used_us( resp ),
+                 resp -> ru.ru_stime.tv_sec * 1000000LL + resp -> ru.ru_stime.tv_usec,
+                 resp -> ru.ru_maxrss, resp -> ru.ru_minflt, resp -> ru.ru_majflt,
+                 resp -> ru.ru_nvcsw, resp -> ru.ru_nivcsw,
+                 resp -> ru.ru_inblock, resp -> ru.ru_oublock,
+                 resp -> noisy, resp -> reruns );
+    }
+
+    fprintf( fp, " :%s\n", name );
+    fflush( fp );
+
+    // Written is safe from the tester dying, synced is safe from the host
+    now = phase_clock();
+    if ( now - last_sync >= SYNC_INTERVAL * 1000000LL ) {
+        fdatasync( fileno( fp ) );
+        last_sync = now;
+    }
+}
+
+void journal_close()
+{
+    int i;
+
+    if ( fp != NULL ) {
+        fflush( fp );
+        fdatasync( fileno( fp ) );
+        fclose( fp );
+        fp = NULL;
+    }
+
+    for ( i = 0; i < num_cases; ++i ) {
+        free( cases[i].f );
+        free( cases[i].name );
+    }
+
+    free( cases );
+    cases = NULL;
+    num_cases = 0;
+}
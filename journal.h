@@ -0,0 +1,43 @@
+/*
+ * Journal of the judged cases, so an interrupted run can be resumed.
+ * Every case is appended as one line when it is judged, a line cut short
+ * by a crash is ignored. The journal is flushed to disk every second.
+ * By richardxx, 2009.6
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "type_def.h"
+
+/*
+ * Journal the run of Arg1 into Arg2, Arg3 is a digest of its arguments.
+ * If Arg4 is set, the cases of the journal of the same run are loaded to be
+ * resumed and its seed is taken, otherwise the journal starts over with the first case.
+ * Return 0 if there is nothing to resume.
+ */
+extern
+int journal_open( struct sys_arg_t*, const char*, const char*, int );
+
+// Whether case Arg1 is in the journal
+extern
+int journal_has( int );
+
+/*
+ * Take case Arg2 from the journal instead of judging it, once its input is skipped:
+ * the usage of every program, the verdicts into Arg3 and the corrected times into Arg4.
+ * Return 0 if the case in the journal is not the current input.
+ */
+extern
+int journal_replay( struct sys_arg_t*, int, int*, int* );
+
+/*
+ * Append the judged case Arg2, with the verdicts Arg3 and corrected times Arg4.
+ */
+extern
+void journal_write( struct sys_arg_t*, int, const int*, const int* );
+
+extern
+void journal_close();
+
+#endif
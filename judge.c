@@ -8,135 +8,245 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "file.h"
+#include "report.h"
+#include "libsys.h"
 #include "libprocs.h"
 #include "runtime.h"
+#include "journal.h"
 #include "judge.h"
 
 /*
  * Print formatted result.
  */
-static void
-print_result( int id, struct RESUSE *resp, int res_type )
+void
+print_result( int id, int use_time, int corrected, int mem, long long out, int res_type )
 {
-  int mem, use_time;
-
-  // How many resources did the two programs use?
-  mem = use_time = 0;
-    
-  if ( resp != NULL ) {
-    use_time = time_used( resp );
-    mem = mem_used( resp );
-  }
-    
-  printf( "Prog %5d: Result=%25s, Time = %7ums, Memory = %7uKB\n",
-	  id, pres_text[ res_type ], use_time, mem );
+  printf( "Prog %5d: Result=%25s, Time = %7ums, ", id, pres_text[ res_type ], use_time );
+  if ( corrected >= 0 ) printf( "Corrected = %7ums, ", corrected );
+  printf( "Memory = %7uKB, Output = %9lldB\n", mem, out );
 }
 
 /*
  * Information about all cases.
  */
+void
+print_summary( int use_time, int corrected, int mem, int runs )
+{
+  if ( runs <= 0 ) runs = 1;
+
+  printf( "Tot. time = %8ums, Ave. time = %7ums, ", use_time, use_time / runs );
+  if ( corrected >= 0 ) printf( "Ave. corrected = %7ums, ", corrected / runs );
+  printf( "Ave. Memory = %7uKB\n", mem / runs );
+}
+
+/*
+ * Limit the tested programs relative to the standard program's time on this case.
+ */
 static void
-print_summary( struct RESUSE* resp, int runs )
+relative_limit( struct sys_arg_t* parg )
+{
+  struct RESUSE* ref = parg -> resp[ parg -> std_inx ];
+  long long ref_us, limit;
+
+  ref_us = time_used_us( ref );
+  if ( parg -> res_cons.corrected ) ref_us -= parg -> res_cons.cpu_overhead;
+  if ( ref_us < 0 ) ref_us = 0;
+
+  limit = (long long)( parg -> time_factor * ref_us / 1000 + 0.999 );
+  if ( limit < parg -> time_floor ) limit = parg -> time_floor;
+  parg -> case_cons.time_limit = limit;
+}
+
+/*
+ * Judge the prepared input against all programs.
+ */
+int
+judge_case( struct sys_arg_t* parg, int* verdicts )
 {
-  int mem, use_time;
+  int i, ret;
+  long long t;
+  char out_buf[ FILE_NAME_LEN + 128 ];
+
+  // Get correct output for this test 
+  t = phase_clock();
+  ret = get_standard_result( parg );
+  phase_add( parg, phase_of_result( parg ), t );
+  if ( !ret ) return 0;
+
+  parg -> case_cons = parg -> res_cons;
+  if ( parg -> time_factor > 0 ) relative_limit( parg );
+
+  /*
+   * For each program listed in command line prompt,
+   * generate its output and judge its correctness.
+   * An output read ahead stays RES_NORMAL, and is checked
+   * once the others have run.
+   */
+  for ( i = 0; i < parg -> num_of_progs; ++i ) {
+    sprintf( out_buf, "%s/prog%d_output.txt",
+	     parg -> di_temp -> folder_name, i );
+
+    t = phase_clock();
+    ret = run_user_program( i, out_buf, parg );
+    phase_add( parg, PHASE_PROGRAMS, t );
 
-  // How many resources did the two programs use?
-  mem = use_time = 0;
+    if ( ret == RES_NORMAL && !prefetch_output( parg, i, out_buf ) ) {
+      t = phase_clock();
+      ret = check_result( parg, out_buf );
+      phase_add( parg, PHASE_CHECK, t );
+    }
+
+    verdicts[i] = ret;
+  }
+
+  for ( i = 0; i < parg -> num_of_progs; ++i ) {
+    if ( verdicts[i] != RES_NORMAL ) continue;
     
-  if ( resp != NULL ) {
-    use_time = time_used( resp );
-    mem = mem_used( resp );
+    sprintf( out_buf, "%s/prog%d_output.txt",
+	     parg -> di_temp -> folder_name, i );
+
+    t = phase_clock();
+    verdicts[i] = check_result( parg, out_buf );
+    phase_add( parg, PHASE_CHECK, t );
   }
 
-  printf( "Tot. time = %8ums, Ave. time = %7ums, Ave. Memory = %7uKB\n",
-	  use_time, use_time / runs, mem / runs );
+  return 1;
 }
 
-
 /*
  * The judge main process.
  */
 int
 judge( struct sys_arg_t* parg )
 {
-  int i, case_no;
-  int ret, status, abnormal;
-  char* tmp_buf = NULL;
-  struct RESUSE** total_resp = NULL;
+  int i, case_no, last_no, ret;
+  int abnormal, replayed;
+  const char* interp = interpreter_of( parg -> gen_prog );
+  long long start, t;
+  int *verdicts = NULL, *corrected = NULL;
+  char name[ FILE_NAME_LEN + 1 ];
+  struct prog_stat_t* stats = NULL;
     
   // Prepare
-  if ( !malloc_all_var( FILE_NAME_LEN+128, &tmp_buf, NULL ) ||
-       ( total_resp = ( struct RESUSE**)malloc2d(
-						 parg -> num_of_progs,
-						 sizeof( struct RESUSE ) ) ) == NULL ) {
+  if ( !malloc_all_var( parg -> num_of_progs * sizeof( int ),
+			(char**)&verdicts, (char**)&corrected, NULL ) ||
+       ( stats = ( struct prog_stat_t* )malloc(
+					       parg -> num_of_progs *
+					       sizeof( struct prog_stat_t ) ) ) == NULL ) {
 #ifdef DEBUG
     fprintf( stderr, "Out of memory: %s(%d)\n",
 	     __FILE__, __LINE__ );
 #endif
+    free_all_var( (char*)verdicts, (char*)corrected, NULL );
     return 0;
   }
     
-  case_no = 1;
-  abnormal = 0;
+  case_no = last_no = 1;
+  abnormal = replayed = 0;
   for ( i = 0; i < parg -> num_of_progs; ++i )
-    resuse_start( total_resp[i] );
+    stat_init( stats + i, parg -> calib_runs > 0 );
 
   // Main loop
   // Note, the standard output produces twice 
-  while ( !abnormal &&
-	  get_next_input( parg ) ) {
+  start = phase_clock();
+  while ( !abnormal ) {
+    // Cases journaled by an interrupted run are taken as they were
+    replayed = ( parg -> journaled && journal_has( case_no ) );
+    
+    t = phase_clock();
+    ret = ( replayed ? skip_next_input( parg ) : get_next_input( parg ) );
+    phase_add( parg, phase_of_input( parg ), t );
+    if ( !ret ) break;
 
     // New test
-    printf( "Test %d:\n", case_no++ );
-        
-    // Get correct output for this test 
-    if ( !get_standard_result( parg ) ) {
+    last_no = case_no;
+    printf( "Test %d:\n", case_no );
+
+    if ( replayed ) {
+      if ( !journal_replay( parg, case_no, verdicts, corrected ) ) {
+	printf( "The journal doesn't match the input, terminated.\n" );
+	abnormal = 1;
+	break;
+      }
+    }
+    else if ( !judge_case( parg, verdicts ) ) {
       printf( "Get standard answer error, terminated.\n" );
       abnormal = 1;
       break;
     }
+    else {
+      for ( i = 0; i < parg -> num_of_progs; ++i )
+	corrected[i] = ( parg -> calib_runs > 0 ?
+			 time_corrected( parg -> resp[i], &(parg -> res_cons) ) : -1 );
+      if ( parg -> journaled ) journal_write( parg, case_no, verdicts, corrected );
+    }
 
-    /*
-     * For each program listed in command line prompt,
-     * generate its output and judge its correctness.
-     */
-    for ( i = 0; i < parg -> num_of_progs; ++i ) {
-      sprintf( tmp_buf, "%s/prog%d_output.txt",
-	       parg -> di_temp -> folder_name, i );
-
-      if ( ( ret =
-	     run_user_program( i, tmp_buf, parg ) ) == RES_NORMAL ) {
-                
-	ret = check_result( parg, tmp_buf );
-      }
+    if ( parg -> time_factor > 0 )
+      printf( "Time limit = %dms\n", parg -> case_cons.time_limit );
 
-      print_result( i, parg -> resp[i], ret );
+    case_name( parg, name );
+    if ( phase_of_input( parg ) == PHASE_GENERATOR ) name[0] = 0;
+    report_case( parg, case_no, name[0] ? name : NULL );
+    
+    for ( i = 0; i < parg -> num_of_progs; ++i ) {
+      print_result( i, time_used( parg -> resp[i] ), corrected[i],
+		    mem_used( parg -> resp[i] ), out_used( parg -> resp[i] ),
+		    verdicts[i] );
+      report_result( parg, i, verdicts[i], time_used( parg -> resp[i] ), corrected[i],
+		     mem_used( parg -> resp[i] ), out_used( parg -> resp[i] ),
+		     parg -> resp[i] );
+      if ( parg -> resp[i] -> noisy )
+	printf( "Prog %5d: Timing is noisy after %d re-runs\n",
+		i, parg -> resp[i] -> reruns );
             
-      resuse_add( total_resp[i], parg -> resp[i] );
+      stat_add( stats + i, time_used_us( parg -> resp[i] ), corrected[i],
+		mem_used( parg -> resp[i] ), parg -> resp[i],
+		case_no, name[0] ? name : NULL );
             
-      if ( ret != RES_AC ) abnormal = 1;
+      if ( verdicts[i] != RES_AC ) abnormal = 1;
     }
 
+    report_case_end( parg );
     putchar( '\n' );
-  }
 
-  // Print summary
-  printf( "Summary:\n" );
-  for ( i = 0; i < parg -> num_of_progs; ++i ) {
-    print_summary( total_resp[i], parg -> passed_cases );
+    if ( parg -> case_hook != NULL && !parg -> case_hook( parg, case_no, verdicts ) ) break;
+    ++case_no;
   }
+  close_input( parg );
+
+  // Generated cases are made again by their seed
+  if ( abnormal && phase_of_input( parg ) == PHASE_GENERATOR )
+    printf( "Reproduce the input of test %d by: %s%s%s %llu %d\n\n",
+	    last_no, interp ? interp : "", interp ? " " : "",
+	    parg -> gen_prog, parg -> case_seed, last_no );
 
-  // Copy data
-  if ( abnormal && parg -> dump_dir[0] ) {
+  // Copy data, a journaled case has left none
+  if ( abnormal && parg -> dump_dir[0] && !replayed ) {
     // Move temporary data to destination
+    t = phase_clock();
+    wait_io( parg );
     rename_folder( parg -> di_temp -> folder_name, parg -> dump_dir );
     close_folder( parg -> di_temp );
     parg -> di_temp = NULL;
+    phase_add( parg, PHASE_CLEANUP, t );
   }
+  parg -> judge_ns += phase_clock() - start;
+
+  // Print summary, averaged over the cases each program really ran
+  printf( "Summary:\n" );
+  for ( i = 0; i < parg -> num_of_progs; ++i )
+    print_summary( stats[i].time_us / 1000, stats[i].corrected,
+		   stats[i].mem_kb, stats[i].runs );
+  for ( i = 0; i < parg -> num_of_progs; ++i )
+    print_stat( i, stats + i );
+
+  if ( parg -> show_phases ) print_phases( parg );
+  report_close( parg, stats );
     
-  free_all_var( tmp_buf, NULL );
-  free2d( (char**)total_resp, parg -> num_of_progs );
+  free_all_var( (char*)verdicts, (char*)corrected, NULL );
+  free( stats );
     
   return 1;
 }
@@ -17,4 +17,24 @@
 extern
 int judge( struct sys_arg_t* );
 
+/*
+ * Judge one case whose input file is already prepared.
+ * Arg1 is the judge status structure;
+ * Arg2 receives the result code of each program.
+ * Return 0 if the standard answer cannot be obtained, otherwise 1.
+ */
+extern
+int judge_case( struct sys_arg_t*, int* );
+
+/*
+ * Print the result line of one program and the summary of all cases.
+ * Times are measured in ms, memory in KB, output in bytes.
+ * The second time is the one less the launch overhead, -1 if not calibrated.
+ */
+extern
+void print_result( int, int, int, int, long long, int );
+
+extern
+void print_summary( int, int, int, int );
+
 #endif
@@ -6,6 +6,7 @@
  * richardxx, 2009.2, reorganize the code to better serve our requirements
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -18,8 +19,24 @@
 #include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/personality.h>
+#include "consts.h"
 #include "libprocs.h"
 
+#define RELAY_BUF_SIZE		65536
+#define PUMP_BUF_SIZE		65536
+
+// A run is noisy with more involuntary switches than NOISE_IVCSW + 1 per NOISE_IVCSW_MS,
+// or if the CPU frequency moved by more than NOISE_FREQ percent
+#define NOISE_IVCSW			5
+#define NOISE_IVCSW_MS		10
+#define NOISE_FREQ			5
+
 # ifndef HZ
 #  include <sys/param.h>
 # endif
@@ -63,7 +80,8 @@ const char* pres_text[] = { "Normal",
                             "Memory Limit Excedd",
                             "System Error",
                             "Validation Error",
-                            "Not Checked" };
+                            "Not Checked",
+                            "Output Limit Exceed" };
 
 
 /* Return the number of kilobytes corresponding to a number of pages PAGES.
@@ -103,15 +121,206 @@ static int timeval_time_used( struct timeval* tv1, struct timeval* tv2 )
              ( tv2->tv_usec - tv1->tv_usec ) ) / 1000; 
 }
 
+/*
+ * First CPU of the physical core cpu belongs to.
+ */
+static int core_of( int cpu )
+{
+    char path[128];
+    FILE* fp;
+    int first;
+
+    sprintf( path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu );
+    if ( ( fp = fopen( path, "re" ) ) == NULL ) return cpu;
+    if ( fscanf( fp, "%d", &first ) != 1 ) first = cpu;
+    fclose( fp );
+
+    return first;
+}
+
+int isolate_setup( struct RESCONS* rc )
+{
+    cpu_set_t all, rest;
+    int i, core, n = 0;
+
+    rc -> cpu = -1;
+    if ( sched_getaffinity( 0, sizeof( all ), &all ) == -1 ) return 0;
+
+    // The last core, the first ones usually serve the interrupts
+    for ( i = CPU_SETSIZE - 1; i >= 0 && !CPU_ISSET( i, &all ); --i );
+    if ( i < 0 ) return 0;
+    rc -> cpu = i;
+    core = core_of( i );
+
+    CPU_ZERO( &rest );
+    for ( i = 0; i < CPU_SETSIZE; ++i )
+        if ( CPU_ISSET( i, &all ) && core_of( i ) != core ) {
+            CPU_SET( i, &rest );
+            ++n;
+        }
+
+    return n > 0 && sched_setaffinity( 0, sizeof( rest ), &rest ) == 0;
+}
+
+/*
+ * Called in the child before exec.
+ * A lower nice value needs privilege, without it the program runs as usual.
+ */
+static void isolate_child( struct RESCONS* rc )
+{
+    cpu_set_t set;
+
+    if ( rc -> cpu >= 0 ) {
+        CPU_ZERO( &set );
+        CPU_SET( rc -> cpu, &set );
+        sched_setaffinity( 0, sizeof( set ), &set );
+    }
+
+    personality( personality( 0xffffffff ) | ADDR_NO_RANDOMIZE );
+    if ( rc -> priority > 0 ) setpriority( PRIO_PROCESS, 0, -rc -> priority );
+}
+
+const char* interpreter_of( const char* program )
+{
+    int len = strlen( program );
+
+    return ( len > 3 && strcmp( program + len - 3, ".py" ) == 0 ? "python3" : NULL );
+}
+
+/*
+ * Called in the child to replace it by the program with arguments Arg2 (NULL for none).
+ * Return only if the exec failed.
+ */
+static void exec_program( const char* program, char** argv )
+{
+    char* iargv[ ARGUMENTS_NUM + 2 ];
+    const char* interp = interpreter_of( program );
+    int i;
+
+    if ( interp != NULL ) {
+        iargv[0] = (char*)interp;
+        iargv[1] = (char*)program;
+        for ( i = 1; argv != NULL && argv[i] != NULL && i < ARGUMENTS_NUM; ++i )
+            iargv[ i + 1 ] = argv[i];
+        iargv[ i + 1 ] = NULL;
+        execvp( interp, iargv );
+        return;
+    }
+
+    if ( argv != NULL ) execvp( program, argv );
+    else execlp( program, program, (char*)NULL );
+}
+
+/*
+ * What the machine looks like around a run.
+ */
+struct noise_t
+{
+    int running;        // runnable tasks, the tester included
+    long freq;          // kHz of the isolated CPU, -1 if unknown
+};
+
+static void noise_sample( struct RESCONS* rc, struct noise_t* pn )
+{
+    char path[128];
+    FILE* fp;
+
+    pn -> running = 0;
+    if ( ( fp = fopen( "/proc/loadavg", "re" ) ) != NULL ) {
+        if ( fscanf( fp, "%*f %*f %*f %d", &pn -> running ) != 1 ) pn -> running = 0;
+        fclose( fp );
+    }
+
+    pn -> freq = -1;
+    sprintf( path, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",
+             rc -> cpu >= 0 ? rc -> cpu : 0 );
+    if ( ( fp = fopen( path, "re" ) ) != NULL ) {
+        if ( fscanf( fp, "%ld", &pn -> freq ) != 1 ) pn -> freq = -1;
+        fclose( fp );
+    }
+}
+
+/*
+ * Other tasks competing for the CPUs all along, a frequency change, or a
+ * program preempted more than it takes to supervise it.
+ * Sharing the CPU with the tester, the program is preempted by every
+ * wake-up of the supervisor, so switches tell nothing then.
+ */
+static int is_noisy( struct RESCONS* rc, struct noise_t* before,
+                     struct noise_t* after, struct RESUSE* resp )
+{
+    long ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+    long diff;
+    cpu_set_t own;
+
+    if ( before -> running > ncpu && after -> running > ncpu ) return 1;
+
+    if ( before -> freq > 0 && after -> freq > 0 ) {
+        diff = after -> freq - before -> freq;
+        if ( diff < 0 ) diff = -diff;
+        if ( diff * 100 > before -> freq * NOISE_FREQ ) return 1;
+    }
+
+    if ( rc -> cpu < 0 || sched_getaffinity( 0, sizeof( own ), &own ) == -1 ||
+         CPU_ISSET( rc -> cpu, &own ) ) return 0;
+
+    return resp -> ru.ru_nivcsw > NOISE_IVCSW + time_used( resp ) / NOISE_IVCSW_MS;
+}
+
+/*
+ * Wall clock budget of a program, the launch overhead is allowed for
+ * if limits apply to corrected times.
+ */
+static int wall_limit( struct RESCONS* rc )
+{
+    return rc -> time_limit + ( rc -> corrected ? rc -> wall_overhead / 1000 : 0 );
+}
+
+static int over_time_limit( struct RESUSE* resp, struct RESCONS* rc )
+{
+    return ( rc -> corrected ? time_corrected( resp, rc ) :
+             time_used( resp ) ) >= rc -> time_limit;
+}
+
+/*
+ * Feed the sink with what the child has written to the pipe.
+ * Wait at most Arg5 ms for data, then read once, or until the pipe is empty if Arg6;
+ * a running child is pumped a read at a time, so its limits are checked between reads.
+ * Return 0 when the pipe reaches EOF.
+ */
+static int
+pump_output( int fd, FP_OUT_SINK sink, void* ctx,
+             long long* pbytes, int timeout, int drain )
+{
+    char buf[ PUMP_BUF_SIZE ];
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if ( poll( &pfd, 1, timeout ) <= 0 ) return 1;
+
+    while ( ( ret = read( fd, buf, PUMP_BUF_SIZE ) ) > 0 ) {
+        sink( ctx, buf, ret );
+        *pbytes += ret;
+        if ( !drain ) return 1;
+    }
+
+    return !( ret == 0 || ( ret == -1 && errno != EAGAIN && errno != EINTR ) );
+}
+
 /* Wait for and fill in data on child process PID.
  * Additonally features:
- * Sleep every 20 microseconds
+ * Sleep every 20 microseconds, or pump the output pipe if there is one
  * Return if the program is terminated within the system resource limit
  */
 static int
-resuse_end ( pid_t pid, struct RESUSE *resp, struct RESCONS *res_cons_p, int *prog_ret )
+resuse_end ( pid_t pid, struct RESUSE *resp, struct RESCONS *res_cons_p, int *prog_ret,
+             int fd_pipe, FP_OUT_SINK sink, void* ctx )
 {
     int ret, status;
+    long long bytes = 0;
     struct rusage* pus;
     struct timeval tv1, tv2;
     
@@ -126,20 +335,43 @@ resuse_end ( pid_t pid, struct RESUSE *resp, struct RESCONS *res_cons_p, int *pr
 
         if ( resp != NULL && res_cons_p != NULL ) {
             gettimeofday( &tv2, NULL );
-            if ( timeval_time_used( &tv1, &tv2 ) >= res_cons_p -> time_limit ) {
+            if ( timeval_time_used( &tv1, &tv2 ) >= wall_limit( res_cons_p ) ) {
                 kill( pid, SIGKILL );
 
-                /* The information get is not accurate */
-                getrusage( RUSAGE_CHILDREN, pus );
+                // The usage is the killed child's own, its time is the wall time spent
+                wait4( pid, &status, 0, pus );
                 pus -> ru_utime.tv_sec = tv2.tv_sec - tv1.tv_sec;
                 pus -> ru_utime.tv_usec = tv2.tv_usec - tv1.tv_usec;
+                if ( pus -> ru_utime.tv_usec < 0 ) {
+                    pus -> ru_utime.tv_usec += 1000000;
+                    --pus -> ru_utime.tv_sec;
+                }
+                resp -> out_bytes = bytes;
                 
                 return RES_TLE;
             }
         }
         
-        usleep( 20 );
+        if ( fd_pipe == -1 ) {
+            usleep( 20 );
+            continue;
+        }
+
+        if ( !pump_output( fd_pipe, sink, ctx, &bytes, 1, 0 ) ) fd_pipe = -1;
+        
+        // A pipe has no file size limit, count it ourselves
+        if ( res_cons_p != NULL && res_cons_p -> out_limit > 0 &&
+             bytes > ( (long long)res_cons_p -> out_limit << 10 ) ) {
+            kill( pid, SIGKILL );
+            wait4( pid, &status, 0, pus );
+            if ( resp != NULL ) resp -> out_bytes = bytes;
+            return RES_OLE;
+        }
     }
+
+    // Whatever is left in the pipe
+    if ( fd_pipe != -1 ) pump_output( fd_pipe, sink, ctx, &bytes, 0, 1 );
+    if ( resp != NULL && sink != NULL ) resp -> out_bytes = bytes;
     
     /*
      * Check how was the program terminiated.
@@ -150,8 +382,10 @@ resuse_end ( pid_t pid, struct RESUSE *resp, struct RESCONS *res_cons_p, int *pr
     
     if ( ret == RES_NORMAL ) {
         if ( resp != NULL && res_cons_p != NULL ) {
-            if ( time_used( resp ) >= res_cons_p -> time_limit ) return RES_TLE;
+            if ( over_time_limit( resp, res_cons_p ) ) return RES_TLE;
             if ( mem_used( resp ) >= res_cons_p -> mem_limit ) return RES_MLE;
+            if ( res_cons_p -> out_limit > 0 &&
+                 bytes > ( (long long)res_cons_p -> out_limit << 10 ) ) return RES_OLE;
         }
     }
     
@@ -180,12 +414,32 @@ resuse_bare_measure_end( struct RESUSE* resp )
     return res;
 }
 
+static void timeval_add( struct timeval* t1, struct timeval* t2 )
+{
+    t1 -> tv_sec += t2 -> tv_sec;
+    t1 -> tv_usec += t2 -> tv_usec;
+    if ( t1 -> tv_usec >= 1000000 ) {
+        t1 -> tv_sec += t1 -> tv_usec / 1000000;
+        t1 -> tv_usec %= 1000000;
+    }
+}
+
+/*
+ * Counters are added up, the peak RSS is the larger one.
+ */
 inline
 void resuse_add( struct RESUSE* r1, struct RESUSE* r2 )
 {
-    r1 -> ru.TV_SEC += r2 -> ru.TV_SEC;
-    r1 -> ru.TV_USEC += r2 -> ru.TV_USEC;
+    timeval_add( &r1 -> ru.ru_utime, &r2 -> ru.ru_utime );
+    timeval_add( &r1 -> ru.ru_stime, &r2 -> ru.ru_stime );
+    if ( r2 -> ru.ru_maxrss > r1 -> ru.ru_maxrss ) r1 -> ru.ru_maxrss = r2 -> ru.ru_maxrss;
     r1 -> ru.ru_minflt += r2 -> ru.ru_minflt;
+    r1 -> ru.ru_majflt += r2 -> ru.ru_majflt;
+    r1 -> ru.ru_nvcsw += r2 -> ru.ru_nvcsw;
+    r1 -> ru.ru_nivcsw += r2 -> ru.ru_nivcsw;
+    r1 -> ru.ru_inblock += r2 -> ru.ru_inblock;
+    r1 -> ru.ru_oublock += r2 -> ru.ru_oublock;
+    r1 -> out_bytes += r2 -> out_bytes;
 }
 
 inline
@@ -194,33 +448,62 @@ int time_used( struct RESUSE *resp )
     return resp -> ru.TV_MSEC1 + resp -> ru.TV_MSEC2;
 }
 
+inline
+long long time_used_us( struct RESUSE *resp )
+{
+    return resp -> ru.TV_SEC * 1000000LL + resp -> ru.TV_USEC;
+}
+
+int time_corrected( struct RESUSE* resp, struct RESCONS* rc )
+{
+    long long t = time_used_us( resp ) - rc -> cpu_overhead;
+
+    return t > 0 ? t / 1000 : 0;
+}
+
 inline
 int mem_used( struct RESUSE* resp )
 {
     return ptok( resp -> ru.ru_minflt );
 }
 
+inline
+long long out_used( struct RESUSE* resp )
+{
+    return resp -> out_bytes;
+}
+
 /*
  * Run program under supervision.
+ * With a sink, the standard output goes through a pipe instead of a file.
  */
-int
-run_program( const char* program,
-             const char* finput,
-             const char* foutput,
-             const char* ferror,
-             struct RESCONS* res_cons_p,
-             struct RESUSE* resp,
-             int *prog_ret, char** argv )
+static int
+run_once( const char* program,
+                const char* finput,
+                const char* foutput,
+                const char* ferror,
+                struct RESCONS* res_cons_p,
+                struct RESUSE* resp,
+                int *prog_ret, char** argv,
+                FP_OUT_SINK sink, void* ctx )
 {
     int ret, status = -1;
     int pid_child;
     int fd_in = -1, fd_out = - 1, fd_err = -1;
+    int fd_pipe[2] = { -1, -1 };
+    struct rlimit rl;
+    struct stat st;
     
     // Open file descriptor
-    fd_in = ( finput == NULL ? 0 : open( finput, O_RDONLY ) );
-    fd_out = ( foutput == NULL ? 1 :
-               open( foutput, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR ) );
-    fd_err = ( ferror == NULL ? 2 : open( ferror, O_WRONLY ) );
+    fd_in = ( finput == NULL ? 0 : open( finput, O_RDONLY | O_CLOEXEC ) );
+    if ( sink != NULL ) {
+        if ( pipe2( fd_pipe, O_CLOEXEC ) == 0 ) fd_out = fd_pipe[1];
+    }
+    else {
+        fd_out = ( foutput == NULL ? 1 :
+                   open( foutput, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR ) );
+    }
+    fd_err = ( ferror == NULL ? 2 : open( ferror, O_WRONLY | O_CLOEXEC ) );
 
     // Start child process
     if ( fd_in != -1 && fd_out != -1 && fd_err != -1 ) {
@@ -236,20 +519,42 @@ run_program( const char* program,
             dup2( fd_in, 0 );
             dup2( fd_out, 1 );
             dup2( fd_err, 2 );
+            if ( fd_pipe[0] != -1 ) close( fd_pipe[0] );
 
-            // Return from child process by exit system call
-            if ( argv != NULL ) {
-                if ( execvp( program, argv ) == -1 ) exit( -1 );
-            }
-            else {
-                if ( execlp( program, program, (char*)NULL ) == -1 ) exit(-1);
+            // Files can't grow a byte beyond the output limit, SIGXFSZ otherwise
+            if ( res_cons_p != NULL && res_cons_p -> out_limit > 0 ) {
+                rl.rlim_cur = rl.rlim_max = ( (rlim_t)res_cons_p -> out_limit << 10 ) + 1;
+                setrlimit( RLIMIT_FSIZE, &rl );
             }
+
+            if ( res_cons_p != NULL && res_cons_p -> isolate ) isolate_child( res_cons_p );
+
+            // Return from child process by _exit, exit would flush the parent's buffers into the output
+            exec_program( program, argv );
+            _exit( -1 );
         }
         else if ( pid_child > 0 ) {
             /* Parent:
              * Supervise resource usage
              */
-            status = resuse_end( pid_child, resp, res_cons_p, prog_ret );
+            if ( fd_pipe[0] != -1 ) {
+                close( fd_pipe[1] );
+                fd_pipe[1] = fd_out = -1;
+                fcntl( fd_pipe[0], F_SETFL, O_NONBLOCK );
+            }
+            
+            status = resuse_end( pid_child, resp, res_cons_p, prog_ret,
+                                 fd_pipe[0], sink, ctx );
+
+            // Account the output, going past the limit means it was cut
+            if ( sink == NULL && foutput != NULL && fstat( fd_out, &st ) == 0 ) {
+                if ( resp != NULL ) resp -> out_bytes = st.st_size;
+                
+                if ( status != RES_TLE && res_cons_p != NULL &&
+                     res_cons_p -> out_limit > 0 &&
+                     st.st_size > ( (long long)res_cons_p -> out_limit << 10 ) )
+                    status = RES_OLE;
+            }
         }
         else {
             // fork Error
@@ -258,9 +563,420 @@ run_program( const char* program,
         }
     }
     
-    if ( fd_in > 0 ) close( fd_in );
-    if ( fd_out > 0 ) close( fd_out );
-    if ( fd_err > 0 ) close( fd_err );
+    // Only close what was opened here, never our own standard descriptors
+    if ( finput != NULL && fd_in != -1 ) close( fd_in );
+    if ( sink == NULL && foutput != NULL && fd_out != -1 ) close( fd_out );
+    if ( ferror != NULL && fd_err != -1 ) close( fd_err );
+    if ( fd_pipe[1] != -1 ) close( fd_pipe[1] );
+    if ( fd_pipe[0] != -1 ) close( fd_pipe[0] );
     
     return status;
 }
+
+/*
+ * An isolated run is watched for noise and run again while noisy.
+ * Output streamed to a sink can't be taken back, such a run is only flagged.
+ */
+static int
+run_supervised( const char* program,
+                const char* finput,
+                const char* foutput,
+                const char* ferror,
+                struct RESCONS* res_cons_p,
+                struct RESUSE* resp,
+                int *prog_ret, char** argv,
+                FP_OUT_SINK sink, void* ctx )
+{
+    struct noise_t before, after;
+    int status, n;
+
+    if ( res_cons_p == NULL || !res_cons_p -> isolate || resp == NULL )
+        return run_once( program, finput, foutput, ferror, res_cons_p,
+                         resp, prog_ret, argv, sink, ctx );
+
+    for ( n = 0; ; ++n ) {
+        noise_sample( res_cons_p, &before );
+        status = run_once( program, finput, foutput, ferror, res_cons_p,
+                           resp, prog_ret, argv, sink, ctx );
+        noise_sample( res_cons_p, &after );
+
+        resp -> noisy = is_noisy( res_cons_p, &before, &after, resp );
+        resp -> reruns = n;
+        if ( !resp -> noisy || sink != NULL || n >= res_cons_p -> reruns ) break;
+    }
+
+    return status;
+}
+
+int
+run_program( const char* program,
+             const char* finput,
+             const char* foutput,
+             const char* ferror,
+             struct RESCONS* res_cons_p,
+             struct RESUSE* resp,
+             int *prog_ret, char** argv )
+{
+    return run_supervised( program, finput, foutput, ferror,
+                           res_cons_p, resp, prog_ret, argv, NULL, NULL );
+}
+
+int
+run_program_sink( const char* program,
+                  const char* finput,
+                  const char* ferror,
+                  struct RESCONS* res_cons_p,
+                  struct RESUSE* resp,
+                  int *prog_ret, char** argv,
+                  FP_OUT_SINK sink, void* ctx )
+{
+    return run_supervised( program, finput, NULL, ferror,
+                           res_cons_p, resp, prog_ret, argv, sink, ctx );
+}
+
+/*
+ * Fork a child with its standard descriptors replaced.
+ * Descriptors listed in Arg6 are closed in the child, so pipes see EOF properly.
+ * The child is isolated if Arg8 asks for it.
+ */
+static pid_t
+spawn_child( const char* program, char** argv,
+             int fd_in, int fd_out, int fd_err,
+             int* fds, int nfds, struct RESCONS* rc )
+{
+    pid_t pid;
+    int i;
+
+    pid = fork();
+    if ( pid != 0 ) return pid;
+
+    dup2( fd_in, 0 );
+    dup2( fd_out, 1 );
+    if ( fd_err != -1 ) dup2( fd_err, 2 );
+
+    for ( i = 0; i < nfds; ++i )
+        if ( fds[i] > 2 ) close( fds[i] );
+
+    if ( rc != NULL && rc -> isolate ) isolate_child( rc );
+
+    exec_program( program, argv );
+    _exit( -1 );
+}
+
+/*
+ * One direction of a recorded conversation.
+ */
+struct relay_t
+{
+    int from, to;
+    int beg, end;
+    const char* tag;
+    char buf[ RELAY_BUF_SIZE ];
+};
+
+static void relay_close( struct relay_t* pr )
+{
+    if ( pr -> from != -1 ) close( pr -> from );
+    if ( pr -> to != -1 ) close( pr -> to );
+    pr -> from = pr -> to = -1;
+}
+
+/*
+ * Move whatever is ready, waiting at most Arg4 ms.
+ * Data is written to the transcript as it is read, tagged by direction.
+ * Return how many descriptors were ready.
+ */
+static int
+relay_step( struct relay_t* relays, int n, int fd_log, int timeout,
+            const struct relay_t** plast )
+{
+    struct pollfd pfd[2];
+    struct relay_t* pr;
+    int i, ret, ready;
+
+    for ( i = 0; i < n; ++i ) {
+        pr = relays + i;
+        pfd[i].fd = -1;
+        pfd[i].events = 0;
+        pfd[i].revents = 0;
+        
+        if ( pr -> beg < pr -> end && pr -> to != -1 ) {
+            pfd[i].fd = pr -> to;
+            pfd[i].events = POLLOUT;
+        }
+        else if ( pr -> from != -1 ) {
+            pr -> beg = pr -> end = 0;
+            pfd[i].fd = pr -> from;
+            pfd[i].events = POLLIN;
+        }
+    }
+
+    if ( ( ready = poll( pfd, n, timeout ) ) <= 0 ) return 0;
+
+    for ( i = 0; i < n; ++i ) {
+        pr = relays + i;
+        if ( pfd[i].revents == 0 ) continue;
+
+        if ( pfd[i].events == POLLIN ) {
+            ret = read( pr -> from, pr -> buf, RELAY_BUF_SIZE );
+            if ( ret <= 0 ) {
+                // Writer is gone, pass the EOF on
+                relay_close( pr );
+                continue;
+            }
+
+            if ( *plast != pr ) {
+                write( fd_log, pr -> tag, strlen( pr -> tag ) );
+                *plast = pr;
+            }
+            write( fd_log, pr -> buf, ret );
+            pr -> beg = 0;
+            pr -> end = ret;
+        }
+        else {
+            ret = write( pr -> to, pr -> buf + pr -> beg, pr -> end - pr -> beg );
+            if ( ret <= 0 ) {
+                if ( ret == -1 && errno == EAGAIN ) continue;
+                // Reader is gone, the rest is only recorded
+                close( pr -> to );
+                pr -> to = -1;
+                continue;
+            }
+            pr -> beg += ret;
+        }
+    }
+
+    return ready;
+}
+
+/*
+ * Run a program against an interactor through crossed pipes.
+ */
+int
+run_interactive( const char* program, char** argv,
+                 const char* interactor, char** iargv,
+                 struct RESCONS* res_cons_p, struct RESUSE* resp,
+                 int* inter_ret, const char* ftranscript )
+{
+    int p_u2i[2] = { -1, -1 }, p_i2u[2] = { -1, -1 };
+    int p_rel1[2] = { -1, -1 }, p_rel2[2] = { -1, -1 };
+    int fds[8], fd_null, fd_log = -1;
+    int i, ret, ustatus = 0, istatus = 0;
+    int user_done, inter_done;
+    pid_t pid_user, pid_inter;
+    sigset_t pipe_set, old_mask;
+    int masked = 0;
+    struct relay_t* relays = NULL;
+    const struct relay_t* last = NULL;
+    struct rusage* pus;
+    struct timeval tv1, tv2, tv_user;
+    struct noise_t before, after;
+    struct timespec no_wait = { 0, 0 };
+    int watched;
+
+    pus = ( resp == NULL ? NULL : &(resp -> ru) );
+    if ( inter_ret != NULL ) *inter_ret = -1;
+
+    // A conversation can't be run again, a noisy one is only flagged
+    watched = ( resp != NULL && res_cons_p != NULL && res_cons_p -> isolate );
+    if ( watched ) noise_sample( res_cons_p, &before );
+
+    if ( ( fd_null = open( "/dev/null", O_WRONLY | O_CLOEXEC ) ) == -1 ) return RES_SE;
+    
+    if ( pipe2( p_u2i, O_CLOEXEC ) == -1 || pipe2( p_i2u, O_CLOEXEC ) == -1 ) {
+        ret = RES_SE;
+        goto release_code;
+    }
+
+    if ( ftranscript != NULL ) {
+        /*
+         * Record mode, we sit in between:
+         * program -> p_u2i -> tester -> p_rel1 -> interactor
+         * interactor -> p_i2u -> tester -> p_rel2 -> program
+         */
+        relays = ( struct relay_t* )malloc( 2 * sizeof( struct relay_t ) );
+        fd_log = open( ftranscript, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                       S_IRUSR | S_IWUSR );
+        if ( relays == NULL || fd_log == -1 ||
+             pipe2( p_rel1, O_CLOEXEC ) == -1 || pipe2( p_rel2, O_CLOEXEC ) == -1 ) {
+            ret = RES_SE;
+            goto release_code;
+        }
+        
+        for ( i = 0; i < 2; ++i ) {
+            relays[i].from = relays[i].to = -1;
+            relays[i].beg = relays[i].end = 0;
+        }
+    }
+
+    fds[0] = p_u2i[0]; fds[1] = p_u2i[1];
+    fds[2] = p_i2u[0]; fds[3] = p_i2u[1];
+    fds[4] = p_rel1[0]; fds[5] = p_rel1[1];
+    fds[6] = p_rel2[0]; fds[7] = p_rel2[1];
+
+    pid_inter = spawn_child( interactor, iargv,
+                             relays == NULL ? p_u2i[0] : p_rel1[0],
+                             p_i2u[1], fd_null, fds, 8, NULL );
+    if ( pid_inter == -1 ) {
+        fprintf( stderr, "The system call fork failed.\n" );
+        ret = RES_SE;
+        goto release_code;
+    }
+
+    pid_user = spawn_child( program, argv,
+                            relays == NULL ? p_i2u[0] : p_rel2[0],
+                            p_u2i[1], -1, fds, 8, res_cons_p );
+    if ( resp != NULL ) resuse_start( resp );
+    if ( pid_user == -1 ) {
+        fprintf( stderr, "The system call fork failed.\n" );
+        kill( pid_inter, SIGKILL );
+        waitpid( pid_inter, NULL, 0 );
+        ret = RES_SE;
+        goto release_code;
+    }
+
+    // Keep only the ends we relay
+    if ( relays != NULL ) {
+        relays[0].from = p_u2i[0]; relays[0].to = p_rel1[1];
+        relays[0].tag = "\n>>> program\n";
+        relays[1].from = p_i2u[0]; relays[1].to = p_rel2[1];
+        relays[1].tag = "\n<<< interactor\n";
+        for ( i = 0; i < 2; ++i )
+            fcntl( relays[i].to, F_SETFL, O_NONBLOCK );
+        p_u2i[0] = p_i2u[0] = p_rel1[1] = p_rel2[1] = -1;
+
+        /*
+         * A peer may quit early, we want EPIPE rather than dying.
+         * Only this thread is kept from SIGPIPE, the disposition of the process is left alone.
+         */
+        sigemptyset( &pipe_set );
+        sigaddset( &pipe_set, SIGPIPE );
+        masked = ( pthread_sigmask( SIG_BLOCK, &pipe_set, &old_mask ) == 0 &&
+                   !sigismember( &old_mask, SIGPIPE ) );
+    }
+    
+    for ( i = 0; i < 2; ++i ) {
+        if ( p_u2i[i] != -1 ) close( p_u2i[i] );
+        if ( p_i2u[i] != -1 ) close( p_i2u[i] );
+        if ( p_rel1[i] != -1 ) close( p_rel1[i] );
+        if ( p_rel2[i] != -1 ) close( p_rel2[i] );
+        p_u2i[i] = p_i2u[i] = p_rel1[i] = p_rel2[i] = -1;
+    }
+
+    /*
+     * Only the program is charged.
+     * The interactor has the same budget again once the program has finished.
+     */
+    ret = RES_NORMAL;
+    user_done = inter_done = 0;
+    gettimeofday( &tv1, NULL );
+    tv_user = tv1;
+    
+    while ( !user_done || !inter_done ) {
+        if ( relays != NULL ) relay_step( relays, 2, fd_log, 1, &last );
+        else usleep( 20 );
+
+        if ( !user_done &&
+             wait4( pid_user, &ustatus, WNOHANG, pus ) == pid_user ) {
+            user_done = 1;
+            gettimeofday( &tv_user, NULL );
+        }
+
+        if ( !inter_done &&
+             wait4( pid_inter, &istatus, WNOHANG, NULL ) == pid_inter )
+            inter_done = 1;
+
+        if ( res_cons_p == NULL ) continue;
+        gettimeofday( &tv2, NULL );
+
+        if ( !user_done &&
+             timeval_time_used( &tv1, &tv2 ) >= wall_limit( res_cons_p ) ) {
+            kill( pid_user, SIGKILL );
+            wait4( pid_user, &ustatus, 0, pus );
+            if ( pus != NULL ) {
+                pus -> ru_utime.tv_sec = tv2.tv_sec - tv1.tv_sec;
+                pus -> ru_utime.tv_usec = tv2.tv_usec - tv1.tv_usec;
+            }
+            user_done = 1;
+            tv_user = tv2;
+            ret = RES_TLE;
+        }
+
+        if ( user_done && !inter_done &&
+             timeval_time_used( &tv_user, &tv2 ) >= res_cons_p -> time_limit ) {
+            kill( pid_inter, SIGKILL );
+            waitpid( pid_inter, &istatus, 0 );
+            inter_done = 1;
+        }
+    }
+
+    // Record what is still in flight, nobody is going to read it
+    if ( relays != NULL ) {
+        for ( i = 0; i < 2; ++i ) {
+            if ( relays[i].to != -1 ) close( relays[i].to );
+            relays[i].to = -1;
+        }
+        while ( relay_step( relays, 2, fd_log, 0, &last ) > 0 );
+    }
+
+    if ( ret == RES_NORMAL ) {
+        ret = WIFEXITED( ustatus ) ? RES_NORMAL : RES_SE;
+        if ( ret == RES_NORMAL && resp != NULL && res_cons_p != NULL ) {
+            if ( over_time_limit( resp, res_cons_p ) ) ret = RES_TLE;
+            else if ( mem_used( resp ) >= res_cons_p -> mem_limit ) ret = RES_MLE;
+        }
+    }
+
+    if ( inter_ret != NULL ) *inter_ret = istatus;
+
+    if ( watched ) {
+        noise_sample( res_cons_p, &after );
+        resp -> noisy = is_noisy( res_cons_p, &before, &after, resp );
+    }
+
+  release_code:
+    for ( i = 0; i < 2; ++i ) {
+        if ( p_u2i[i] != -1 ) close( p_u2i[i] );
+        if ( p_i2u[i] != -1 ) close( p_i2u[i] );
+        if ( p_rel1[i] != -1 ) close( p_rel1[i] );
+        if ( p_rel2[i] != -1 ) close( p_rel2[i] );
+    }
+    if ( relays != NULL ) {
+        relay_close( relays );
+        relay_close( relays + 1 );
+        free( relays );
+    }
+    if ( fd_log != -1 ) close( fd_log );
+    if ( masked ) {
+        // Take the SIGPIPE of a failed write before it can be delivered
+        while ( sigtimedwait( &pipe_set, NULL, &no_wait ) == SIGPIPE );
+        pthread_sigmask( SIG_SETMASK, &old_mask, NULL );
+    }
+    close( fd_null );
+    
+    return ret;
+}
+
+/*
+ * Nothing is measured or constrained, the caller reaps the child.
+ */
+pid_t
+start_program( const char* program, const char* finput,
+               const char* foutput, char** argv )
+{
+    int fd_in, fd_out, fd_null;
+    pid_t pid = -1;
+
+    fd_in = open( finput == NULL ? "/dev/null" : finput, O_RDONLY | O_CLOEXEC );
+    fd_out = open( foutput, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR );
+    fd_null = open( "/dev/null", O_WRONLY | O_CLOEXEC );
+
+    if ( fd_in != -1 && fd_out != -1 && fd_null != -1 )
+        pid = spawn_child( program, argv, fd_in, fd_out, fd_null, NULL, 0, NULL );
+
+    if ( fd_in != -1 ) close( fd_in );
+    if ( fd_out != -1 ) close( fd_out );
+    if ( fd_null != -1 ) close( fd_null );
+    
+    return pid;
+}
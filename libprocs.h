@@ -7,6 +7,7 @@
 #ifndef _LIBPROCS_H
 #define _LIBPROCS_H 1
 
+#include <sys/types.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -15,6 +16,8 @@ struct RESUSE
 {
     struct rusage ru;              /* Real CPU time of process. */
     struct timeval start, end;     /* Wallclock time of process.  */
+    long long out_bytes;           /* Size of the output file. */
+    int noisy, reruns;             /* Isolated runs: still noisy, times run again. */
 };
 
 /* Information on resource limitations owned by a child process. */
@@ -22,6 +25,21 @@ struct RESCONS
 {
     int time_limit;
     int mem_limit;
+    int out_limit;                 /* KB, 0 means unlimited */
+
+    /*
+     * Launch overhead measured by calibration, in us of CPU and wall clock time.
+     * If corrected is set, limits apply to the times less the overhead.
+     */
+    int cpu_overhead, wall_overhead;
+    int corrected;
+
+    /*
+     * Timing isolation, see isolate_setup().
+     * Measured programs run on cpu (-1 for any) with ASLR off and the nice
+     * value lowered by priority; a noisy run is run again up to reruns times.
+     */
+    int isolate, cpu, priority, reruns;
 };
 
 #define TV_SEC  ru_utime.tv_sec
@@ -55,6 +73,10 @@ struct RESCONS
 #define RES_SE			6
 #define RES_VE			7
 #define RES_NOT_CHECK	8
+#define RES_OLE			9
+
+// Number of codes above
+#define RES_CODES		10
 
 // Text description of constants above
 extern const char* pres_text[];
@@ -75,6 +97,70 @@ int run_program( const char*,     // program name
                  char**           // arguments for child process
                  );
 
+/*
+ * Receive the output of a program as it is produced.
+ * Arg1 is the context given to run_program_sink, Arg2 and Arg3 the data.
+ */
+typedef int (*FP_OUT_SINK)( void*, const char*, int );
+
+/*
+ * The same as run_program, but the standard output is streamed to a sink
+ * through a pipe rather than written to a file.
+ */
+int run_program_sink( const char*,     // program name
+                      const char*,     // input file
+                      const char*,     // error output file
+                      struct RESCONS*, // resource usage constraints
+                      struct RESUSE*,  // resource measurement
+                      int*,            // return value of child process
+                      char**,          // arguments for child process
+                      FP_OUT_SINK,     // receiver of the output
+                      void*            // context of the receiver
+                      );
+
+/*
+ * Run a program against an interactor through crossed pipes:
+ * the program's output is the interactor's input and vice versa.
+ * Only the program is measured and constrained, the interactor gets
+ * the same wall clock budget again after the program has finished.
+ * If a transcript file is given, the conversation is relayed and recorded,
+ * otherwise both sides talk directly.
+ * Return:
+ * System code of the program
+ */
+int run_interactive( const char*,     // program name
+                     char**,          // arguments for program
+                     const char*,     // interactor name
+                     char**,          // arguments for interactor
+                     struct RESCONS*, // resource usage constraints
+                     struct RESUSE*,  // resource measurement of program
+                     int*,            // wait status of interactor
+                     const char*      // transcript file, may be NULL
+                     );
+
+/*
+ * Start a program in the background, its output going to a file.
+ * Return the process id, or -1 if failed; the caller waits for it.
+ */
+pid_t start_program( const char*,     // program name
+                     const char*,     // input file, NULL for none
+                     const char*,     // output file
+                     char**           // arguments for child process
+                     );
+
+/*
+ * The interpreter a program is run by, NULL if it runs by itself.
+ * A Python script is run by python3, it needs neither a #! line nor the exec bit.
+ */
+const char* interpreter_of( const char* );
+
+/*
+ * Prepare timing isolation: pick a physical core for measured programs and
+ * keep the tester and its other children off it and its SMT siblings.
+ * Return 0 if no core could be dedicated, the programs are pinned anyway.
+ */
+int isolate_setup( struct RESCONS* );
+
 /* Clear */
 void resuse_start( struct RESUSE* );
 
@@ -87,7 +173,16 @@ void resuse_add( struct RESUSE*, struct RESUSE* );
 /* Get how many microseconds a program occupies. */
 int time_used( struct RESUSE* );
 
+/* The same in microseconds. */
+long long time_used_us( struct RESUSE* );
+
+/* Milliseconds less the launch overhead in Arg2, never negative. */
+int time_corrected( struct RESUSE*, struct RESCONS* );
+
 /* Get the memory peak a program reaches. */
 int mem_used( struct RESUSE* );
 
+/* Get how many bytes a program wrote to its output file. */
+long long out_used( struct RESUSE* );
+
 #endif /* _RESUSE_H */
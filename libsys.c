@@ -7,22 +7,32 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include "consts.h"
+#include "hash.h"
 #include "libsys.h"
 #include "libprocs.h"
 
 #define TRY_TIME				5
-#define SUPPORT_SOURCE_NUM		6
+#define SUPPORT_SOURCE_NUM		8
 #define GCC		1
 #define GPP		2
 #define JAVA	3
 #define PASCAL	4
+#define PYTHON	5
 
-extern int Verbose_mode;
+// C++ sources including this get it precompiled
+#define PCH_HEADER		"bits/stdc++.h"
+
+// Print the details of the work, set by -v of tester
+int Verbose_mode = 0;
 
 static char* suffix[] = { "c", "cc", "cpp",
-                          "C", "cxx", "java", "pas" };
+                          "C", "cxx", "java", "pas", "py" };
 
-static int compiler[] = { GCC, GPP, GPP, GPP, GPP, JAVA, PASCAL };
+static int compiler[] = { GCC, GPP, GPP, GPP, GPP, JAVA, PASCAL, PYTHON };
 
 
 // Remove a suffix separated by "."
@@ -46,6 +56,114 @@ static int get_rid_of_suffix( char* pstr )
 }
 
 
+// Milliseconds since Arg1
+static int ms_since( struct timeval* tv1 )
+{
+    struct timeval tv2;
+
+    gettimeofday( &tv2, NULL );
+    return ( tv2.tv_sec - tv1 -> tv_sec ) * 1000 + ( tv2.tv_usec - tv1 -> tv_usec ) / 1000;
+}
+
+// Whether Arg1 includes the precompiled header
+static int includes_pch( const char* psrc )
+{
+    char line[ 512 ], *p;
+    int len = strlen( PCH_HEADER ), found = 0;
+    FILE* fp;
+
+    if ( ( fp = fopen( psrc, "re" ) ) == NULL ) return 0;
+
+    while ( !found && fgets( line, sizeof( line ), fp ) != NULL ) {
+        for ( p = line; *p == ' ' || *p == '\t'; ++p );
+        if ( *p++ != '#' ) continue;
+        for ( ; *p == ' ' || *p == '\t'; ++p );
+        if ( strncmp( p, "include", 7 ) != 0 ) continue;
+        for ( p += 7; *p == ' ' || *p == '\t'; ++p );
+
+        found = ( ( *p == '<' || *p == '"' ) &&
+                  strncmp( p + 1, PCH_HEADER, len ) == 0 &&
+                  ( p[ len + 1 ] == '>' || p[ len + 1 ] == '"' ) );
+    }
+
+    fclose( fp );
+    return found;
+}
+
+/*
+ * Find the precompiled header of g++ in the cache, or build it.
+ * Arg1 receives the folder to put first on the include path.
+ * There is one folder per compiler version, compiles pass no other flags;
+ * g++ ignores a header made with other flags anyway and reads the real one.
+ * Return 0 if there's none.
+ */
+static int get_pch( char* dir )
+{
+    char ver[ 256 ], gch[ FILE_NAME_LEN + 1 ], tmp[ FILE_NAME_LEN + 1 ];
+    char src[ FILE_NAME_LEN + 1 ], hex[ HASH_HEX_LEN + 1 ], *argv[7];
+    unsigned char digest[ HASH_LEN ];
+    struct hash_ctx_t ctx;
+    struct timeval tv;
+    FILE* fp;
+    int len, ret, ok;
+
+    if ( ( fp = popen( "g++ -dumpfullversion -dumpmachine 2>/dev/null", "r" ) ) == NULL ) return 0;
+    len = fread( ver, 1, sizeof( ver ), fp );
+    if ( pclose( fp ) != 0 || len <= 0 ) return 0;
+
+    hash_init( &ctx );
+    hash_update( &ctx, "g++\n", 4 );
+    hash_update( &ctx, ver, len );
+    hash_final( &ctx, digest );
+    hash_to_hex( digest, hex );
+
+    sprintf( dir, "%s/%.16s", PCH_CACHE_DIR, hex );
+    sprintf( gch, "%s/%s.gch", dir, PCH_HEADER );
+    if ( access( gch, R_OK ) == 0 ) return 1;
+
+    // Whichever folder fails, the build does too
+    mkdir( WORKER_CACHE_DIR, S_IRWXU );
+    mkdir( PCH_CACHE_DIR, S_IRWXU );
+    mkdir( dir, S_IRWXU );
+    sprintf( tmp, "%s/bits", dir );
+    mkdir( tmp, S_IRWXU );
+
+    // Built aside and renamed, another tester may be building it as well
+    sprintf( src, "%s/pch%d.h", dir, (int)getpid() );
+    sprintf( tmp, "%s.%d", gch, (int)getpid() );
+    if ( ( fp = fopen( src, "we" ) ) == NULL ) return 0;
+    fprintf( fp, "#include <%s>\n", PCH_HEADER );
+    fclose( fp );
+
+    argv[0] = "g++";
+    argv[1] = "-x";
+    argv[2] = "c++-header";
+    argv[3] = src;
+    argv[4] = "-o";
+    argv[5] = tmp;
+    argv[6] = NULL;
+
+    if ( Verbose_mode ) {
+        printf( "Precompile %s .......", PCH_HEADER );
+        fflush( stdout );
+    }
+
+    gettimeofday( &tv, NULL );
+    ok = ( run_program( argv[0], NULL, "/dev/null", "/dev/null",
+                        NULL, NULL, &ret, argv ) == RES_NORMAL &&
+           ret == 0 && rename( tmp, gch ) == 0 );
+
+    if ( Verbose_mode ) {
+        if ( ok ) printf( " OK, %dms\n", ms_since( &tv ) );
+        else printf( " Failed\n" );
+        fflush( stdout );
+    }
+
+    unlink( src );
+    if ( !ok ) unlink( tmp );
+    return ok;
+}
+
 // Batch request memory
 int malloc_all_var( int size, ... )
 {
@@ -154,8 +272,9 @@ void free2d( char** p, int sz1 )
  */
 int compile( char* psrc )
 {
-    char *pbin = NULL, *argv[5];
-    int i;
+    char *pbin = NULL, *argv[7], pch_dir[ FILE_NAME_LEN + 1 ];
+    struct timeval tv;
+    int i, pch = 0;
     int ret, tp_inx;
     
     // Request resource
@@ -183,6 +302,13 @@ int compile( char* psrc )
             argv[2] = "-o";
             argv[3] = pbin;
             argv[4] = NULL;
+
+            // The cached header is found ahead of the real one
+            if ( includes_pch( psrc ) && ( pch = get_pch( pch_dir ) ) ) {
+                argv[4] = "-I";
+                argv[5] = pch_dir;
+                argv[6] = NULL;
+            }
             break;
 
         case JAVA:
@@ -196,6 +322,15 @@ int compile( char* psrc )
             argv[1] = psrc;
             argv[2] = NULL;
             break;
+
+        case PYTHON:
+            // Only checked, the script is run as it is
+            argv[0] = "python3";
+            argv[1] = "-c";
+            argv[2] = "import sys; compile(open(sys.argv[1]).read(), sys.argv[1], 'exec')";
+            argv[3] = psrc;
+            argv[4] = NULL;
+            break;
     }
 
     printf( "Compile source files:\n" );
@@ -206,6 +341,7 @@ int compile( char* psrc )
     }
 
     // Try compiling program
+    gettimeofday( &tv, NULL );
     for ( i = 0; i < TRY_TIME; ++i ) {
         if ( run_program( argv[0],
                           NULL, "/dev/null", "/dev/null",
@@ -222,9 +358,13 @@ int compile( char* psrc )
         }
     }
     
-    if ( i < TRY_TIME ) strcpy( psrc, pbin );
+    if ( i < TRY_TIME && compiler[tp_inx] != PYTHON ) strcpy( psrc, pbin );
     if ( Verbose_mode ) {
-        printf( i < TRY_TIME ? " OK\n" : " Failed\n" );
+        if ( i < TRY_TIME )
+            printf( " OK, %dms%s\n", ms_since( &tv ),
+                    pch ? " with the precompiled header" : "" );
+        else
+            printf( " Failed\n" );
         fflush( stdout );
     }
     
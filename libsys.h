@@ -33,6 +33,7 @@ void free2d( char**, int );
  * Call relative compiler to compile program.
  * The compiler is chose by suffix matching.
  * Generate a binary file with the suffix removed.
+ * A Python script is only checked for syntax, and keeps its name.
  * Return 0 if compiling fails, otherwise return 1.
  */
 extern int compile( char* );
@@ -9,76 +9,32 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <time.h>
 #include <signal.h>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <getopt.h>
 #include <unistd.h>
 
 #include "consts.h"
-#include "type_def.h"
-#include "judge.h"
-#include "file.h"
 #include "libsys.h"
-#include "runtime.h"
-
-#define DEFAULT_RUNS		10
-#define DEFAULT_WAIT_TIME	10000
-#define DEFAULT_MEMORY_SIZE  ( ~(1 << (sizeof(int) * 8 - 1) ) >> 10 )
-
-
-#define SET_PROG_ARG( PROG_NAME, ARG ) \
-do { \
-    if ( optarg[0] == '/' ) \
-         strcpy( sysinfo.PROG_NAME, optarg ); \
-    else { \
-         strcpy( sysinfo.PROG_NAME, "./" ); \
-         strcpy( sysinfo.PROG_NAME + 2, optarg ); \
-    } \
-} while (0) \
-
-
-#define LOAD_DIRECTORY( PROG_NAME, ARG ) \
-do { \
-    sysinfo.PROG_NAME = open_folder( optarg ); \
-    if ( sysinfo.PROG_NAME == NULL ) { \
-		fprintf( stderr, "Load folder \"%s\" failed\n", optarg ); \
-        return 0; \
-    } \
-} while (0) \
-
-#define COMPILE_SOURCE_CODE( SOURCE_NAME ) \
-do { \
-	 if ( !is_binary_file( (SOURCE_NAME) ) && \
-          !compile( (SOURCE_NAME) ) ) { \
-         fprintf( stderr, "Compile %s error.\n", SOURCE_NAME ); \
-         return 0; \
-     } \
-} while(0) \
-
-// Variables
-static struct sys_arg_t sysinfo;
-
-// Global information
-int Verbose_mode;
-
-static void release()
-{
-    if ( sysinfo.di_in != NULL ) close_folder( sysinfo.di_in );
-    if ( sysinfo.di_out != NULL ) close_folder( sysinfo.di_out );
-    if ( sysinfo.di_temp != NULL ) {
-        // Delete temporary directory
-        if ( !remove_folder( sysinfo.di_temp -> folder_name ) ) {
-            fprintf( stderr, "Please remove the temporary folder manually.\n" );
-        }
-        
-        close_folder( sysinfo.di_temp );
-    }
+#include "hash.h"
+#include "ojtester.h"
 
-    if ( sysinfo.sp_inout != NULL ) close_pattern( sysinfo.sp_inout );
-    
-    free2d( (char**)sysinfo.resp, sysinfo.num_of_progs );
-}
+// Long options have no letter
+#define OPT_RESUME		OJT_OPT_RESUME
+
+// The run is a job of libojtester, given the options as they come
+static struct ojt_job_t* job = NULL;
+
+// Resume the journal of the interrupted run having the same arguments
+static int resume_run = 0;
+static char run_digest[ HASH_HEX_LEN + 1 ];
+
+// Packing is not a run to be repeated
+static int packing = 0;
+
+static struct option long_options[] = {
+    { "resume", no_argument, NULL, OPT_RESUME },
+    { NULL, 0, NULL, 0 }
+};
 
 static void print_help(const char* pname)
 {
@@ -96,169 +52,54 @@ static void print_help(const char* pname)
     printf( "-g=[STRING], specify the data generator\n" );
     printf( "-I=[STRING], specify the input data folder\n" );
     printf( "-O=[STRING], specify the output data folder\n" );
-    printf( "-j=[STRING], specify the special judge program\n" );
+    printf( "-j=[STRING], specify the special judge program, or a .so checker plugin\n" );
+    printf( "-P=[STRING], pack the -I and -O folders into a single file, -I accepts it afterwards\n" );
+    printf( "-U=[STRING], unpack a pack into the -I and -O folders\n" );
+    printf( "-H=[STRING], check by an answer store of digests, built from -O or the standard program if missing\n" );
+    printf( "-m=[STRING], compare outputs by diff (default), token, float[=EPS] or lines (in any order)\n" );
+    printf( "-i=[STRING], specify the interactor of an interactive problem\n" );
+    printf( "-t, record the conversation with the interactor as the program's output\n" );
     printf( "-D=[STRING], keep all intermediate data in a folder with specified name\n" );
     printf( "-v, display  show verbose information\n" );
+    printf( "-S, show where the time goes, phase by phase\n" );
+    printf( "-R=[STRING], write a JSON report of all results and phases to a file\n" );
     printf( "-T=[NUMBER], time resource limit, measured in millionsecond\n" );
     printf( "-M=[NUMBER], memory resource limit, measured in KB\n" );
+    printf( "-X=[FACTOR[,NUMBER]], limit each case to FACTOR times the standard program's time on it, but at least NUMBER ms ( default %d )\n", DEFAULT_TIME_FLOOR );
+    printf( "-e=[NUMBER], seed of the generated cases ( default is picked by time and printed )\n" );
+    printf( "-G=[NUMBER], run this many generators at once, making cases ahead of the judging ( default 1 )\n" );
+    printf( "-B=[NUMBER], stress test for this many seconds on every core ( or -G workers ), stop at the first failed case\n" );
+    printf( "-Y=[N1,N2,...[xREPS][@SIZE]], estimate the complexity: time the programs REPS times ( default 3 ) at each size given to the generator, predict them at SIZE\n" );
+    printf( "-w, run Python programs in warm runtimes, started once and shown apart from the cases\n" );
+    printf( "-C=[NUMBER], measure the launch overhead by running a null program this many times, and show corrected times\n" );
+    printf( "-K, apply the time limit to corrected times ( calibrated by -C%d if -C is not given )\n", DEFAULT_CALIB_RUNS );
+    printf( "-Z=[NUMBER], isolate timing: pin programs to a dedicated core without ASLR, and run noisy runs again up to this many times\n" );
+    printf( "-p=[NUMBER], lower the nice value of programs by this much, needs privilege ( implies -Z%d )\n", DEFAULT_RERUNS );
+    printf( "-L=[NUMBER], output size limit, measured in KB ( default is 256MB, 0 means unlimited )\n" );
+    printf( "-N=[STRING], spread the cases over workers, e.g. host1:9000,host2:9000, proving the secret in $%s\n", WORKER_SECRET_ENV );
+    printf( "-W=[[HOST:]PORT], run as a worker serving on this address ( %s if only the port is given ), for coordinators knowing $%s\n", DEFAULT_WORKER_HOST, WORKER_SECRET_ENV );
+    printf( "--resume, go on with the interrupted run having the same arguments, from its journal %s\n", TESTER_JOURNAL );
     printf( "-h, print this help\n" );
     putchar( '\n' );
 
     printf( "Version: %s\n", VERSION );
 }
 
-static void init_options()
-{
-    sysinfo.runs = DEFAULT_RUNS;
-    sysinfo.passed_cases = 0;
-    sysinfo.res_cons.time_limit = DEFAULT_WAIT_TIME;
-    sysinfo.res_cons.mem_limit = DEFAULT_MEMORY_SIZE;
-    sysinfo.num_of_progs = 0;
-    sysinfo.std_inx = 0;
-    sysinfo.progs = NULL;
-    sysinfo.gen_prog[0] = sysinfo.checker_prog[0] = 0;
-    sysinfo.input_file[0] = sysinfo.output_file[0] = sysinfo.dump_dir[0] = 0;
-    sysinfo.di_in = sysinfo.di_out = sysinfo.di_temp = NULL;
-    sysinfo.sp_inout = NULL;
-    sysinfo.resp = NULL;
-}
-
-/*
- * 1. Guess the testing method;
- * 2. Validate the arguments.
- */
-static int guess_intention()
-{
-    int i;
-    char buf[128];
-
-    // Request needed resources
-    if ( ( sysinfo.di_temp = open_folder( buf ) ) == NULL ) {
-        fprintf( stderr, "Create temporary data failed.\n" );
-        return 0;
-    }   
-
-    sysinfo.resp = ( struct RESUSE** )malloc2d( sysinfo.num_of_progs,
-                                                sizeof( struct RESUSE ) );
-
-    if ( sysinfo.resp == NULL ) {
-        close_folder( sysinfo.di_temp );
-        return 0;
-    }
-    
-    // Check and compile all candidate programs
-    for ( i = 0; i < sysinfo.num_of_progs; ++i )
-        COMPILE_SOURCE_CODE( sysinfo.progs[i] );
-
-    // Guess testing mode
-    if ( sysinfo.checker_prog[0] ) {
-        COMPILE_SOURCE_CODE( sysinfo.checker_prog );
-        load_res_gen( OOPS );
-        load_checker( CHECK_BY_JUDGE );
-    }
-    else {
-        load_checker( CHECK_BY_COMPARISON );
-    }
-    
-    if ( file_exist( sysinfo.gen_prog ) ) {
-        // Get data from generator
-        if ( !( sysinfo.std_inx >= 0 &&
-                sysinfo.std_inx < sysinfo.num_of_progs ) ) {
-            fprintf( stderr, "Warning: Standard program index is out of range.\n" );
-            fprintf( stderr, "Change back to 0.\n" );
-            sysinfo.std_inx = 0;
-        }
-
-        COMPILE_SOURCE_CODE( sysinfo.gen_prog );
-        
-        load_input( INPUT_BY_GENERATOR );
-        load_res_gen( RESULT_BY_GENERATOR );
-    }
-    else if ( sysinfo.di_in != NULL ) {
-        // Get data from predefined directory
-        load_input( INPUT_BY_FOLDER );
-        
-        if ( sysinfo.di_out != NULL ) {
-            sysinfo.sp_inout = detect_pattern( sysinfo.di_in -> folder_name,
-                                               sysinfo.di_out -> folder_name );
-            if ( sysinfo.sp_inout == NULL ) {
-                fprintf( stderr, "There's no unique mapping pattern between input and output file.\n" );
-                fprintf( stderr, "I suggest you should check it before runing test again.\n" );
-                return 0;
-            }
-
-            load_res_gen( RESULT_BY_FOLDER );
-        }
-        else
-            load_res_gen( RESULT_BY_GENERATOR );
-    }
-    else
-        return 0;
-
-    // Create temporary directory
-    buf[127] = 0;
-    sprintf( buf, "%d_%d", getpid(), time(NULL) );
-    if ( buf[127] != 0 ) {
-        // A serious security problem, please report
-        fprintf( stderr, "A series problem, please send me following string:\n" );
-        fprintf( stderr, "%d_%d\n", getpid(), time(NULL) );
-        return 0;
-    }
-    
-    return 1;
-}
-
 static int parse_arguments( int argc, char **argv )
 {
+    struct hash_ctx_t ctx;
+    unsigned char digest[ HASH_LEN ];
     int i, c;
 
-    Verbose_mode = 0;
-    
-    while ( ( c = getopt( argc, argv, 
-                          "ac:s:g:I:O:j:D:vT:M:h" ) ) != -1 ) {
+    while ( ( c = getopt_long( argc, argv,
+                               "c:s:g:I:O:H:P:U:j:m:i:tD:vSR:T:X:M:e:G:B:Y:C:wKZ:p:L:N:W:h",
+                               long_options, NULL ) ) != -1 ) {
     
         switch ( c ) {
-            case 'c':
-                sysinfo.runs = atoi( optarg );
-                if ( sysinfo.runs <= 0 ) sysinfo.runs = DEFAULT_RUNS;
-                break;
-      
-            case 's':
-                sysinfo.std_inx = atoi( optarg );
-                break;
-
-            case 'g':
-                SET_PROG_ARG( gen_prog, "-g" );
-                break;
-
-            case 'I':
-                LOAD_DIRECTORY( di_in, "-I" );
-                break;
-      
-            case 'O':
-                LOAD_DIRECTORY( di_out, "-O" );
-                break;
-
-            case 'j':
-                SET_PROG_ARG( checker_prog, "-j" );
-                break;
-      
-            case 'D':
-                strcpy( sysinfo.dump_dir, optarg );
-                break;
-
-            case 'v':
-                Verbose_mode = 1;
-                break;
-
-            case 'T':
-                sysinfo.res_cons.time_limit = atoi( optarg );
+            case OPT_RESUME:
+                resume_run = 1;
                 break;
 
-            case 'M':
-                sysinfo.res_cons.mem_limit = atoi( optarg );
-                break;
-                
             case 'h':
                 print_help( argv[0] );
                 exit( 0 );
@@ -266,30 +107,33 @@ static int parse_arguments( int argc, char **argv )
             case '?':
                 printf( "Invalid option: %s\n", optarg );
                 exit( -1 );
+
+            default:
+                if ( c == 'P' || c == 'U' ) packing = 1;
+                if ( !ojt_set_option( job, c, optarg ) ) return 0;
         }
     }
 
+    /*
+     * The run is known by its arguments, in the order getopt leaves them,
+     * whether they are typed or loaded.
+     */
+    hash_init( &ctx );
+    for ( i = 1; i < argc; ++i )
+        if ( strcmp( argv[i], "--resume" ) != 0 )
+            hash_update( &ctx, argv[i], strlen( argv[i] ) + 1 );
+    hash_final( &ctx, digest );
+    hash_to_hex( digest, run_digest );
+
+    if ( !ojt_set_option( job, OJT_OPT_JOURNAL, run_digest ) ||
+         ( resume_run && !ojt_set_option( job, OJT_OPT_RESUME, NULL ) ) ) return 0;
+
     // Copy left arguments
-    sysinfo.num_of_progs = argc - optind;
-    if ( sysinfo.num_of_progs == 0 ) {
-        printf( "No program specified. Abort.\n" );
-        return 0;
-    }
-    
-    sysinfo.progs = (char**)malloc2d( sysinfo.num_of_progs, FILE_NAME_LEN );
-    if ( sysinfo.progs == NULL ) {
-#ifdef DEBUG
-        fprintf( stderr, "Out of memory: %s(%d)\n",
-                 __FILE__, __LINE__ );
-#endif
-        return 0;
-    }
-    
-    for ( i = 0; i < sysinfo.num_of_progs; ++i ) {
-        sprintf( sysinfo.progs[i],
-                 argv[optind+i][0] == '/' ? "%s" : "./%s",
-                 argv[optind+i] );
-    }
+    for ( i = optind; i < argc; ++i )
+        if ( ojt_add_program( job, argv[i] ) == -1 ) {
+            fprintf( stderr, "Add program %s failed.\n", argv[i] );
+            return 0;
+        }
     
     return 1;
 }
@@ -319,7 +163,8 @@ static void save_arguments_to_file( const char* file,
     fp = fopen( file, "w" );
     if ( fp == NULL ) return;
 
-    for ( i = 0; i < argc; ++i ) fprintf( fp, "%s ", args[i] );
+    for ( i = 0; i < argc; ++i )
+        if ( strcmp( args[i], "--resume" ) != 0 ) fprintf( fp, "%s ", args[i] );
     fputc( '\n', fp );
 
     fclose( fp );
@@ -345,7 +190,7 @@ static int read_options_from_file( const char* run_name )
     strcpy( argv[0], run_name );
 
     // Initialize
-    if ( !parse_arguments( argc, argv ) || !guess_intention() ) {
+    if ( !parse_arguments( argc, argv ) || !ojt_submit( job ) ) {
         // Actually, this code is not reachable
         free2d( argv, ARGUMENTS_NUM );
         return 0;
@@ -364,7 +209,7 @@ static int read_options_from_file( const char* run_name )
 static void sig_handler( int sigid )
 {
     // Clear temporary data
-    release();
+    ojt_abort( job );
     
     // Terminate all child processes
     if ( sigid == SIGINT ||
@@ -374,26 +219,31 @@ static void sig_handler( int sigid )
 /*
  * Process:
  * 1. Handle arguments, use last successful one while this is broken;
- * 2. Set up running environment;
- * 3. Run.
+ * 2. Hand them to a job of libojtester, which sets up the running environment;
+ * 3. Run it.
  */
 int main( int argc, char** argv )
 {
-    int i;
+    int ok;
     
-    init_options();
+    if ( ( job = ojt_create_job() ) == NULL ) return -1;
 
-    if ( argc == 1 ) {
-        if ( !read_options_from_file( argv[0] ) )
+    // Alone, --resume goes on with the last arguments
+    if ( argc == 1 || ( argc == 2 && strcmp( argv[1], "--resume" ) == 0 ) ) {
+        resume_run = ( argc == 2 );
+        if ( !read_options_from_file( argv[0] ) ) {
+            ojt_close_job( job );
             return -1;
+        }
     }
     else {
-        if ( !parse_arguments( argc, argv ) || !guess_intention() ) {
+        if ( !parse_arguments( argc, argv ) || !ojt_submit( job ) ) {
             fprintf( stderr, "You can also use -h to see help if you wish.\n" );
+            ojt_close_job( job );
             return -1;
         }
         
-        save_arguments_to_file( TESTER_RC, argc - 1, argv + 1 );
+        if ( !packing ) save_arguments_to_file( TESTER_RC, argc - 1, argv + 1 );
     }
 
     // Install signal handlers
@@ -401,9 +251,9 @@ int main( int argc, char** argv )
     if ( signal( SIGTERM, sig_handler ) == SIG_ERR ) return -1;
     if ( signal( SIGSEGV, sig_handler ) == SIG_ERR ) return -1;
     
-    // Run supervised judge
-    judge( &sysinfo );
-    release();
+    // The judging runs in the thread of the job
+    ok = ojt_wait( job );
+    ojt_close_job( job );
     
-    return 0;
+    return ok ? 0 : -1;
 }
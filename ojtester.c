@@ -0,0 +1,557 @@
+/*
+ * The asynchronous interface of libojtester, see ojtester.h.
+ * A submitted job runs in a thread of its own, with its own sys_arg_t, runtime
+ * and scratch folder: its own cases are judged by judge_case(), much as a worker
+ * judges a job of the coordinator, otherwise it runs as tester does with its options.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "consts.h"
+#include "type_def.h"
+#include "file.h"
+#include "libsys.h"
+#include "runtime.h"
+#include "judge.h"
+#include "libprocs.h"
+#include "hash.h"
+#include "options.h"
+#include "ojtester.h"
+
+// States of a job
+#define JOB_NEW			0
+#define JOB_RUNNING		1
+#define JOB_DONE		2
+#define JOB_FAILED		3
+
+// Services of the process a job run by options may hold, one job at a time
+#define CLAIM_JOURNAL	1
+#define CLAIM_WARM		2
+#define CLAIM_STRESS	4
+#define CLAIM_ISOLATE	8
+
+// Results carry the RES_ codes as they are, the OJT_ codes must stay the same numbers
+typedef char verdicts_match[ OJT_AC == RES_AC && OJT_WA == RES_WA && OJT_PE == RES_PE &&
+                             OJT_TLE == RES_TLE && OJT_MLE == RES_MLE && OJT_SE == RES_SE &&
+                             OJT_VE == RES_VE && OJT_NOT_CHECK == RES_NOT_CHECK &&
+                             OJT_OLE == RES_OLE ? 1 : -1 ];
+
+struct ojt_case_t
+{
+    char* input;
+
+    // NULL if the standard program answers
+    char* answer;
+};
+
+struct ojt_job_t
+{
+    struct sys_arg_t arg;
+
+    // What is added before the job is submitted
+    char** progs;
+    struct ojt_case_t* cases;
+    int num_progs, num_cases;
+
+    OJT_CALLBACK callback;
+    void* ctx;
+
+    // Name of the run in the journal, if journaled
+    char run[ HASH_HEX_LEN + 1 ];
+    int journaled, resume;
+
+    // CLAIM_ services held while it runs
+    int claims;
+
+    // Results made by the job thread, the first taken of them are gone to ojt_next_result()
+    struct ojt_result_t* results;
+    int num_results, cap_results, taken;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t more;
+    int state, joined, cancelled;
+};
+
+// Numbers the scratch folders of the jobs of this process
+static int num_jobs = 0;
+
+// Services held by the running jobs
+static int claimed = 0;
+static pthread_mutex_t claim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct ojt_job_t* ojt_create_job()
+{
+    struct ojt_job_t* job;
+    struct sys_arg_t* parg;
+
+    if ( ( job = ( struct ojt_job_t* )calloc( 1, sizeof( struct ojt_job_t ) ) ) == NULL )
+        return NULL;
+
+    parg = &( job -> arg );
+    options_init( parg );
+
+    pthread_mutex_init( &( job -> lock ), NULL );
+    pthread_cond_init( &( job -> more ), NULL );
+    job -> state = JOB_NEW;
+
+    return job;
+}
+
+int ojt_add_program( struct ojt_job_t* job, const char* prog )
+{
+    char** p;
+
+    if ( job -> state != JOB_NEW || job -> num_progs == ARGUMENTS_NUM ||
+         strlen( prog ) + 2 > FILE_NAME_LEN ) return -1;
+
+    p = ( char** )realloc( job -> progs, ( job -> num_progs + 1 ) * sizeof( char* ) );
+    if ( p == NULL ) return -1;
+    job -> progs = p;
+
+    if ( ( p[ job -> num_progs ] = strdup( prog ) ) == NULL ) return -1;
+    return job -> num_progs++;
+}
+
+int ojt_add_case( struct ojt_job_t* job, const char* input, const char* answer )
+{
+    struct ojt_case_t* pc;
+
+    if ( job -> state != JOB_NEW || strlen( input ) > FILE_NAME_LEN ||
+         ( answer != NULL && strlen( answer ) > FILE_NAME_LEN ) ) return -1;
+
+    pc = ( struct ojt_case_t* )realloc( job -> cases,
+                                        ( job -> num_cases + 1 ) * sizeof( struct ojt_case_t ) );
+    if ( pc == NULL ) return -1;
+    job -> cases = pc;
+
+    pc += job -> num_cases;
+    pc -> input = strdup( input );
+    pc -> answer = ( answer == NULL ? NULL : strdup( answer ) );
+    if ( pc -> input == NULL || ( answer != NULL && pc -> answer == NULL ) ) {
+        free( pc -> input );
+        free( pc -> answer );
+        return -1;
+    }
+
+    return job -> num_cases++;
+}
+
+int ojt_set_standard( struct ojt_job_t* job, int inx )
+{
+    if ( job -> state != JOB_NEW || inx < 0 ) return 0;
+
+    job -> arg.std_inx = inx;
+    return 1;
+}
+
+void ojt_set_limits( struct ojt_job_t* job, int time_limit, int mem_limit, int out_limit )
+{
+    if ( job -> state != JOB_NEW ) return;
+    
+    if ( time_limit >= 0 ) job -> arg.res_cons.time_limit = time_limit;
+    if ( mem_limit >= 0 ) job -> arg.res_cons.mem_limit = mem_limit;
+    if ( out_limit >= 0 ) job -> arg.res_cons.out_limit = out_limit;
+}
+
+int ojt_set_checker( struct ojt_job_t* job, const char* checker )
+{
+    if ( job -> state != JOB_NEW || strlen( checker ) + 2 > FILE_NAME_LEN ) return 0;
+
+    sprintf( job -> arg.checker_prog,
+             checker[0] == '/' ? "%s" : "./%s",
+             checker );
+    return 1;
+}
+
+int ojt_set_compare( struct ojt_job_t* job, const char* mode )
+{
+    return job -> state == JOB_NEW && parse_compare_mode( mode, &( job -> arg.cmp_opt ) );
+}
+
+void ojt_set_callback( struct ojt_job_t* job, OJT_CALLBACK callback, void* ctx )
+{
+    if ( job -> state != JOB_NEW ) return;
+    
+    job -> callback = callback;
+    job -> ctx = ctx;
+}
+
+int ojt_set_option( struct ojt_job_t* job, int opt, const char* value )
+{
+    if ( job -> state != JOB_NEW ) return 0;
+
+    switch ( opt ) {
+        case OJT_OPT_JOURNAL:
+            if ( value == NULL || strlen( value ) > HASH_HEX_LEN ) return 0;
+            strcpy( job -> run, value );
+            job -> journaled = 1;
+            return 1;
+
+        case OJT_OPT_RESUME:
+            job -> resume = 1;
+            return 1;
+    }
+
+    return options_set( &( job -> arg ), opt, value );
+}
+
+const char* ojt_verdict_text( int verdict )
+{
+    return ( verdict > RES_NORMAL && verdict < RES_CODES ? pres_text[ verdict ] : "Unknown" );
+}
+
+/*
+ * Compile what needs it and load the checker.
+ * Return 0 if failed.
+ */
+static int prepare_job( struct ojt_job_t* job )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+    int i, len;
+
+    for ( i = 0; i < parg -> num_of_progs; ++i )
+        if ( !is_binary_file( parg -> progs[i] ) && !compile( parg -> progs[i] ) )
+            return 0;
+
+    if ( parg -> checker_prog[0] ) {
+        len = strlen( parg -> checker_prog );
+
+        if ( len > 3 && strcmp( parg -> checker_prog + len - 3, ".so" ) == 0 ) {
+            if ( !load_checker_plugin( parg, parg -> checker_prog ) ) return 0;
+            load_checker( parg, CHECK_BY_PLUGIN );
+        }
+        else {
+            if ( !is_binary_file( parg -> checker_prog ) &&
+                 !compile( parg -> checker_prog ) ) return 0;
+            load_checker( parg, CHECK_BY_JUDGE );
+        }
+    }
+    else
+        load_checker( parg, parg -> cmp_opt.mode == CMP_DIFF ?
+                      CHECK_BY_COMPARISON : CHECK_BY_TOKENS );
+
+    return 1;
+}
+
+// Hand the results of case Arg2 out
+static void post_case( struct ojt_job_t* job, int id, const int* verdicts )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+    struct ojt_result_t* pr;
+    int i, cap;
+
+    // Only this thread moves the results, the taker reads them under the lock
+    if ( job -> num_results + parg -> num_of_progs > job -> cap_results ) {
+        cap = job -> cap_results * 2 + parg -> num_of_progs;
+
+        pthread_mutex_lock( &( job -> lock ) );
+        pr = ( struct ojt_result_t* )realloc( job -> results, cap * sizeof( struct ojt_result_t ) );
+        if ( pr != NULL ) {
+            job -> results = pr;
+            job -> cap_results = cap;
+        }
+        pthread_mutex_unlock( &( job -> lock ) );
+
+        if ( pr == NULL ) return;
+    }
+
+    for ( i = 0; i < parg -> num_of_progs; ++i ) {
+        pr = job -> results + job -> num_results + i;
+        pr -> case_id = id;
+        pr -> prog = i;
+        pr -> verdict = verdicts[i];
+        pr -> time_ms = time_used( parg -> resp[i] );
+        pr -> mem_kb = mem_used( parg -> resp[i] );
+        pr -> out_bytes = out_used( parg -> resp[i] );
+
+        if ( job -> callback != NULL ) job -> callback( pr, job -> ctx );
+    }
+
+    pthread_mutex_lock( &( job -> lock ) );
+    job -> num_results += parg -> num_of_progs;
+    pthread_cond_broadcast( &( job -> more ) );
+    pthread_mutex_unlock( &( job -> lock ) );
+}
+
+// Case hook of judge(): hand the case out, go on unless cancelled
+static int post_tester_case( struct sys_arg_t* parg, int case_no, const int* verdicts )
+{
+    struct ojt_job_t* job = ( struct ojt_job_t* )parg -> hook_ctx;
+
+    post_case( job, case_no - 1, verdicts );
+    return !__atomic_load_n( &( job -> cancelled ), __ATOMIC_RELAXED );
+}
+
+/*
+ * Take the services of the process the options of the job need.
+ * Return 0 if a running job holds one of them, the reason is printed.
+ */
+static int claim_services( struct ojt_job_t* job )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+    int want = 0, busy;
+
+    if ( job -> journaled ) want |= CLAIM_JOURNAL;
+    if ( parg -> warm ) want |= CLAIM_WARM;
+    if ( parg -> budget > 0 ) want |= CLAIM_STRESS;
+    if ( parg -> res_cons.isolate ) want |= CLAIM_ISOLATE;
+
+    pthread_mutex_lock( &claim_lock );
+    busy = claimed & want;
+    if ( busy == 0 ) claimed |= want;
+    pthread_mutex_unlock( &claim_lock );
+
+    if ( busy != 0 ) {
+        fprintf( stderr, "Another running job holds%s%s%s%s, one job at a time may have it.\n",
+                 busy & CLAIM_JOURNAL ? " the journal" : "",
+                 busy & CLAIM_WARM ? " the warm runtimes (-w)" : "",
+                 busy & CLAIM_STRESS ? " the stress test (-B)" : "",
+                 busy & CLAIM_ISOLATE ? " the isolated CPU (-Z, -p)" : "" );
+        return 0;
+    }
+
+    job -> claims = want;
+    return 1;
+}
+
+// Release what the job has loaded and made on disk
+static void release_job( struct ojt_job_t* job )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+
+    options_release( parg );
+    runtime_close( parg );
+
+    // The services are stopped by now
+    if ( job -> claims ) {
+        pthread_mutex_lock( &claim_lock );
+        claimed &= ~job -> claims;
+        pthread_mutex_unlock( &claim_lock );
+        job -> claims = 0;
+    }
+    unstage_file( &( parg -> in_fd ) );
+    unstage_file( &( parg -> out_fd ) );
+
+    // Dumped data has taken the folder away
+    if ( parg -> di_temp != NULL ) {
+        if ( !remove_folder( parg -> di_temp -> folder_name ) )
+            fprintf( stderr, "Please remove the temporary folder %s manually.\n",
+                     parg -> di_temp -> folder_name );
+        close_folder( parg -> di_temp );
+        parg -> di_temp = NULL;
+    }
+}
+
+static void end_job( struct ojt_job_t* job, int ok )
+{
+    release_job( job );
+
+    pthread_mutex_lock( &( job -> lock ) );
+    job -> state = ( ok ? JOB_DONE : JOB_FAILED );
+    pthread_cond_broadcast( &( job -> more ) );
+    pthread_mutex_unlock( &( job -> lock ) );
+}
+
+/*
+ * Judge the cases one by one, as a worker does.
+ * A case whose data can't be read is a system error of every program.
+ */
+static void* run_job( void* p )
+{
+    struct ojt_job_t* job = ( struct ojt_job_t* )p;
+    struct sys_arg_t* parg = &( job -> arg );
+    struct ojt_case_t* pc;
+    int *verdicts, i, j, ok;
+
+    verdicts = ( int* )malloc( parg -> num_of_progs * sizeof( int ) );
+    ok = ( verdicts != NULL && prepare_job( job ) );
+
+    for ( i = 0; ok && i < job -> num_cases; ++i ) {
+        if ( __atomic_load_n( &( job -> cancelled ), __ATOMIC_RELAXED ) ) {
+            ok = 0;
+            break;
+        }
+
+        pc = job -> cases + i;
+        strcpy( parg -> case_file, pc -> input );
+
+        for ( j = 0; j < parg -> num_of_progs; ++j )
+            memset( parg -> resp[j], 0, sizeof( struct RESUSE ) );
+
+        if ( access( pc -> input, R_OK ) != 0 ||
+             ( pc -> answer != NULL && access( pc -> answer, R_OK ) != 0 ) ||
+             !stage_file( pc -> input, pc -> input, parg -> input_file, &( parg -> in_fd ) ) ||
+             ( pc -> answer != NULL &&
+               !stage_file( pc -> answer, pc -> answer, parg -> output_file,
+                            &( parg -> out_fd ) ) ) ) {
+            for ( j = 0; j < parg -> num_of_progs; ++j ) verdicts[j] = RES_SE;
+        }
+        else {
+            load_res_gen( parg, pc -> answer != NULL ? OOPS : RESULT_BY_GENERATOR );
+
+            if ( !judge_case( parg, verdicts ) )
+                for ( j = 0; j < parg -> num_of_progs; ++j ) verdicts[j] = RES_SE;
+        }
+
+        post_case( job, i, verdicts );
+    }
+
+    free( verdicts );
+    end_job( job, ok );
+    return NULL;
+}
+
+// Run as tester does with the options of the job
+static void* run_options( void* p )
+{
+    struct ojt_job_t* job = ( struct ojt_job_t* )p;
+
+    end_job( job, options_run( &( job -> arg ) ) );
+    return NULL;
+}
+
+int ojt_submit( struct ojt_job_t* job )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+    char buf[ 128 ];
+    int i, by_options;
+
+    if ( job -> state != JOB_NEW ) return 0;
+
+    // Cases are added, or come from the options
+    by_options = ( job -> num_cases == 0 );
+    if ( !by_options &&
+         ( job -> num_progs == 0 || parg -> std_inx >= job -> num_progs ||
+           parg -> gen_prog[0] || parg -> di_in != NULL || parg -> pack_file[0] ||
+           parg -> worker_hosts[0] || parg -> worker_port > 0 ) ) return 0;
+
+    if ( by_options && !claim_services( job ) ) return 0;
+
+    // Whatever happens now, the job is over unless its thread starts
+    job -> state = JOB_FAILED;
+    job -> joined = 1;
+
+    parg -> num_of_progs = job -> num_progs;
+    job -> cap_results = job -> num_cases * job -> num_progs;
+    if ( job -> num_progs > 0 ) {
+        parg -> progs = malloc2d( job -> num_progs, FILE_NAME_LEN );
+        parg -> resp = ( struct RESUSE** )malloc2d( job -> num_progs, sizeof( struct RESUSE ) );
+        job -> results = ( struct ojt_result_t* )malloc( job -> cap_results *
+                                                         sizeof( struct ojt_result_t ) + 1 );
+
+        if ( parg -> progs == NULL || parg -> resp == NULL || job -> results == NULL ) {
+            release_job( job );
+            return 0;
+        }
+
+        for ( i = 0; i < job -> num_progs; ++i )
+            sprintf( parg -> progs[i],
+                     job -> progs[i][0] == '/' ? "%s" : "./%s",
+                     job -> progs[i] );
+    }
+
+    // Concurrent jobs must not share the scratch folder
+    sprintf( buf, "%d_%d_j%d", getpid(), (int)time( NULL ),
+             __atomic_add_fetch( &num_jobs, 1, __ATOMIC_RELAXED ) );
+
+    if ( ( parg -> di_temp = open_folder( buf ) ) == NULL || !runtime_open( parg ) ||
+         ( by_options &&
+           !options_prepare( parg, job -> journaled ? job -> run : NULL, job -> resume ) ) ) {
+        release_job( job );
+        return 0;
+    }
+
+    parg -> case_hook = post_tester_case;
+    parg -> hook_ctx = job;
+
+    job -> state = JOB_RUNNING;
+    job -> joined = 0;
+    if ( pthread_create( &( job -> thread ), NULL,
+                         by_options ? run_options : run_job, job ) != 0 ) {
+        release_job( job );
+        job -> state = JOB_FAILED;
+        job -> joined = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+int ojt_next_result( struct ojt_job_t* job, struct ojt_result_t* pr, int wait )
+{
+    int ret;
+
+    pthread_mutex_lock( &( job -> lock ) );
+    while ( wait && job -> taken == job -> num_results && job -> state == JOB_RUNNING )
+        pthread_cond_wait( &( job -> more ), &( job -> lock ) );
+
+    if ( job -> taken < job -> num_results ) {
+        *pr = job -> results[ job -> taken++ ];
+        ret = 1;
+    }
+    else
+        ret = ( job -> state == JOB_RUNNING ? 0 : -1 );
+
+    pthread_mutex_unlock( &( job -> lock ) );
+    return ret;
+}
+
+void ojt_cancel( struct ojt_job_t* job )
+{
+    __atomic_store_n( &( job -> cancelled ), 1, __ATOMIC_RELAXED );
+}
+
+int ojt_wait( struct ojt_job_t* job )
+{
+    if ( job -> state == JOB_NEW ) return 0;
+
+    if ( !job -> joined ) {
+        pthread_join( job -> thread, NULL );
+        job -> joined = 1;
+    }
+
+    return job -> state == JOB_DONE;
+}
+
+void ojt_abort( struct ojt_job_t* job )
+{
+    struct sys_arg_t* parg = &( job -> arg );
+
+    if ( parg -> report.fp != NULL ) fflush( parg -> report.fp );
+    if ( parg -> di_temp != NULL && !remove_folder( parg -> di_temp -> folder_name ) )
+        fprintf( stderr, "Please remove the temporary folder %s manually.\n",
+                 parg -> di_temp -> folder_name );
+}
+
+void ojt_close_job( struct ojt_job_t* job )
+{
+    int i;
+
+    if ( job == NULL ) return;
+
+    // Folders loaded by options of a job never submitted
+    if ( job -> state == JOB_NEW ) options_release( &( job -> arg ) );
+    ojt_wait( job );
+
+    for ( i = 0; i < job -> num_progs; ++i ) free( job -> progs[i] );
+    for ( i = 0; i < job -> num_cases; ++i ) {
+        free( job -> cases[i].input );
+        free( job -> cases[i].answer );
+    }
+
+    free( job -> progs );
+    free( job -> cases );
+    free( job -> results );
+    free2d( job -> arg.progs, job -> arg.num_of_progs );
+    free2d( ( char** )job -> arg.resp, job -> arg.num_of_progs );
+
+    pthread_mutex_destroy( &( job -> lock ) );
+    pthread_cond_destroy( &( job -> more ) );
+    free( job );
+}
@@ -0,0 +1,167 @@
+/*
+ * libojtester, judging programs from inside another program.
+ * A job holds the programs and the cases to judge them on; once submitted it is
+ * judged in a thread of its own, and the results of every case are given to the
+ * callback and queued for ojt_next_result() as soon as the case is judged.
+ * A job may take tester's options instead of cases, tester itself is such a job.
+ * Jobs share nothing but the options ojt_set_option() names, any number of them
+ * can run at the same time.
+ * Build with make libojtester.a or libojtester.so, link with -ldl -lm -pthread.
+ * By richardxx, 2009.6
+ */
+
+#ifndef OJTESTER_H
+#define OJTESTER_H
+
+#define OJT_API_VERSION		1
+
+// libojtester exports these functions only, the rest is built hidden
+#define OJT_API			__attribute__(( visibility( "default" ) ))
+
+// Verdicts of a result, ojt_verdict_text() describes them
+#define OJT_AC			1
+#define OJT_WA			2
+#define OJT_PE			3
+#define OJT_TLE			4
+#define OJT_MLE			5
+#define OJT_SE			6       // the case couldn't be judged, e.g. its input is missing
+#define OJT_VE			7       // the interactor rejected the conversation
+#define OJT_NOT_CHECK	8
+#define OJT_OLE			9
+
+struct ojt_job_t;
+
+// Result of a program on a case
+struct ojt_result_t
+{
+    int case_id;        // As returned by ojt_add_case(), or the number of the case from 0
+    int prog;           // As returned by ojt_add_program()
+    int verdict;
+    int time_ms, mem_kb;
+    long long out_bytes;
+};
+
+/*
+ * Called from the thread of the job, Arg2 is the context given with it.
+ * The result is only valid during the call.
+ */
+typedef void (*OJT_CALLBACK)( const struct ojt_result_t*, void* );
+
+// Return NULL if out of memory
+extern OJT_API
+struct ojt_job_t* ojt_create_job();
+
+/*
+ * Add a program, a source file is compiled when the job starts.
+ * Return its number from 0, -1 if failed.
+ */
+extern OJT_API
+int ojt_add_program( struct ojt_job_t*, const char* );
+
+/*
+ * Add a case, input Arg2 with the standard answer Arg3.
+ * Without an answer (NULL), the output of the standard program is the answer.
+ * Files may be compressed as the input folders of tester.
+ * Return its number from 0, -1 if failed.
+ */
+extern OJT_API
+int ojt_add_case( struct ojt_job_t*, const char*, const char* );
+
+// Which program gives the answers of the cases without one, 0 by default
+extern OJT_API
+int ojt_set_standard( struct ojt_job_t*, int );
+
+/*
+ * Time limit (ms), memory limit and output limit (KB, 0 for none);
+ * a negative number keeps the current one.
+ */
+extern OJT_API
+void ojt_set_limits( struct ojt_job_t*, int, int, int );
+
+/*
+ * A special judge program, or a checker built as a shared object (.so), see checker.h.
+ * Return 0 if Arg2 is too long.
+ */
+extern OJT_API
+int ojt_set_checker( struct ojt_job_t*, const char* );
+
+/*
+ * How outputs are compared without a special judge, as -m of tester:
+ * "diff", "token", "float[=EPS]" or "lines".
+ * Return 0 if Arg2 is not such a mode.
+ */
+extern OJT_API
+int ojt_set_compare( struct ojt_job_t*, const char* );
+
+extern OJT_API
+void ojt_set_callback( struct ojt_job_t*, OJT_CALLBACK, void* );
+
+// Name of verdict Arg1, "Unknown" if it is none of the OJT_ codes
+extern OJT_API
+const char* ojt_verdict_text( int );
+
+// Options of tester without a letter
+#define OJT_OPT_JOURNAL		256     // journal the cases in .tester_journal, the value names the run
+#define OJT_OPT_RESUME		257     // go on with the journal of the same run, as --resume
+
+/*
+ * Set an option of tester by its letter as tester -h lists it, with its value
+ * (NULL for an option taking none), e.g. ojt_set_option( job, 'g', "gen.c" ).
+ * A job without cases of ojt_add_case() then runs as tester does: the cases come
+ * from the generator, the folders or the pack, tester's report goes to the standard
+ * output, and the results of the plain judging (without -N, -B and -Y) are handed
+ * out as well; -P, -U and -W pack or serve instead, needing no programs.
+ * With cases of ojt_add_case(), only -T, -M, -L, -j, -m and -s apply.
+ * -v is for the whole process; -w, -B, -Z, -p and the journal are services of the
+ * process, held by one running job at a time, see ojt_submit().
+ * Return 0 if Arg2 is unknown or Arg3 is invalid, the reason is printed.
+ */
+extern OJT_API
+int ojt_set_option( struct ojt_job_t*, int, const char* );
+
+/*
+ * Start judging, the job can't be changed any more.
+ * Its scratch folder is made in the current directory, and removed when it ends.
+ * Jobs running at the same time shouldn't compile the same source.
+ * A job run by options is checked and compiled before this returns; it is refused
+ * while another running job holds the journal, -w, -B, -Z or -p it asks for.
+ * Return 0 if the job couldn't be started: one refused for a service may be
+ * submitted again later, any other can only be closed.
+ */
+extern OJT_API
+int ojt_submit( struct ojt_job_t* );
+
+/*
+ * Take the next result of the job into Arg2, results come in the order they are made.
+ * If Arg3 is set, wait until there is one.
+ * Return 1 if a result is taken, 0 if none is ready yet, -1 if the job has ended and all are taken.
+ */
+extern OJT_API
+int ojt_next_result( struct ojt_job_t*, struct ojt_result_t*, int );
+
+/*
+ * Stop the job after the case being judged.
+ */
+extern OJT_API
+void ojt_cancel( struct ojt_job_t* );
+
+/*
+ * Wait for the job to end.
+ * Return 1 if every case was judged, 0 if the job failed (e.g. a program couldn't be
+ * compiled) or was cancelled.
+ */
+extern OJT_API
+int ojt_wait( struct ojt_job_t* );
+
+/*
+ * For a process about to die, e.g. in a signal handler:
+ * remove the scratch folder of the job at once and flush its report.
+ */
+extern OJT_API
+void ojt_abort( struct ojt_job_t* );
+
+// Wait for the job and release it
+extern OJT_API
+void ojt_close_job( struct ojt_job_t* );
+
+#endif
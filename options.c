@@ -0,0 +1,618 @@
+/*
+ * The options of tester, see options.h.
+ * What main() used to do around judge(), so a job of libojtester set up by
+ * options runs just as tester does.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "consts.h"
+#include "type_def.h"
+#include "judge.h"
+#include "file.h"
+#include "libsys.h"
+#include "runtime.h"
+#include "dist.h"
+#include "stress.h"
+#include "growth.h"
+#include "warm.h"
+#include "journal.h"
+#include "options.h"
+
+// Options taking a value
+#define VALUED_OPTIONS		"csgIOHPUjmiDRTXMeGBYCZpLNW"
+
+#define SET_PROG_ARG( PROG_NAME ) \
+do { \
+    if ( value[0] == '/' ) \
+         strcpy( parg -> PROG_NAME, value ); \
+    else { \
+         strcpy( parg -> PROG_NAME, "./" ); \
+         strcpy( parg -> PROG_NAME + 2, value ); \
+    } \
+} while (0) \
+
+
+#define LOAD_DIRECTORY( PROG_NAME ) \
+do { \
+    parg -> PROG_NAME = open_folder( value ); \
+    if ( parg -> PROG_NAME == NULL ) { \
+		fprintf( stderr, "Load folder \"%s\" failed\n", value ); \
+        return 0; \
+    } \
+} while (0) \
+
+#define COMPILE_SOURCE_CODE( SOURCE_NAME ) \
+do { \
+	 if ( !is_binary_file( (SOURCE_NAME) ) && \
+          !compile( (SOURCE_NAME) ) ) { \
+         fprintf( stderr, "Compile %s error.\n", SOURCE_NAME ); \
+         return 0; \
+     } \
+} while(0) \
+
+// Global information
+extern int Verbose_mode;
+
+void options_init( struct sys_arg_t* parg )
+{
+    parg -> runs = DEFAULT_RUNS;
+    parg -> passed_cases = 0;
+    parg -> res_cons.time_limit = DEFAULT_WAIT_TIME;
+    parg -> res_cons.mem_limit = DEFAULT_MEMORY_SIZE;
+    parg -> res_cons.out_limit = DEFAULT_OUTPUT_SIZE;
+    parg -> res_cons.cpu_overhead = parg -> res_cons.wall_overhead = 0;
+    parg -> res_cons.corrected = 0;
+    parg -> res_cons.isolate = parg -> res_cons.priority = 0;
+    parg -> res_cons.cpu = -1;
+    parg -> res_cons.reruns = DEFAULT_RERUNS;
+    parg -> calib_runs = 0;
+    parg -> warm = 0;
+    parg -> seed = parg -> case_seed = 0;
+    parg -> gen_jobs = 1;
+    parg -> case_first = parg -> case_step = 1;
+    parg -> budget = 0;
+    parg -> num_sizes = 0;
+    parg -> case_size = 0;
+    parg -> time_factor = 0;
+    parg -> time_floor = DEFAULT_TIME_FLOOR;
+    parg -> num_of_progs = 0;
+    parg -> std_inx = 0;
+    parg -> progs = NULL;
+    parg -> gen_prog[0] = parg -> checker_prog[0] = 0;
+    parg -> interactor_prog[0] = 0;
+    parg -> store_file[0] = 0;
+    parg -> store = NULL;
+    parg -> pack_file[0] = 0;
+    parg -> pack = NULL;
+    parg -> pack_op = 0;
+    parg -> cmp_opt.mode = CMP_DIFF;
+    parg -> cmp_opt.eps = DEFAULT_EPS;
+    parg -> transcript = 0;
+    parg -> input_file[0] = parg -> output_file[0] = parg -> dump_dir[0] = 0;
+    parg -> case_file[0] = 0;
+    parg -> in_fd = parg -> out_fd = -1;
+    parg -> journaled = 0;
+    parg -> di_in = parg -> di_out = parg -> di_temp = NULL;
+    parg -> sp_inout = NULL;
+    parg -> resp = NULL;
+    parg -> worker_hosts[0] = 0;
+    parg -> worker_host[0] = 0;
+    parg -> worker_port = 0;
+    memset( parg -> phases, 0, sizeof( parg -> phases ) );
+    parg -> judge_ns = 0;
+    parg -> show_phases = 0;
+    parg -> report_file[0] = 0;
+    parg -> report.fp = NULL;
+    parg -> case_hook = NULL;
+    parg -> hook_ctx = NULL;
+    parg -> rt = NULL;
+}
+
+int options_set( struct sys_arg_t* parg, int opt, const char* value )
+{
+    const char* p;
+
+    if ( opt < 256 && strchr( VALUED_OPTIONS, opt ) != NULL ) {
+        if ( value == NULL ) return 0;
+        if ( strlen( value ) + 2 > FILE_NAME_LEN ) {
+            fprintf( stderr, "The value of -%c is too long.\n", opt );
+            return 0;
+        }
+    }
+
+    switch ( opt ) {
+        case 'c':
+            parg -> runs = atoi( value );
+            if ( parg -> runs <= 0 ) parg -> runs = DEFAULT_RUNS;
+            break;
+
+        case 's':
+            parg -> std_inx = atoi( value );
+            break;
+
+        case 'g':
+            SET_PROG_ARG( gen_prog );
+            break;
+
+        case 'I':
+            if ( !parg -> pack_op && is_pack_file( value ) )
+                strncpy( parg -> pack_file, value, FILE_NAME_LEN );
+            else
+                LOAD_DIRECTORY( di_in );
+            break;
+
+        case 'O':
+            LOAD_DIRECTORY( di_out );
+            break;
+
+        case 'H':
+            strncpy( parg -> store_file, value, FILE_NAME_LEN );
+            break;
+
+        case 'P':
+        case 'U':
+            strncpy( parg -> pack_file, value, FILE_NAME_LEN );
+            parg -> pack_op = ( opt == 'P' ? PACK_CREATE : PACK_EXTRACT );
+            break;
+
+        case 'j':
+            SET_PROG_ARG( checker_prog );
+            break;
+
+        case 'm':
+            if ( !parse_compare_mode( value, &parg -> cmp_opt ) ) {
+                fprintf( stderr, "Unknown comparison mode \"%s\"\n", value );
+                return 0;
+            }
+            break;
+
+        case 'i':
+            SET_PROG_ARG( interactor_prog );
+            break;
+
+        case 't':
+            parg -> transcript = 1;
+            break;
+
+        case 'D':
+            strcpy( parg -> dump_dir, value );
+            break;
+
+        case 'v':
+            Verbose_mode = 1;
+            break;
+
+        case 'S':
+            parg -> show_phases = 1;
+            break;
+
+        case 'R':
+            strncpy( parg -> report_file, value, FILE_NAME_LEN );
+            break;
+
+        case 'T':
+            parg -> res_cons.time_limit = atoi( value );
+            break;
+
+        case 'X':
+            if ( sscanf( value, "%lf,%d", &parg -> time_factor,
+                         &parg -> time_floor ) < 1 ||
+                 parg -> time_factor <= 0 || parg -> time_floor < 0 ) {
+                fprintf( stderr, "Invalid relative time limit \"%s\"\n", value );
+                return 0;
+            }
+            break;
+
+        case 'M':
+            parg -> res_cons.mem_limit = atoi( value );
+            break;
+
+        case 'e':
+            parg -> seed = strtoull( value, NULL, 10 );
+            break;
+
+        case 'G':
+            parg -> gen_jobs = atoi( value );
+            if ( parg -> gen_jobs < 1 ) parg -> gen_jobs = 1;
+            break;
+
+        case 'B':
+            parg -> budget = atoi( value );
+            if ( parg -> budget < 0 ) parg -> budget = 0;
+            break;
+
+        case 'Y':
+            if ( !growth_parse( parg, value ) ) {
+                fprintf( stderr, "Invalid sizes \"%s\"\n", value );
+                return 0;
+            }
+            break;
+
+        case 'C':
+            parg -> calib_runs = atoi( value );
+            if ( parg -> calib_runs <= 0 ) parg -> calib_runs = DEFAULT_CALIB_RUNS;
+            break;
+
+        case 'w':
+            parg -> warm = 1;
+            break;
+
+        case 'K':
+            parg -> res_cons.corrected = 1;
+            break;
+
+        case 'Z':
+            parg -> res_cons.isolate = 1;
+            parg -> res_cons.reruns = atoi( value );
+            if ( parg -> res_cons.reruns < 0 ) parg -> res_cons.reruns = 0;
+            break;
+
+        case 'p':
+            parg -> res_cons.isolate = 1;
+            parg -> res_cons.priority = atoi( value );
+            break;
+
+        case 'L':
+            parg -> res_cons.out_limit = atoi( value );
+            if ( parg -> res_cons.out_limit < 0 ) parg -> res_cons.out_limit = 0;
+            break;
+
+        case 'N':
+            strncpy( parg -> worker_hosts, value, FILE_NAME_LEN );
+            break;
+
+        case 'W':
+            // host:port, a port alone is served on the loopback only
+            if ( ( p = strrchr( value, ':' ) ) == NULL ) {
+                strcpy( parg -> worker_host, DEFAULT_WORKER_HOST );
+                p = value;
+            }
+            else if ( p - value > OPTION_LEN ) {
+                fprintf( stderr, "The host of -W is too long.\n" );
+                return 0;
+            }
+            else {
+                memcpy( parg -> worker_host, value, p - value );
+                parg -> worker_host[ p - value ] = 0;
+                ++p;
+            }
+
+            parg -> worker_port = atoi( p );
+            if ( parg -> worker_port <= 0 || parg -> worker_port > 65535 ) {
+                fprintf( stderr, "Invalid port of -W: %s\n", value );
+                return 0;
+            }
+            break;
+
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Pack or unpack the data folders, nothing is tested.
+ */
+static int run_pack_tool( struct sys_arg_t* parg )
+{
+    struct suf_pat_t* psuf = NULL;
+    int num;
+
+    if ( parg -> di_in == NULL ) {
+        fprintf( stderr, "Packing needs the input folder by -I.\n" );
+        return 0;
+    }
+
+    if ( parg -> pack_op == PACK_EXTRACT ) {
+        num = unpack_to_folder( parg -> pack_file, parg -> di_in -> folder_name,
+                                parg -> di_out == NULL ? NULL :
+                                parg -> di_out -> folder_name );
+    }
+    else {
+        if ( parg -> di_out != NULL &&
+             ( psuf = detect_pattern( parg -> di_in -> folder_name,
+                                      parg -> di_out -> folder_name ) ) == NULL ) {
+            fprintf( stderr, "There's no unique mapping pattern between input and output file.\n" );
+            return 0;
+        }
+
+        num = pack_folder( parg -> pack_file, parg -> di_in, parg -> di_out, psuf );
+        close_pattern( psuf );
+    }
+
+    if ( num < 0 ) {
+        fprintf( stderr, "%s %s failed.\n",
+                 parg -> pack_op == PACK_CREATE ? "Pack" : "Unpack", parg -> pack_file );
+        return 0;
+    }
+
+    printf( "%s %d cases.\n", parg -> pack_op == PACK_CREATE ? "Packed" : "Unpacked", num );
+    return 1;
+}
+
+/*
+ * 1. Guess the testing method;
+ * 2. Validate the arguments.
+ */
+int options_prepare( struct sys_arg_t* parg, const char* run, int resume )
+{
+    int i, len;
+    int with_answers;
+
+    // Packing tests nothing, a worker learns its programs from the coordinator
+    if ( parg -> pack_op || parg -> worker_port > 0 ) return 1;
+
+    if ( parg -> num_of_progs == 0 ) {
+        printf( "No program specified. Abort.\n" );
+        return 0;
+    }
+
+    // The seed of a resumed run is the one it had
+    if ( run != NULL ) {
+        if ( !journal_open( parg, TESTER_JOURNAL, run, resume ) ) {
+            fprintf( stderr, "Nothing to resume, %s is missing or is the journal of another run.\n",
+                     TESTER_JOURNAL );
+            return 0;
+        }
+        parg -> journaled = 1;
+    }
+
+    // Check and compile all candidate programs
+    for ( i = 0; i < parg -> num_of_progs; ++i )
+        COMPILE_SOURCE_CODE( parg -> progs[i] );
+
+    // Guess testing mode
+    if ( parg -> checker_prog[0] ) {
+        len = strlen( parg -> checker_prog );
+
+        if ( len > 3 && strcmp( parg -> checker_prog + len - 3, ".so" ) == 0 ) {
+            // Checker plugin, called in process
+            if ( !load_checker_plugin( parg, parg -> checker_prog ) ) {
+                fprintf( stderr, "Load checker %s failed.\n", parg -> checker_prog );
+                return 0;
+            }
+            load_checker( parg, CHECK_BY_PLUGIN );
+        }
+        else {
+            COMPILE_SOURCE_CODE( parg -> checker_prog );
+            load_checker( parg, CHECK_BY_JUDGE );
+        }
+
+        load_res_gen( parg, OOPS );
+    }
+    else {
+        load_checker( parg, parg -> cmp_opt.mode == CMP_DIFF ?
+                      CHECK_BY_COMPARISON : CHECK_BY_TOKENS );
+    }
+
+    if ( file_exist( parg -> gen_prog ) ) {
+        // Get data from generator
+        if ( !( parg -> std_inx >= 0 &&
+                parg -> std_inx < parg -> num_of_progs ) ) {
+            fprintf( stderr, "Warning: Standard program index is out of range.\n" );
+            fprintf( stderr, "Change back to 0.\n" );
+            parg -> std_inx = 0;
+        }
+
+        COMPILE_SOURCE_CODE( parg -> gen_prog );
+
+        // Any run can be repeated by its seed
+        if ( parg -> seed == 0 )
+            parg -> seed = ( (unsigned long long)time( NULL ) << 20 ) ^ getpid();
+        printf( "Seed = %llu\n", parg -> seed );
+
+        load_input( parg, INPUT_BY_GENERATOR );
+        load_res_gen( parg, RESULT_BY_GENERATOR );
+    }
+    else if ( parg -> di_in != NULL ) {
+        // Get data from predefined directory
+        load_input( parg, INPUT_BY_FOLDER );
+
+        if ( parg -> di_out != NULL ) {
+            parg -> sp_inout = detect_pattern( parg -> di_in -> folder_name,
+                                               parg -> di_out -> folder_name );
+            if ( parg -> sp_inout == NULL ) {
+                fprintf( stderr, "There's no unique mapping pattern between input and output file.\n" );
+                fprintf( stderr, "I suggest you should check it before runing test again.\n" );
+                return 0;
+            }
+
+            load_res_gen( parg, RESULT_BY_FOLDER );
+        }
+        else
+            load_res_gen( parg, RESULT_BY_GENERATOR );
+    }
+    else if ( parg -> pack_file[0] ) {
+        // Get data from a test pack
+        if ( ( parg -> pack = open_pack( parg -> pack_file ) ) == NULL ) {
+            fprintf( stderr, "Load pack %s failed.\n", parg -> pack_file );
+            return 0;
+        }
+
+        if ( parg -> worker_hosts[0] ) {
+            fprintf( stderr, "Test packs cannot be spread over workers yet.\n" );
+            return 0;
+        }
+
+        load_input( parg, INPUT_BY_PACK );
+
+        // Answers are packed for all cases or none, open_pack() makes sure
+        if ( parg -> pack -> num > 0 && parg -> pack -> index[0].out_len != -1 )
+            load_res_gen( parg, RESULT_BY_PACK );
+        else
+            load_res_gen( parg, RESULT_BY_GENERATOR );
+    }
+    else
+        return 0;
+
+    with_answers = ( !file_exist( parg -> gen_prog ) &&
+                     ( parg -> di_out != NULL ||
+                       ( parg -> pack != NULL && parg -> pack -> num > 0 &&
+                         parg -> pack -> index[0].out_len != -1 ) ) );
+
+    if ( parg -> interactor_prog[0] ) {
+        if ( parg -> worker_hosts[0] ) {
+            fprintf( stderr, "Interactive problems cannot be spread over workers yet.\n" );
+            return 0;
+        }
+
+        COMPILE_SOURCE_CODE( parg -> interactor_prog );
+
+        // The interactor judges, every program has to talk to it
+        if ( !with_answers )
+            load_res_gen( parg, OOPS );
+    }
+
+    if ( parg -> res_cons.corrected && parg -> calib_runs == 0 )
+        parg -> calib_runs = DEFAULT_CALIB_RUNS;
+
+    if ( parg -> calib_runs > 0 && parg -> worker_hosts[0] ) {
+        fprintf( stderr, "Workers are not calibrated yet, -C and -K work without -N only.\n" );
+        return 0;
+    }
+
+    if ( parg -> store_file[0] ) {
+        if ( ( parg -> di_in == NULL && parg -> pack == NULL ) ||
+             file_exist( parg -> gen_prog ) ||
+             parg -> checker_prog[0] || parg -> interactor_prog[0] ||
+             parg -> worker_hosts[0] ) {
+            fprintf( stderr, "The answer store works with -I only, not with -g, -j, -i or -N.\n" );
+            return 0;
+        }
+
+        if ( access( parg -> store_file, F_OK ) != 0 ) {
+            printf( "Build answer store %s\n", parg -> store_file );
+            if ( !build_answer_store( parg, parg -> store_file ) ) {
+                fprintf( stderr, "Build answer store failed.\n" );
+                return 0;
+            }
+        }
+
+        if ( ( parg -> store = load_store( parg -> store_file ) ) == NULL ) {
+            fprintf( stderr, "Load answer store %s failed.\n", parg -> store_file );
+            return 0;
+        }
+
+        load_res_gen( parg, RESULT_BY_STORE );
+        load_checker( parg, CHECK_BY_STORE );
+    }
+
+    if ( parg -> budget > 0 &&
+         ( phase_of_input( parg ) != PHASE_GENERATOR || parg -> worker_hosts[0] ||
+           parg -> res_cons.isolate ) ) {
+        fprintf( stderr, "The stress test needs a generator (-g), and works without -N, -Z and -p.\n" );
+        return 0;
+    }
+
+    if ( parg -> num_sizes > 0 &&
+         ( phase_of_input( parg ) != PHASE_GENERATOR || parg -> worker_hosts[0] ||
+           parg -> budget > 0 ) ) {
+        fprintf( stderr, "The complexity estimation needs a generator (-g), and works without -N and -B.\n" );
+        return 0;
+    }
+
+    if ( parg -> warm &&
+         ( parg -> interactor_prog[0] || parg -> store != NULL ||
+           parg -> worker_hosts[0] || parg -> budget > 0 ) ) {
+        fprintf( stderr, "Warm runtimes work for batch problems without -i, -H, -N and -B.\n" );
+        return 0;
+    }
+
+    if ( resume &&
+         ( parg -> worker_hosts[0] || parg -> budget > 0 || parg -> num_sizes > 0 ) ) {
+        fprintf( stderr, "Runs with -N, -B or -Y are not journaled, and cannot be resumed.\n" );
+        return 0;
+    }
+
+    if ( parg -> time_factor > 0 &&
+         ( phase_of_result( parg ) != PHASE_REFERENCE || parg -> worker_hosts[0] ) ) {
+        fprintf( stderr, "Relative time limits need the standard program to make the answers, by -g or -I without -O, and no -N.\n" );
+        return 0;
+    }
+
+    return 1;
+}
+
+int options_run( struct sys_arg_t* parg )
+{
+    int ret = 0;
+
+    if ( parg -> pack_op ) return run_pack_tool( parg );
+
+    if ( parg -> res_cons.isolate ) {
+        if ( !isolate_setup( &parg -> res_cons ) )
+            fprintf( stderr, "Warning: no core can be dedicated, programs share CPU %d.\n",
+                     parg -> res_cons.cpu );
+        else if ( Verbose_mode )
+            printf( "Programs are isolated on CPU %d\n", parg -> res_cons.cpu );
+    }
+
+    if ( parg -> calib_runs > 0 && parg -> worker_port == 0 ) {
+        if ( !calibrate_overhead( parg, parg -> calib_runs ) ) {
+            fprintf( stderr, "Calibration failed.\n" );
+            goto stop;
+        }
+
+        printf( "Launch overhead of %d runs: CPU %dus, wall clock %dus\n\n",
+                parg -> calib_runs, parg -> res_cons.cpu_overhead,
+                parg -> res_cons.wall_overhead );
+    }
+
+    if ( parg -> warm && parg -> worker_port == 0 && !warm_start( parg ) )
+        goto stop;
+
+    if ( parg -> report_file[0] && parg -> worker_port == 0 &&
+         !report_open( parg, parg -> report_file ) ) {
+        fprintf( stderr, "Create report %s failed.\n", parg -> report_file );
+        goto stop;
+    }
+
+    // Run supervised judge
+    if ( parg -> worker_port > 0 )
+        ret = worker_serve( parg -> worker_host, parg -> worker_port, parg );
+    else if ( parg -> worker_hosts[0] )
+        ret = dist_judge( parg, parg -> worker_hosts );
+    else if ( parg -> num_sizes > 0 )
+        ret = growth_judge( parg );
+    else if ( parg -> budget > 0 )
+        ret = stress_judge( parg, parg -> budget,
+                            parg -> gen_jobs > 1 ? parg -> gen_jobs : sysconf( _SC_NPROCESSORS_ONLN ) );
+    else
+        ret = judge( parg );
+
+  stop:
+    // Queued links must land before the folder goes
+    if ( parg -> budget > 0 ) stress_stop();
+    if ( parg -> warm ) warm_stop();
+    if ( parg -> journaled ) journal_close();
+
+    return ret;
+}
+
+void options_release( struct sys_arg_t* parg )
+{
+    if ( parg -> di_in != NULL ) close_folder( parg -> di_in );
+    if ( parg -> di_out != NULL ) close_folder( parg -> di_out );
+    if ( parg -> sp_inout != NULL ) close_pattern( parg -> sp_inout );
+    if ( parg -> store != NULL ) close_store( parg -> store );
+    if ( parg -> pack != NULL ) close_pack( parg -> pack );
+
+    // Opened by options_prepare() for a run that failed to start
+    if ( parg -> journaled ) journal_close();
+
+    // An unfinished report is kept as it is
+    if ( parg -> report.fp != NULL ) fclose( parg -> report.fp );
+
+    parg -> di_in = parg -> di_out = NULL;
+    parg -> sp_inout = NULL;
+    parg -> store = NULL;
+    parg -> pack = NULL;
+    parg -> report.fp = NULL;
+    parg -> journaled = 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * The options of tester on a judge context: setting them one by one, checking
+ * them together and running what they ask for.
+ * tester hands its command line to a job of libojtester, which comes here.
+ * By richardxx, 2009.6
+ */
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "type_def.h"
+
+// The defaults of tester
+extern
+void options_init( struct sys_arg_t* );
+
+/*
+ * Set option Arg2, the letter of tester -h, to Arg3 (NULL for an option taking no value).
+ * Folders and growth sizes are loaded at once.
+ * Return 0 if Arg2 is unknown or Arg3 is invalid, the reason is printed.
+ */
+extern
+int options_set( struct sys_arg_t*, int, const char* );
+
+/*
+ * Check the options together, compile the programs, the generator and the checker,
+ * and pick the strategies; the scratch folder and the runtime are already open.
+ * The cases are journaled under the run name Arg2 unless it is NULL, Arg3 resumes
+ * the journal of the same run.
+ * Return 0 if they make no run, the reason is printed.
+ */
+extern
+int options_prepare( struct sys_arg_t*, const char*, int );
+
+/*
+ * Do what the options ask for: pack, serve as a worker, or judge in one of the ways.
+ * Return 0 if it failed.
+ */
+extern
+int options_run( struct sys_arg_t* );
+
+/*
+ * Release what the options have loaded,
+ * the runtime and the scratch folder are left to the caller.
+ */
+extern
+void options_release( struct sys_arg_t* );
+
+#endif
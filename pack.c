@@ -0,0 +1,378 @@
+/*
+ * Building, checking and extracting test packs.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "consts.h"
+#include "runtime.h"
+#include "pack.h"
+
+#define CHUNK_SIZE		65536
+
+/*
+ * A case found in the folders while packing.
+ */
+struct pack_item_t
+{
+    char *in_path, *out_path;
+    char *name, *out_name;
+};
+
+int is_pack_file( const char* fname )
+{
+    char magic[ PACK_MAGIC_LEN ];
+    struct stat st;
+    int fd, ret;
+
+    if ( stat( fname, &st ) == -1 || !S_ISREG( st.st_mode ) ) return 0;
+    if ( ( fd = open( fname, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+
+    ret = ( read( fd, magic, PACK_MAGIC_LEN ) == PACK_MAGIC_LEN &&
+            memcmp( magic, PACK_MAGIC, PACK_MAGIC_LEN ) == 0 );
+
+    close( fd );
+    return ret;
+}
+
+static int valid_range( const struct pack_t* pp, long long off, long long len )
+{
+    return off >= 0 && len >= 0 && off <= pp -> len && len <= pp -> len - off;
+}
+
+struct pack_t* open_pack( const char* fname )
+{
+    const struct pack_header_t* ph;
+    const struct pack_entry_t* pe;
+    struct pack_t* pp;
+    struct stat st;
+    long long head;
+    void* p;
+    int i;
+
+    if ( ( pp = ( struct pack_t* )malloc( sizeof( struct pack_t ) ) ) == NULL )
+        return NULL;
+
+    pp -> map = NULL;
+    if ( ( pp -> fd = open( fname, O_RDONLY | O_CLOEXEC ) ) == -1 ||
+         fstat( pp -> fd, &st ) == -1 ||
+         st.st_size < (long long)sizeof( struct pack_header_t ) ) goto error_code;
+
+    p = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, pp -> fd, 0 );
+    if ( p == MAP_FAILED ) goto error_code;
+
+    pp -> map = (const char*)p;
+    pp -> len = st.st_size;
+    ph = ( const struct pack_header_t* )pp -> map;
+
+    if ( memcmp( ph -> magic, PACK_MAGIC, PACK_MAGIC_LEN ) != 0 ||
+         ph -> num < 0 || ph -> names_len < 0 ) goto error_code;
+
+    head = sizeof( struct pack_header_t ) +
+        (long long)ph -> num * sizeof( struct pack_entry_t );
+    if ( !valid_range( pp, head, ph -> names_len ) ) goto error_code;
+
+    pp -> num = ph -> num;
+    pp -> cur = 0;
+    pp -> index = ( const struct pack_entry_t* )( ph + 1 );
+    pp -> names = pp -> map + head;
+
+    if ( ph -> names_len > 0 && pp -> names[ ph -> names_len - 1 ] != 0 )
+        goto error_code;
+
+    /*
+     * Every name and every piece of data must lie in the pack,
+     * and either every case has an answer or none has.
+     */
+    for ( i = 0; i < pp -> num; ++i ) {
+        pe = pp -> index + i;
+        if ( pe -> name_off < 0 || pe -> name_off >= ph -> names_len ||
+             pe -> out_name_off < 0 || pe -> out_name_off >= ph -> names_len ||
+             ( pe -> out_len == -1 ) != ( pp -> index[0].out_len == -1 ) ||
+             !valid_range( pp, pe -> in_off, pe -> in_len ) ||
+             ( pe -> out_len != -1 &&
+               !valid_range( pp, pe -> out_off, pe -> out_len ) ) ) {
+#ifdef DEBUG
+            fprintf( stderr, "Broken entry %d in pack %s.\n", i, fname );
+#endif
+            goto error_code;
+        }
+    }
+
+    return pp;
+
+  error_code:
+    close_pack( pp );
+    return NULL;
+}
+
+void close_pack( struct pack_t* pp )
+{
+    if ( pp == NULL ) return;
+
+    if ( pp -> map != NULL ) munmap( (void*)pp -> map, pp -> len );
+    if ( pp -> fd != -1 ) close( pp -> fd );
+    free( pp );
+}
+
+static int cmp_item( const void* a, const void* b )
+{
+    return strcmp( ( (const struct pack_item_t*)a ) -> name,
+                   ( (const struct pack_item_t*)b ) -> name );
+}
+
+// The plain base name of a data file
+static char* plain_name( const char* path )
+{
+    const char* base;
+    char* name;
+
+    base = strrchr( path, '/' );
+    base = ( base == NULL ? path : base + 1 );
+
+    if ( ( name = strdup( base ) ) != NULL )
+        name[ strip_compression( name ) ] = 0;
+
+    return name;
+}
+
+static void release_items( struct pack_item_t* items, int num )
+{
+    int i;
+
+    for ( i = 0; i < num; ++i ) {
+        free( items[i].in_path );
+        free( items[i].out_path );
+        free( items[i].name );
+        free( items[i].out_name );
+    }
+    free( items );
+}
+
+// Whether all Arg3 bytes are written, a short write is a failure too
+static int write_whole( int fd, const void* buf, size_t len )
+{
+    return len == 0 || write( fd, buf, len ) == (ssize_t)len;
+}
+
+/*
+ * Append a data file to the pack, digesting it on the way.
+ * Return the length written, -1 if failed.
+ */
+static long long
+append_data( int fd_pack, const char* fname, unsigned char* digest )
+{
+    char path[ FILE_NAME_LEN + 1 ], buf[ CHUNK_SIZE ];
+    struct hash_ctx_t h;
+    long long len = 0;
+    int fd, fd_mem = -1, ret;
+
+    if ( !stage_file( fname, fname, path, &fd_mem ) ) return -1;
+
+    if ( ( fd = open( path, O_RDONLY | O_CLOEXEC ) ) == -1 ) {
+        unstage_file( &fd_mem );
+        return -1;
+    }
+
+    hash_init( &h );
+    while ( ( ret = read( fd, buf, CHUNK_SIZE ) ) > 0 ) {
+        if ( write( fd_pack, buf, ret ) != ret ) {
+            ret = -1;
+            break;
+        }
+        hash_update( &h, buf, ret );
+        len += ret;
+    }
+    hash_final( &h, digest );
+
+    close( fd );
+    unstage_file( &fd_mem );
+
+    return ret < 0 ? -1 : len;
+}
+
+int pack_folder( const char* fpack, struct dir_info_t* di_in,
+                 struct dir_info_t* di_out, const struct suf_pat_t* psuf )
+{
+    struct pack_header_t header;
+    struct pack_entry_t* index = NULL;
+    struct pack_item_t *items = NULL, *pi;
+    char path[ FILE_NAME_LEN + 1 ], fout[ FILE_NAME_LEN + 1 ];
+    long long off;
+    int num = 0, cap = 0, names_len = 0, answered = 0;
+    int i, fd = -1, ok = 0;
+
+    // Find the cases first, the data goes behind the index
+    while ( get_next_file( di_in, path ) ) {
+        if ( num == cap ) {
+            cap = ( cap == 0 ? 256 : cap * 2 );
+            pi = ( struct pack_item_t* )realloc( items,
+                                                 cap * sizeof( struct pack_item_t ) );
+            if ( pi == NULL ) goto release_code;
+            items = pi;
+        }
+
+        pi = items + num++;
+        memset( pi, 0, sizeof( struct pack_item_t ) );
+
+        if ( ( pi -> in_path = strdup( path ) ) == NULL ||
+             ( pi -> name = plain_name( path ) ) == NULL ) goto release_code;
+
+        if ( di_out != NULL &&
+             map_file( psuf, di_out -> folder_name, path, fout ) ) {
+            if ( access( fout, F_OK ) == 0 &&
+                 ( ( pi -> out_path = strdup( fout ) ) == NULL ||
+                   ( pi -> out_name = plain_name( fout ) ) == NULL ) )
+                goto release_code;
+        }
+
+        names_len += strlen( pi -> name ) + 1;
+        if ( pi -> out_name != NULL ) {
+            names_len += strlen( pi -> out_name ) + 1;
+            ++answered;
+        }
+    }
+    reopen_folder( di_in );
+
+    // A pack answers all of its cases or none
+    if ( answered > 0 && answered < num ) {
+        fprintf( stderr, "Only %d of %d cases have answers, pack all of them or none.\n",
+                 answered, num );
+        goto release_code;
+    }
+
+    qsort( items, num, sizeof( struct pack_item_t ), cmp_item );
+
+    if ( num > 0 &&
+         ( index = ( struct pack_entry_t* )calloc( num,
+                                                   sizeof( struct pack_entry_t ) ) ) == NULL )
+        goto release_code;
+
+    if ( ( fd = open( fpack, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR ) ) == -1 )
+        goto release_code;
+
+    off = sizeof( struct pack_header_t ) +
+        (long long)num * sizeof( struct pack_entry_t ) + names_len;
+    if ( lseek( fd, off, SEEK_SET ) == -1 ) goto release_code;
+
+    for ( i = 0, names_len = 0; i < num; ++i ) {
+        pi = items + i;
+
+        index[i].name_off = names_len;
+        names_len += strlen( pi -> name ) + 1;
+
+        index[i].in_off = off;
+        if ( ( index[i].in_len = append_data( fd, pi -> in_path,
+                                              index[i].in_hash ) ) == -1 ) {
+            fprintf( stderr, "Pack %s failed.\n", pi -> in_path );
+            goto release_code;
+        }
+        off += index[i].in_len;
+
+        // A case without answer has an empty output name
+        index[i].out_name_off = names_len - 1;
+        index[i].out_len = -1;
+
+        if ( pi -> out_path != NULL ) {
+            index[i].out_name_off = names_len;
+            names_len += strlen( pi -> out_name ) + 1;
+
+            index[i].out_off = off;
+            if ( ( index[i].out_len = append_data( fd, pi -> out_path,
+                                                   index[i].out_hash ) ) == -1 ) {
+                fprintf( stderr, "Pack %s failed.\n", pi -> out_path );
+                goto release_code;
+            }
+            off += index[i].out_len;
+        }
+    }
+
+    // Now the head
+    memcpy( header.magic, PACK_MAGIC, PACK_MAGIC_LEN );
+    header.num = num;
+    header.names_len = names_len;
+
+    if ( lseek( fd, 0, SEEK_SET ) == -1 ||
+         !write_whole( fd, &header, sizeof( header ) ) ||
+         !write_whole( fd, index, num * sizeof( struct pack_entry_t ) ) ) goto release_code;
+
+    for ( i = 0; i < num; ++i ) {
+        if ( !write_whole( fd, items[i].name, strlen( items[i].name ) + 1 ) ||
+             ( items[i].out_name != NULL &&
+               !write_whole( fd, items[i].out_name, strlen( items[i].out_name ) + 1 ) ) )
+            goto release_code;
+    }
+
+    ok = 1;
+
+  release_code:
+    if ( fd != -1 && close( fd ) == -1 ) ok = 0;
+    free( index );
+    release_items( items, num );
+
+    return ok ? num : -1;
+}
+
+// Write a piece of the pack out, if its digest checks
+static int
+extract_data( const char* data, long long len, const unsigned char* digest,
+              const char* folder, const char* name )
+{
+    char path[ FILE_NAME_LEN + 1 ];
+    unsigned char got[ HASH_LEN ];
+    struct hash_ctx_t h;
+    long long done;
+    int fd, ret;
+
+    hash_init( &h );
+    hash_update( &h, data, len );
+    hash_final( &h, got );
+
+    if ( memcmp( got, digest, HASH_LEN ) != 0 ) {
+        fprintf( stderr, "Digest of %s mismatches, the pack is broken.\n", name );
+        return 0;
+    }
+
+    // Names never lead out of the folder
+    if ( name[0] == 0 || strchr( name, '/' ) != NULL ) return 0;
+
+    sprintf( path, "%s/%s", folder, name );
+    if ( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR ) ) == -1 )
+        return 0;
+
+    for ( done = 0; done < len; done += ret )
+        if ( ( ret = write( fd, data + done, len - done ) ) <= 0 ) break;
+
+    return close( fd ) == 0 && done == len;
+}
+
+int unpack_to_folder( const char* fpack, const char* in_dir, const char* out_dir )
+{
+    const struct pack_entry_t* pe;
+    struct pack_t* pp;
+    int i, ok = 1;
+
+    if ( ( pp = open_pack( fpack ) ) == NULL ) return -1;
+
+    for ( i = 0; ok && i < pp -> num; ++i ) {
+        pe = pp -> index + i;
+
+        ok = extract_data( pp -> map + pe -> in_off, pe -> in_len, pe -> in_hash,
+                           in_dir, PACK_NAME( pp, pe ) );
+
+        if ( ok && out_dir != NULL && pe -> out_len != -1 )
+            ok = extract_data( pp -> map + pe -> out_off, pe -> out_len,
+                               pe -> out_hash, out_dir, PACK_OUT_NAME( pp, pe ) );
+    }
+
+    i = pp -> num;
+    close_pack( pp );
+
+    return ok ? i : -1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Test packs: a whole suite in one file, mapped and served without
+ * touching a file per case.
+ * Layout, integers in host byte order:
+ *   header  struct pack_header_t
+ *   index   num entries of struct pack_entry_t, sorted by name
+ *   names   NUL terminated input and output names
+ *   data    inputs and outputs concatenated
+ * By richardxx, 2009.6
+ */
+
+#ifndef PACK_H
+#define PACK_H
+
+#include "hash.h"
+#include "file.h"
+
+#define PACK_MAGIC		"TSTPACK1"
+#define PACK_MAGIC_LEN	8
+
+// Pack tool operations
+#define PACK_CREATE		1
+#define PACK_EXTRACT	2
+
+struct pack_header_t
+{
+    char magic[ PACK_MAGIC_LEN ];
+    int num;
+    int names_len;
+};
+
+/*
+ * One case, offsets count from the beginning of the pack.
+ * out_len is -1 if the case has no answer.
+ */
+struct pack_entry_t
+{
+    long long in_off, in_len;
+    long long out_off, out_len;
+    int name_off, out_name_off;
+    unsigned char in_hash[ HASH_LEN ];
+    unsigned char out_hash[ HASH_LEN ];
+};
+
+/*
+ * An opened pack, cur is the next case to serve.
+ */
+struct pack_t
+{
+    int fd;
+    const char* map;
+    long long len;
+    int num, cur;
+    const struct pack_entry_t* index;
+    const char* names;
+};
+
+/*
+ * Tell if Arg1 is a pack rather than a folder.
+ * Return 1 if so.
+ */
+extern int is_pack_file( const char* );
+
+/*
+ * Map a pack and check its index, the answers must be packed for all cases or none.
+ * Return NULL if failed.
+ */
+extern struct pack_t* open_pack( const char* );
+
+extern void close_pack( struct pack_t* );
+
+/* Name of an entry's input and output */
+#define PACK_NAME( pp, pe )		( (pp) -> names + (pe) -> name_off )
+#define PACK_OUT_NAME( pp, pe )	( (pp) -> names + (pe) -> out_name_off )
+
+/*
+ * Pack the input folder Arg2, and the answers found in Arg3 by Arg4 if given;
+ * every case must have its answer then.
+ * Compressed files are stored decompressed.
+ * Return the number of cases, -1 if failed.
+ */
+extern int pack_folder( const char*, struct dir_info_t*,
+                        struct dir_info_t*, const struct suf_pat_t* );
+
+/*
+ * Extract a pack, inputs into folder Arg2 and answers into Arg3 (if not NULL).
+ * Every file is checked against its digest.
+ * Return the number of cases, -1 if failed.
+ */
+extern int unpack_to_folder( const char*, const char*, const char* );
+
+#endif
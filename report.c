@@ -0,0 +1,333 @@
+/*
+ * Phase timing and the JSON report.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "consts.h"
+#include "type_def.h"
+#include "report.h"
+#include "warm.h"
+
+const char* phase_name[] = { "generator",
+                             "reference",
+                             "staging",
+                             "programs",
+                             "check",
+                             "cleanup" };
+
+long long phase_clock()
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void phase_add( struct sys_arg_t* parg, int phase, long long start )
+{
+    ++parg -> phases[ phase ].count;
+    parg -> phases[ phase ].ns += phase_clock() - start;
+}
+
+void print_phases( struct sys_arg_t* parg )
+{
+    long long rest = parg -> judge_ns;
+    double all = ( parg -> judge_ns > 0 ? parg -> judge_ns : 1 );
+    int i;
+
+    printf( "Phases:\n" );
+    printf( "%-10s %10s %12s %12s %7s\n", "Phase", "Count", "Total(ms)", "Ave.(us)", "Share" );
+
+    for ( i = 0; i < NUM_PHASES; ++i ) {
+        const struct phase_stat_t* ps = parg -> phases + i;
+
+        rest -= ps -> ns;
+        if ( ps -> count == 0 ) continue;
+
+        printf( "%-10s %10lld %12.3f %12.1f %6.1f%%\n", phase_name[i],
+                ps -> count, ps -> ns / 1e6, ps -> ns / 1e3 / ps -> count,
+                ps -> ns * 100.0 / all );
+    }
+
+    // Printing verdicts and the loop itself
+    if ( rest < 0 ) rest = 0;
+    printf( "%-10s %10s %12.3f %12s %6.1f%%\n", "other", "-",
+            rest / 1e6, "-", rest * 100.0 / all );
+    printf( "%-10s %10s %12.3f\n", "total", "-", parg -> judge_ns / 1e6 );
+}
+
+void stat_init( struct prog_stat_t* ps, int calibrated )
+{
+    memset( ps, 0, sizeof( struct prog_stat_t ) );
+    ps -> corrected = ( calibrated ? 0 : -1 );
+}
+
+static int bucket_of( long long us )
+{
+    int e, b;
+
+    if ( us < 16 ) return us < 0 ? 0 : us;
+
+    for ( e = 4; ( us >> ( e + 1 ) ) > 0; ++e );
+    b = 16 + ( e - 4 ) * 8 + ( ( us >> ( e - 3 ) ) & 7 );
+
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+// The largest time falling into bucket b
+static long long bucket_top( int b )
+{
+    int e;
+
+    if ( b < 16 ) return b;
+
+    e = ( b - 16 ) / 8 + 4;
+    return ( ( 8LL + ( b - 16 ) % 8 + 1 ) << ( e - 3 ) ) - 1;
+}
+
+void stat_add( struct prog_stat_t* ps, long long us, int corrected, int mem,
+               const struct RESUSE* resp, int id, const char* name )
+{
+    int i, n;
+
+    ++ps -> runs;
+    ps -> time_us += us;
+    ps -> mem_kb += mem;
+    if ( ps -> corrected >= 0 && corrected >= 0 ) ps -> corrected += corrected;
+
+    if ( resp != NULL ) {
+        resuse_add( &ps -> total, (struct RESUSE*)resp );
+        ++ps -> detailed;
+    }
+
+    if ( us > ps -> max_us ) ps -> max_us = us;
+    ++ps -> hist[ bucket_of( us ) ];
+
+    // Keep the slowest ones in descending order, n of them are kept so far
+    n = ( ps -> runs - 1 < SLOWEST_CASES ? ps -> runs - 1 : SLOWEST_CASES );
+    for ( i = n; i > 0 && ps -> slowest[ i - 1 ].us < us; --i )
+        if ( i < SLOWEST_CASES ) ps -> slowest[i] = ps -> slowest[ i - 1 ];
+
+    if ( i < SLOWEST_CASES ) {
+        ps -> slowest[i].us = us;
+        ps -> slowest[i].id = id;
+        if ( name != NULL ) snprintf( ps -> slowest[i].name, SLOW_NAME_LEN, "%s", name );
+        else snprintf( ps -> slowest[i].name, SLOW_NAME_LEN, "#%d", id );
+    }
+}
+
+long long stat_percentile( const struct prog_stat_t* ps, double p )
+{
+    long long need, cnt = 0;
+    int b;
+
+    if ( ps -> runs == 0 ) return 0;
+
+    need = (long long)( p * ps -> runs + 0.999999 );
+    if ( need < 1 ) need = 1;
+
+    for ( b = 0; b < HIST_BUCKETS; ++b )
+        if ( ( cnt += ps -> hist[b] ) >= need ) break;
+
+    return b < HIST_BUCKETS && bucket_top( b ) < ps -> max_us ? bucket_top( b ) : ps -> max_us;
+}
+
+void print_stat( int id, const struct prog_stat_t* ps )
+{
+    const struct rusage* ru = &ps -> total.ru;
+    int i, n;
+
+    if ( ps -> runs == 0 ) return;
+
+    printf( "Prog %5d: Runs = %d, p50 = %.3fms, p90 = %.3fms, p99 = %.3fms, Max = %.3fms\n",
+            id, ps -> runs, stat_percentile( ps, 0.5 ) / 1e3, stat_percentile( ps, 0.9 ) / 1e3,
+            stat_percentile( ps, 0.99 ) / 1e3, ps -> max_us / 1e3 );
+
+    if ( ps -> detailed > 0 )
+        printf( "            User = %.3fms, System = %.3fms, Peak RSS = %ldKB, "
+                "Switches = %ld/%ld, Block I/O = %ld/%ld\n",
+                ru -> ru_utime.tv_sec * 1e3 + ru -> ru_utime.tv_usec / 1e3,
+                ru -> ru_stime.tv_sec * 1e3 + ru -> ru_stime.tv_usec / 1e3,
+                ru -> ru_maxrss, ru -> ru_nvcsw, ru -> ru_nivcsw,
+                ru -> ru_inblock, ru -> ru_oublock );
+
+    n = ( ps -> runs < SLOWEST_CASES ? ps -> runs : SLOWEST_CASES );
+    printf( "            Slowest:" );
+    for ( i = 0; i < n; ++i )
+        printf( "%s %s (%.3fms)", i ? "," : "", ps -> slowest[i].name,
+                ps -> slowest[i].us / 1e3 );
+    putchar( '\n' );
+}
+
+// A JSON string, names are the only strings we don't make ourselves
+static void json_string( FILE* fp, const char* s )
+{
+    fputc( '"', fp );
+
+    for ( ; *s; ++s ) {
+        if ( *s == '"' || *s == '\\' ) fprintf( fp, "\\%c", *s );
+        else if ( (unsigned char)*s < 0x20 ) fprintf( fp, "\\u%04x", *s );
+        else fputc( *s, fp );
+    }
+
+    fputc( '"', fp );
+}
+
+int report_open( struct sys_arg_t* parg, const char* fname )
+{
+    FILE* fp;
+    int i;
+
+    if ( ( fp = fopen( fname, "we" ) ) == NULL ) return 0;
+
+    parg -> report.fp = fp;
+    parg -> report.cases = 0;
+
+    fprintf( fp, "{\n\"version\": " );
+    json_string( fp, VERSION );
+
+    fprintf( fp, ",\n\"programs\": [" );
+    for ( i = 0; i < parg -> num_of_progs; ++i ) {
+        if ( i > 0 ) fputc( ',', fp );
+        json_string( fp, parg -> progs[i] );
+    }
+
+    fprintf( fp, "]" );
+
+    // Startup of the warm runtimes, not in any time of the cases
+    if ( parg -> warm ) {
+        fprintf( fp, ",\n\"startup_us\": [" );
+        for ( i = 0; i < parg -> num_of_progs; ++i ) {
+            if ( i > 0 ) fputc( ',', fp );
+            if ( warm_startup( i ) < 0 ) fprintf( fp, "null" );
+            else fprintf( fp, "%lld", warm_startup( i ) );
+        }
+        fputc( ']', fp );
+    }
+
+    fprintf( fp, ",\n\"time_limit_ms\": %d, \"memory_limit_kb\": %d, \"output_limit_kb\": %d",
+             parg -> res_cons.time_limit, parg -> res_cons.mem_limit,
+             parg -> res_cons.out_limit );
+    if ( parg -> time_factor > 0 )
+        fprintf( fp, ",\n\"time_factor\": %g, \"time_floor_ms\": %d",
+                 parg -> time_factor, parg -> time_floor );
+    if ( parg -> calib_runs > 0 )
+        fprintf( fp, ",\n\"calibration\": {\"runs\": %d, \"cpu_overhead_us\": %d, "
+                 "\"wall_overhead_us\": %d, \"limits_corrected\": %s}",
+                 parg -> calib_runs, parg -> res_cons.cpu_overhead,
+                 parg -> res_cons.wall_overhead, parg -> res_cons.corrected ? "true" : "false" );
+
+    fprintf( fp, ",\n\"cases\": [" );
+
+    return 1;
+}
+
+void report_case( struct sys_arg_t* parg, int id, const char* name )
+{
+    FILE* fp = parg -> report.fp;
+
+    if ( fp == NULL ) return;
+
+    fprintf( fp, "%s\n  {\"id\": %d, \"name\": ", parg -> report.cases++ ? "," : "", id );
+    if ( name != NULL ) json_string( fp, name );
+    else fprintf( fp, "null, \"seed\": \"%llu\"", parg -> case_seed );
+    if ( parg -> time_factor > 0 )
+        fprintf( fp, ", \"time_limit_ms\": %d", parg -> case_cons.time_limit );
+    fprintf( fp, ", \"results\": [" );
+
+    parg -> report.results = 0;
+}
+
+void report_result( struct sys_arg_t* parg, int id, int res,
+                    int use_time, int corrected, int mem, long long out,
+                    const struct RESUSE* resp )
+{
+    FILE* fp = parg -> report.fp;
+
+    if ( fp == NULL ) return;
+
+    fprintf( fp, "%s\n    {\"prog\": %d, \"result\": ", parg -> report.results++ ? "," : "", id );
+    json_string( fp, pres_text[ res ] );
+    fprintf( fp, ", \"time_ms\": %d", use_time );
+    if ( corrected >= 0 ) fprintf( fp, ", \"corrected_time_ms\": %d", corrected );
+    fprintf( fp, ", \"memory_kb\": %d, \"output_bytes\": %lld", mem, out );
+
+    if ( resp != NULL )
+        fprintf( fp, ", \"user_us\": %lld, \"system_us\": %lld, \"peak_rss_kb\": %ld, "
+                 "\"voluntary_switches\": %ld, \"involuntary_switches\": %ld, "
+                 "\"blocks_in\": %ld, \"blocks_out\": %ld",
+                 time_used_us( (struct RESUSE*)resp ),
+                 resp -> ru.ru_stime.tv_sec * 1000000LL + resp -> ru.ru_stime.tv_usec,
+                 resp -> ru.ru_maxrss, resp -> ru.ru_nvcsw, resp -> ru.ru_nivcsw,
+                 resp -> ru.ru_inblock, resp -> ru.ru_oublock );
+
+    if ( resp != NULL && parg -> res_cons.isolate )
+        fprintf( fp, ", \"reruns\": %d, \"noisy\": %s", resp -> reruns,
+                 resp -> noisy ? "true" : "false" );
+    fputc( '}', fp );
+}
+
+void report_case_end( struct sys_arg_t* parg )
+{
+    if ( parg -> report.fp != NULL ) fprintf( parg -> report.fp, "]}" );
+}
+
+void report_close( struct sys_arg_t* parg, const struct prog_stat_t* stats )
+{
+    FILE* fp = parg -> report.fp;
+    const struct prog_stat_t* ps;
+    const struct rusage* ru;
+    int i, j, n;
+
+    if ( fp == NULL ) return;
+
+    fprintf( fp, "\n],\n\"summary\": [" );
+    for ( i = 0; i < parg -> num_of_progs; ++i ) {
+        ps = stats + i;
+        n = ( ps -> runs > 0 ? ps -> runs : 1 );
+
+        fprintf( fp, "%s\n  {\"prog\": %d, \"runs\": %d, \"total_time_ms\": %lld, "
+                 "\"average_time_ms\": %lld, ", i ? "," : "", i, ps -> runs,
+                 ps -> time_us / 1000, ps -> time_us / 1000 / n );
+        if ( ps -> corrected >= 0 )
+            fprintf( fp, "\"total_corrected_ms\": %lld, \"average_corrected_ms\": %lld, ",
+                     ps -> corrected, ps -> corrected / n );
+        fprintf( fp, "\"average_memory_kb\": %lld,\n   ", ps -> mem_kb / n );
+
+        fprintf( fp, "\"p50_us\": %lld, \"p90_us\": %lld, \"p99_us\": %lld, \"max_us\": %lld",
+                 stat_percentile( ps, 0.5 ), stat_percentile( ps, 0.9 ),
+                 stat_percentile( ps, 0.99 ), ps -> max_us );
+
+        if ( ps -> detailed > 0 ) {
+            ru = &ps -> total.ru;
+            fprintf( fp, ",\n   \"user_us\": %lld, \"system_us\": %lld, \"peak_rss_kb\": %ld, "
+                     "\"voluntary_switches\": %ld, \"involuntary_switches\": %ld, "
+                     "\"blocks_in\": %ld, \"blocks_out\": %ld",
+                     ru -> ru_utime.tv_sec * 1000000LL + ru -> ru_utime.tv_usec,
+                     ru -> ru_stime.tv_sec * 1000000LL + ru -> ru_stime.tv_usec,
+                     ru -> ru_maxrss, ru -> ru_nvcsw, ru -> ru_nivcsw,
+                     ru -> ru_inblock, ru -> ru_oublock );
+        }
+
+        fprintf( fp, ",\n   \"slowest\": [" );
+        for ( j = 0; j < ps -> runs && j < SLOWEST_CASES; ++j ) {
+            fprintf( fp, "%s{\"id\": %d, \"name\": ", j ? ", " : "", ps -> slowest[j].id );
+            json_string( fp, ps -> slowest[j].name );
+            fprintf( fp, ", \"time_us\": %lld}", ps -> slowest[j].us );
+        }
+        fprintf( fp, "]}" );
+    }
+
+    fprintf( fp, "\n],\n\"phases\": {" );
+    for ( i = 0; i < NUM_PHASES; ++i )
+        fprintf( fp, "%s\n  \"%s\": {\"count\": %lld, \"total_ms\": %.3f}", i ? "," : "",
+                 phase_name[i], parg -> phases[i].count, parg -> phases[i].ns / 1e6 );
+
+    fprintf( fp, "\n},\n\"judge_ms\": %.3f\n}\n", parg -> judge_ns / 1e6 );
+
+    fclose( fp );
+    parg -> report.fp = NULL;
+}
@@ -0,0 +1,134 @@
+/*
+ * Where the time of a run goes, and the structured report of a run.
+ * Every case is timed phase by phase: making the input, getting the answer,
+ * staging data files, running the programs, checking and cleaning up.
+ * The report is a JSON file written while the cases are judged.
+ * By richardxx, 2009.6
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include "libprocs.h"
+
+#define PHASE_GENERATOR		0	// running the data generator
+#define PHASE_REFERENCE		1	// running the standard program
+#define PHASE_STAGING		2	// serving inputs and answers from folders, packs, stores
+#define PHASE_PROGRAMS		3	// running the tested programs
+#define PHASE_CHECK			4	// comparing outputs, special judges
+#define PHASE_CLEANUP		5	// dumping and removing intermediate data
+#define NUM_PHASES			6
+
+struct phase_stat_t
+{
+    long long count;
+    long long ns;
+};
+
+struct report_t
+{
+    FILE* fp;
+    int cases, results;
+};
+
+/*
+ * Latency histogram of a program in microseconds: exact below 16us,
+ * then 8 buckets per power of 2, so a percentile is off by 12.5% at most.
+ */
+#define HIST_BUCKETS		488
+#define SLOWEST_CASES		5
+#define SLOW_NAME_LEN		64
+
+struct slow_case_t
+{
+    long long us;
+    int id;
+    char name[ SLOW_NAME_LEN ];
+};
+
+/*
+ * One program over the cases it ran.
+ * Resource details are known for the runs on this host only, see detailed.
+ */
+struct prog_stat_t
+{
+    int runs, detailed;
+    long long time_us, mem_kb;
+    long long corrected;                // ms, -1 if not calibrated
+    struct RESUSE total;                // detailed runs added up by resuse_add()
+    long long max_us;
+    long long hist[ HIST_BUCKETS ];
+    struct slow_case_t slowest[ SLOWEST_CASES ];
+};
+
+struct sys_arg_t;
+
+extern const char* phase_name[];
+
+/*
+ * Monotonic clock in nanoseconds, to start a phase with.
+ */
+extern long long phase_clock();
+
+/*
+ * Count one phase Arg2 of Arg1, started at Arg3 by phase_clock().
+ */
+extern void phase_add( struct sys_arg_t*, int, long long );
+
+/*
+ * Print the phases as a table, with their share of the judging time.
+ */
+extern void print_phases( struct sys_arg_t* );
+
+/*
+ * Start the statistics of a program, Arg2 tells if times are corrected.
+ */
+extern void stat_init( struct prog_stat_t*, int );
+
+/*
+ * Add a run: time in us, corrected time in ms, memory in KB,
+ * the full resource usage (NULL if unknown), case number and name (NULL if generated).
+ */
+extern void stat_add( struct prog_stat_t*, long long, int, int,
+                      const struct RESUSE*, int, const char* );
+
+/*
+ * Time in us that Arg2 (0 to 1) of the runs didn't exceed.
+ */
+extern long long stat_percentile( const struct prog_stat_t*, double );
+
+/*
+ * Print what the summary line doesn't tell: resources, percentiles and the slowest cases.
+ */
+extern void print_stat( int, const struct prog_stat_t* );
+
+/*
+ * Create the report file Arg2 and write the scenario.
+ * Return 0 if failed.
+ */
+extern int report_open( struct sys_arg_t*, const char* );
+
+/*
+ * Add a case to the report, Arg2 is its number and Arg3 its name (NULL for a generated one,
+ * its seed is given instead).
+ * Then call report_result() for every program and report_case_end().
+ */
+extern void report_case( struct sys_arg_t*, int, const char* );
+
+/*
+ * Result of a program: id, result code, time and corrected time (-1 if not calibrated) in ms,
+ * memory in KB and output in bytes.
+ * Arg9 adds the details of the run if not NULL.
+ */
+extern void report_result( struct sys_arg_t*, int, int, int, int, int, long long,
+                           const struct RESUSE* );
+
+extern void report_case_end( struct sys_arg_t* );
+
+/*
+ * Finish the report with the statistics of each program, the phases and the judging time.
+ */
+extern void report_close( struct sys_arg_t*, const struct prog_stat_t* );
+
+#endif
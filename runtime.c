@@ -3,28 +3,88 @@
  * By richardxx, 2009.2
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "consts.h"
 #include "libprocs.h"
+#include "libsys.h"
+#include "checker.h"
+#include "compare.h"
+#include "store.h"
+#include "pack.h"
+#include "uring.h"
+#include "warm.h"
 #include "runtime.h"
 
 #define TRY_TIME		5
 #define DEFAULT_INPUT_NAME	"input_data.txt"
 #define DEFAULT_OUTPUT_NAME "output_data.txt"
 
+// Larger outputs are mapped when compared, not read ahead
+#define PREFETCH_LIMIT		( 64 << 20 )
 
-static char tmp_str1[ FILE_NAME_LEN + 1 ];
-static char tmp_str2[ FILE_NAME_LEN + 1 ];
-static char pcmd[ FILE_NAME_LEN * 3 + 256 ];
-static int answer_from_user_program;
 
-// Global
-FP_NEXT_INPUT get_next_input = NULL;
-FP_STD_RES    get_standard_result = NULL;
-FP_CHK_RES    check_result = NULL;
+// Generated cases made ahead, case k in slot k % gen_jobs
+struct gen_slot_t
+{
+    pid_t pid;
+    unsigned long long seed;
+    char file[ FILE_NAME_LEN + 1 ];
+};
+
+// Outputs read ahead of their comparison, by program
+struct prefetch_t
+{
+    char path[ FILE_NAME_LEN + 1 ];
+    char* buf;
+    long long len, done;
+    int fd;
+};
+
+/*
+ * Everything a judge keeps between cases, owned by its sys_arg_t.
+ * Judges with their own contexts share nothing here.
+ */
+struct runtime_t
+{
+    // Loaded strategies
+    FP_NEXT_INPUT next_input, skip_input;
+    FP_STD_RES std_result;
+    FP_CHK_RES checker;
+    int answer_from_user_program;
+
+    // Timing phases of the loaded input and answer strategies
+    int input_phase, result_phase;
+
+    // Answer of the current case and digest of the last output, in store mode
+    const struct answer_t* cur_answer;
+    struct answer_t last_output;
+
+    // Loaded checker plugin
+    void* checker_handle;
+    FP_CHECKER_CHECK checker_check;
+    FP_CHECKER_FINI checker_fini;
+
+    struct gen_slot_t* gen_pool;
+    int gen_slots, gen_started, gen_taken;
+
+    // Asynchronous file work, the ring is opened on first use
+    struct uring_t* ring;
+    int ring_tried;
+
+    struct prefetch_t* prefetched;
+    int num_prefetched;
+};
 
 /* Info dumping files.
    Enable them throughout the controlling macros.
@@ -34,91 +94,292 @@ FP_CHK_RES    check_result = NULL;
 #endif
 
 
+static struct uring_t* get_ring( struct runtime_t* rt )
+{
+    if ( !rt -> ring_tried ) {
+        rt -> ring_tried = 1;
+        rt -> ring = uring_open( URING_ENTRIES );
+    }
+
+    return rt -> ring;
+}
+
+/*
+ * Link a data file into the temporary folder, so it is dumped with the case.
+ * A compressed file is linked as it is.
+ * The link is queued, wait_io() tells if it failed.
+ */
+static int link_to_temp( struct sys_arg_t* parg, const char* fname, const char* name )
+{
+    char src[ FILE_NAME_LEN + 1 ], dest[ FILE_NAME_LEN + 1 ];
+    
+    // Nobody looks at the temporary folder unless it is dumped
+    if ( !parg -> dump_dir[0] ) return 1;
+    
+    sprintf( src,
+             fname[0] == '/' ? "%s" : "../%s",
+             fname );
+
+    sprintf( dest, "%s/%s",
+             parg -> di_temp -> folder_name, name );
+
+    if ( !uring_link_file( get_ring( parg -> rt ), src, dest ) ) {
+#ifdef DEBUG
+                fprintf( stderr, "Link to %s failed.\n", fname );
+#endif
+                return 0;
+    }
+
+    return 1;
+}
+
 static int
 get_input_from_folder( struct sys_arg_t* parg )
 {
+    // Links of the last case must be done before they are replaced
+    wait_io( parg );
+    
     // Read a file
-    if ( !get_next_file( parg -> di_in, parg -> input_file ) )
+    if ( !get_next_file( parg -> di_in, parg -> case_file ) )
+        return 0;
+
+    if ( !stage_file( parg -> case_file, parg -> case_file,
+                      parg -> input_file, &(parg -> in_fd) ) ) {
+        fprintf( stderr, "Decompress %s failed.\n", parg -> case_file );
+        return 0;
+    }
+    
+    if ( !link_to_temp( parg, parg -> case_file, DEFAULT_INPUT_NAME ) )
         return 0;
     
-    // Create a link from tmp_str2 to tmp_str1
-    sprintf( tmp_str1,
-             parg -> input_file[0] == '/' ? "%s" : "../%s",
-             parg -> input_file );
+    ++parg -> passed_cases;
+    return 1;
+}
 
-    sprintf( tmp_str2, "%s/%s",
-             parg -> di_temp -> folder_name, DEFAULT_INPUT_NAME );
+/*
+ * Put a piece of the mapped pack into the memory file *Arg4, created on first use.
+ * The data is also written to the temporary folder if it may be dumped.
+ */
+static int
+serve_data( struct sys_arg_t* parg, const char* data, long long len,
+            int* pfd, char* path, const char* name )
+{
+    char dest[ FILE_NAME_LEN + 1 ];
+    long long done;
+    int ret, fd;
 
-    unlink( tmp_str2 );
+    if ( *pfd == -1 &&
+         ( *pfd = memfd_create( "tester_data", MFD_CLOEXEC ) ) == -1 ) return 0;
     
-    if ( symlink( tmp_str1, tmp_str2 ) == -1 &&
-         link( tmp_str1, tmp_str2 ) == -1 &&
-         !file_copy( tmp_str1, tmp_str2 ) ) {
+    if ( ftruncate( *pfd, 0 ) == -1 ) return 0;
+
+    for ( done = 0; done < len; done += ret )
+        if ( ( ret = pwrite( *pfd, data + done, len - done, done ) ) <= 0 )
+            return 0;
+
+    sprintf( path, "/proc/%d/fd/%d", getpid(), *pfd );
+
+    if ( parg -> dump_dir[0] ) {
+        sprintf( dest, "%s/%s", parg -> di_temp -> folder_name, name );
+        unlink( dest );
+        
+        if ( ( fd = open( dest, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR ) ) != -1 ) {
+            for ( done = 0; done < len; done += ret )
+                if ( ( ret = write( fd, data + done, len - done ) ) <= 0 ) break;
+            close( fd );
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Cases come from the mapped pack, without opening any file.
+ */
+static int
+get_input_from_pack( struct sys_arg_t* parg )
+{
+    const struct pack_entry_t* pe;
+    struct pack_t* pp = parg -> pack;
+
+    if ( pp -> cur >= pp -> num ) return 0;
+    pe = pp -> index + pp -> cur++;
+
+    strcpy( parg -> case_file, PACK_NAME( pp, pe ) );
+    
+    if ( !serve_data( parg, pp -> map + pe -> in_off, pe -> in_len,
+                      &(parg -> in_fd), parg -> input_file, DEFAULT_INPUT_NAME ) ) {
 #ifdef DEBUG
-                fprintf( stderr, "Link to %s failed.\n",
-                         parg -> input_file );
+        fprintf( stderr, "Serve %s failed.\n", parg -> case_file );
 #endif
-                return 0;
+        return 0;
     }
-    
+
     ++parg -> passed_cases;
     return 1;
 }
 
+/*
+ * Seed of case Arg2, well mixed so near seeds give unrelated cases (splitmix64).
+ */
+static unsigned long long seed_of( unsigned long long base, int index )
+{
+    unsigned long long z = base + index * 0x9e3779b97f4a7c15ULL;
+
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
+}
+
+// Number of the k-th generated case
+static int case_number( struct sys_arg_t* parg, int k )
+{
+    return parg -> case_first + ( k - 1 ) * parg -> case_step;
+}
+
+// Start generating the k-th case into its slot
+static int start_generator( struct sys_arg_t* parg, int k )
+{
+    struct gen_slot_t* ps = parg -> rt -> gen_pool + k % parg -> gen_jobs;
+    char *argv[5], sseed[24], sindex[16], ssize[24];
+    int index = case_number( parg, k );
+
+    ps -> seed = seed_of( parg -> seed, index );
+    sprintf( ps -> file, "%s/gen%d_%s",
+             parg -> di_temp -> folder_name, k % parg -> gen_jobs, DEFAULT_INPUT_NAME );
+    sprintf( sseed, "%llu", ps -> seed );
+    sprintf( sindex, "%d", index );
+    sprintf( ssize, "%lld", parg -> case_size );
+
+    argv[0] = parg -> gen_prog;
+    argv[1] = sseed;
+    argv[2] = sindex;
+    argv[3] = ( parg -> case_size > 0 ? ssize : NULL );
+    argv[4] = NULL;
+    
+    ps -> pid = start_program( argv[0], NULL, ps -> file, argv );
+    return ps -> pid != -1;
+}
+
+/*
+ * The generator is given the seed and number of the case.
+ * With several generators, the following cases are made while this one is judged;
+ * a single generator is a pool of one, started when its case is wanted.
+ */
 static int
 get_input_from_generator( struct sys_arg_t* parg )
 {
-    char* argv[2];
-    int ret;
+    struct runtime_t* rt = parg -> rt;
+    struct gen_slot_t* ps;
+    int i, ret, k, ahead;
     
     if ( parg -> runs-- <= 0 ) return 0;
+    k = ++rt -> gen_taken;
     
     sprintf( parg -> input_file, "%s/%s",
              parg -> di_temp -> folder_name, DEFAULT_INPUT_NAME );
+    strcpy( parg -> case_file, parg -> input_file );
 
-    argv[0] = parg -> gen_prog;
-    argv[1] = NULL;
-
-    if ( run_program( argv[0], NULL, parg -> input_file, "/dev/null",
-                      NULL, NULL, &ret, argv ) == RES_NORMAL ) {
-        ++parg -> passed_cases;
-        return 1;
+    if ( rt -> gen_pool == NULL ) {
+        rt -> gen_pool = ( struct gen_slot_t* )malloc( parg -> gen_jobs *
+                                                       sizeof( struct gen_slot_t ) );
+        if ( rt -> gen_pool == NULL ) return 0;
+        
+        rt -> gen_slots = parg -> gen_jobs;
+        for ( i = 0; i < rt -> gen_slots; ++i ) rt -> gen_pool[i].pid = -1;
+        rt -> gen_started = k - 1;
     }
 
-    return 0;
+    // Keep the pool full, but don't go beyond the last case
+    ahead = ( parg -> runs < parg -> gen_jobs - 1 ? parg -> runs : parg -> gen_jobs - 1 );
+    while ( rt -> gen_started < k + ahead )
+        if ( !start_generator( parg, ++rt -> gen_started ) ) {
+            --rt -> gen_started;
+            break;
+        }
+
+    if ( rt -> gen_started < k ) return 0;
+    
+    ps = rt -> gen_pool + k % parg -> gen_jobs;
+    while ( waitpid( ps -> pid, &ret, 0 ) == -1 && errno == EINTR );
+    ps -> pid = -1;
+
+    if ( !WIFEXITED( ret ) ||
+         rename( ps -> file, parg -> input_file ) == -1 ) return 0;
+
+    parg -> case_seed = ps -> seed;
+    ++parg -> passed_cases;
+    return 1;
+}
+
+/*
+ * Skip a case without making its input, the case file and seed are still known.
+ */
+static int
+skip_input_from_folder( struct sys_arg_t* parg )
+{
+    if ( !get_next_file( parg -> di_in, parg -> case_file ) ) return 0;
+
+    ++parg -> passed_cases;
+    return 1;
+}
+
+static int
+skip_input_from_pack( struct sys_arg_t* parg )
+{
+    struct pack_t* pp = parg -> pack;
+
+    if ( pp -> cur >= pp -> num ) return 0;
+    strcpy( parg -> case_file, PACK_NAME( pp, pp -> index + pp -> cur++ ) );
+
+    ++parg -> passed_cases;
+    return 1;
+}
+
+static int
+skip_input_from_generator( struct sys_arg_t* parg )
+{
+    if ( parg -> runs-- <= 0 ) return 0;
+
+    parg -> case_seed = seed_of( parg -> seed, case_number( parg, ++parg -> rt -> gen_taken ) );
+    ++parg -> passed_cases;
+    return 1;
 }
 
 static int
 get_result_from_folder( struct sys_arg_t* parg )
 {
+    char fout[ FILE_NAME_LEN + 1 ];
+    
     /*
      * The output file name is generated from observed suffix mapping pattern.
      * Then we look up if this particular file exists.
      */
     if ( !map_file( parg -> sp_inout, parg -> di_out -> folder_name,
-                    parg -> input_file, parg -> output_file ) ) return 0;
+                    parg -> case_file, fout ) ) return 0;
 
-    // Create a symbolic link from tmp_str2 to tmp_str1
-    sprintf( tmp_str1,
-             parg -> output_file[0] == '/' ? "%s" : "../%s",
-             parg -> output_file );
+    if ( !stage_file( fout, fout, parg -> output_file, &(parg -> out_fd) ) ) {
+        fprintf( stderr, "Decompress %s failed.\n", fout );
+        return 0;
+    }
 
-    sprintf( tmp_str2, "%s/%s",
-             parg -> di_temp -> folder_name, DEFAULT_OUTPUT_NAME );
-    
-    unlink( tmp_str2 );
-    
-    if ( symlink( tmp_str1, tmp_str2 ) == -1 &&
-         link( tmp_str1, tmp_str2 ) == -1 &&
-         !file_copy( tmp_str1, tmp_str2 ) ) {
-#ifdef DEBUG
-        fprintf( stderr, "Link to %s failed.\n",
-                 parg -> input_file );
-#endif
+    return link_to_temp( parg, fout, DEFAULT_OUTPUT_NAME );
+}
+
+static int
+get_result_from_pack( struct sys_arg_t* parg )
+{
+    const struct pack_entry_t* pe;
+    struct pack_t* pp = parg -> pack;
+
+    pe = pp -> index + pp -> cur - 1;
+    if ( pe -> out_len == -1 ) {
+        fprintf( stderr, "No answer of %s in the pack.\n", parg -> case_file );
         return 0;
     }
-    
-    return 1;
+
+    return serve_data( parg, pp -> map + pe -> out_off, pe -> out_len,
+                       &(parg -> out_fd), parg -> output_file, DEFAULT_OUTPUT_NAME );
 }
 
 static int
@@ -133,6 +394,10 @@ get_result_from_specified_program( struct sys_arg_t* parg )
     argv[0] = parg -> progs[ parg -> std_inx ];
     argv[1] = NULL;
 
+    ret = warm_run( parg -> std_inx, parg -> input_file, parg -> output_file,
+                    &(parg -> res_cons), parg -> resp[ parg -> std_inx ] );
+    if ( ret != -1 ) return ret == RES_NORMAL;
+
     if ( run_program( argv[0],  parg -> input_file,
                       parg -> output_file, NULL,
                       &(parg -> res_cons), parg -> resp[ parg -> std_inx],
@@ -145,6 +410,40 @@ get_result_from_specified_program( struct sys_arg_t* parg )
     return ret;
 }
 
+/*
+ * The name of the case, a compressed input is known by its plain name.
+ */
+void case_name( struct sys_arg_t* parg, char* name )
+{
+    const char* base;
+
+    base = strrchr( parg -> case_file, '/' );
+    base = ( base == NULL ? parg -> case_file : base + 1 );
+
+    strcpy( name, base );
+    name[ strip_compression( name ) ] = 0;
+}
+
+/*
+ * Look up the digest of the answer by the input's name.
+ */
+static int
+get_result_from_store( struct sys_arg_t* parg )
+{
+    char base[ FILE_NAME_LEN + 1 ];
+
+    case_name( parg, base );
+    
+    if ( ( parg -> rt -> cur_answer = store_find( parg -> store, base ) ) == NULL ) {
+#ifdef DEBUG
+        fprintf( stderr, "No answer of %s in the store.\n", base );
+#endif
+        return 0;
+    }
+
+    return 1;
+}
+
 /*
  * By Linux command 'diff'
  */
@@ -193,25 +492,217 @@ check_result_by_comparison( struct sys_arg_t* parg,
 
 /*
  * Send request to special judge program.
+ * Its exit code is the result.
  */
 static
 int check_result_by_checker( struct sys_arg_t* parg,
                              char* output )
 {
     char *argv[4];
-    int ret, status;
+    int ret;
     
     argv[0] = parg -> checker_prog;
     argv[1] = parg -> input_file;
     argv[2] = output;
     argv[3] = NULL;
 
-    if ( ( status =
-           run_program( argv[0], NULL, "/dev/null", "/dev/null",
-                        NULL, NULL, &ret, argv ) ) != RES_NORMAL )
+    if ( run_program( argv[0], NULL, "/dev/null", "/dev/null",
+                      NULL, NULL, &ret, argv ) != RES_NORMAL )
+        return RES_VE;
+
+    ret = WEXITSTATUS( ret );
+    if ( ret != RES_AC && ret != RES_WA && ret != RES_PE )
         return RES_VE;
     
-    return status;
+    return ret;
+}
+
+/*
+ * Map a file for the checker plugin.
+ * An empty or missing file is given as an empty view.
+ */
+static int open_view( const char* fname, struct checker_view_t* pv )
+{
+    struct stat st;
+    void* p;
+
+    pv -> fd = -1;
+    pv -> data = "";
+    pv -> len = 0;
+
+    if ( fname == NULL || fname[0] == 0 ||
+         ( pv -> fd = open( fname, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+
+    if ( fstat( pv -> fd, &st ) == -1 ) {
+        close( pv -> fd );
+        pv -> fd = -1;
+        return 0;
+    }
+
+    if ( st.st_size > 0 ) {
+        p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, pv -> fd, 0 );
+        if ( p == MAP_FAILED ) {
+            close( pv -> fd );
+            pv -> fd = -1;
+            return 0;
+        }
+        pv -> data = (const char*)p;
+        pv -> len = st.st_size;
+    }
+
+    return 1;
+}
+
+static void close_view( struct checker_view_t* pv )
+{
+    if ( pv -> len > 0 ) munmap( (void*)pv -> data, pv -> len );
+    if ( pv -> fd != -1 ) close( pv -> fd );
+}
+
+/*
+ * Call the loaded checker plugin directly.
+ */
+static
+int check_result_by_plugin( struct sys_arg_t* parg,
+                            char* output )
+{
+    struct checker_view_t vin, vstd, vout;
+    int res;
+
+    if ( !open_view( parg -> input_file, &vin ) ||
+         !open_view( output, &vout ) ) {
+        close_view( &vin );
+        return RES_VE;
+    }
+
+    open_view( parg -> output_file, &vstd );
+
+    res = parg -> rt -> checker_check( &vin, &vstd, &vout );
+    if ( res != RES_AC && res != RES_WA && res != RES_PE )
+        res = RES_VE;
+
+    close_view( &vin );
+    close_view( &vstd );
+    close_view( &vout );
+
+    return res;
+}
+
+static void drop_prefetch( struct prefetch_t* pp )
+{
+    if ( pp -> buf != NULL ) free( pp -> buf );
+    if ( pp -> fd != -1 ) close( pp -> fd );
+    pp -> buf = NULL;
+    pp -> fd = -1;
+    pp -> path[0] = 0;
+}
+
+static struct prefetch_t* find_prefetch( struct runtime_t* rt, const char* output )
+{
+    int i;
+
+    for ( i = 0; i < rt -> num_prefetched; ++i )
+        if ( rt -> prefetched[i].buf != NULL &&
+             strcmp( rt -> prefetched[i].path, output ) == 0 )
+            return rt -> prefetched + i;
+
+    return NULL;
+}
+
+/*
+ * Built-in comparators, see compare.h.
+ * An output read ahead is compared from memory.
+ */
+static
+int check_result_by_tokens( struct sys_arg_t* parg,
+                            char* output )
+{
+    struct checker_view_t vstd, vout;
+    struct prefetch_t* pp;
+    int res;
+
+    if ( ( pp = find_prefetch( parg -> rt, output ) ) != NULL ) {
+        wait_io( parg );
+        
+        if ( pp -> done == pp -> len ) {
+            if ( !open_view( parg -> output_file, &vstd ) ) {
+                drop_prefetch( pp );
+                return RES_VE;
+            }
+            
+            res = compare_buffers( vstd.data, vstd.len, pp -> buf, pp -> len,
+                                   &(parg -> cmp_opt) );
+            close_view( &vstd );
+            drop_prefetch( pp );
+            return res;
+        }
+
+        // Read failed, try the usual way
+        drop_prefetch( pp );
+    }
+
+    if ( !open_view( parg -> output_file, &vstd ) ||
+         !open_view( output, &vout ) ) {
+        close_view( &vstd );
+        return RES_VE;
+    }
+
+    res = compare_buffers( vstd.data, vstd.len, vout.data, vout.len,
+                           &(parg -> cmp_opt) );
+
+    close_view( &vstd );
+    close_view( &vout );
+
+    return res;
+}
+
+/*
+ * The output has been digested while it was produced.
+ */
+static
+int check_result_by_store( struct sys_arg_t* parg,
+                           char* output )
+{
+    return store_check( parg -> rt -> cur_answer, &(parg -> rt -> last_output) );
+}
+
+void unstage_file( int* pfd )
+{
+    if ( *pfd != -1 ) close( *pfd );
+    *pfd = -1;
+}
+
+int stage_file( const char* fname, const char* fmt, char* path, int* pfd )
+{
+    const char* prog;
+    char* argv[3];
+    int ret;
+
+    unstage_file( pfd );
+    
+    if ( ( prog = get_decompressor( fmt ) ) == NULL ) {
+        if ( path != fname ) strcpy( path, fname );
+        return 1;
+    }
+
+    if ( ( *pfd = memfd_create( "tester_data", MFD_CLOEXEC ) ) == -1 )
+        return 0;
+
+    // Named through the owner, so child processes can open it as well
+    sprintf( path, "/proc/%d/fd/%d", getpid(), *pfd );
+
+    argv[0] = (char*)prog;
+    argv[1] = "-dc";
+    argv[2] = NULL;
+
+    if ( run_program( argv[0], fname, path, "/dev/null",
+                      NULL, NULL, &ret, argv ) != RES_NORMAL ||
+         !WIFEXITED( ret ) || WEXITSTATUS( ret ) != 0 ) {
+        unstage_file( pfd );
+        return 0;
+    }
+
+    return 1;
 }
 
 static int nop( struct sys_arg_t* parg )
@@ -224,31 +715,413 @@ static int nop( struct sys_arg_t* parg )
  */
 
 
-void load_input( int mode )
+int runtime_open( struct sys_arg_t* parg )
 {
-    get_next_input = ( mode == INPUT_BY_GENERATOR ?
-                       get_input_from_generator :
-                       get_input_from_folder );
+    struct runtime_t* rt;
+
+    if ( ( rt = ( struct runtime_t* )calloc( 1, sizeof( struct runtime_t ) ) ) == NULL )
+        return 0;
+
+    rt -> input_phase = rt -> result_phase = PHASE_STAGING;
+    parg -> rt = rt;
+    return 1;
 }
 
-void load_res_gen( int mode )
+void runtime_close( struct sys_arg_t* parg )
 {
+    if ( parg -> rt == NULL ) return;
+
+    close_input( parg );
+    close_io( parg );
+    unload_checker_plugin( parg );
+
+    free( parg -> rt );
+    parg -> rt = NULL;
+}
+
+int get_next_input( struct sys_arg_t* parg )
+{
+    return parg -> rt -> next_input( parg );
+}
+
+int skip_next_input( struct sys_arg_t* parg )
+{
+    return parg -> rt -> skip_input( parg );
+}
+
+int get_standard_result( struct sys_arg_t* parg )
+{
+    return parg -> rt -> std_result( parg );
+}
+
+int check_result( struct sys_arg_t* parg, char* output )
+{
+    return parg -> rt -> checker( parg, output );
+}
+
+void load_input( struct sys_arg_t* parg, int mode )
+{
+    struct runtime_t* rt = parg -> rt;
+    
+    rt -> next_input = ( mode == INPUT_BY_GENERATOR ?
+                         get_input_from_generator :
+                         mode == INPUT_BY_PACK ? get_input_from_pack :
+                         get_input_from_folder );
+    rt -> skip_input = ( mode == INPUT_BY_GENERATOR ?
+                         skip_input_from_generator :
+                         mode == INPUT_BY_PACK ? skip_input_from_pack :
+                         skip_input_from_folder );
+    rt -> input_phase = ( mode == INPUT_BY_GENERATOR ? PHASE_GENERATOR : PHASE_STAGING );
+}
+
+void load_res_gen( struct sys_arg_t* parg, int mode )
+{
+    struct runtime_t* rt = parg -> rt;
+    
     if ( mode == RESULT_BY_GENERATOR ) {
-        get_standard_result = get_result_from_specified_program;
-        answer_from_user_program = 1;
+        rt -> std_result = get_result_from_specified_program;
+        rt -> answer_from_user_program = 1;
     }
     else {
-        get_standard_result = ( mode == OOPS ? nop :
-                                get_result_from_folder );
-        answer_from_user_program = 0;
+        rt -> std_result = ( mode == OOPS ? nop :
+                             mode == RESULT_BY_STORE ? get_result_from_store :
+                             mode == RESULT_BY_PACK ? get_result_from_pack :
+                             get_result_from_folder );
+        rt -> answer_from_user_program = 0;
     }
+
+    rt -> result_phase = ( mode == RESULT_BY_GENERATOR ? PHASE_REFERENCE : PHASE_STAGING );
 }
 
-void load_checker( int mode )
+/*
+ * The output is read in the background while the next program runs.
+ */
+int prefetch_output( struct sys_arg_t* parg, int inx, const char* output )
 {
-    check_result = ( mode == CHECK_BY_COMPARISON ?
-                     check_result_by_comparison :
-                     check_result_by_checker );
+    struct runtime_t* rt = parg -> rt;
+    struct prefetch_t* pp;
+    struct stat st;
+    int i;
+
+    if ( rt -> checker != check_result_by_tokens ||
+         get_ring( rt ) == NULL ) return 0;
+
+    if ( inx >= rt -> num_prefetched ) {
+        pp = ( struct prefetch_t* )realloc( rt -> prefetched,
+                                            ( inx + 1 ) * sizeof( struct prefetch_t ) );
+        if ( pp == NULL ) return 0;
+        
+        rt -> prefetched = pp;
+        for ( i = rt -> num_prefetched; i <= inx; ++i ) {
+            pp[i].buf = NULL;
+            pp[i].fd = -1;
+            pp[i].path[0] = 0;
+        }
+        rt -> num_prefetched = inx + 1;
+    }
+
+    // A read never compared may still be in flight
+    pp = rt -> prefetched + inx;
+    if ( pp -> buf != NULL ) wait_io( parg );
+    drop_prefetch( pp );
+
+    if ( ( pp -> fd = open( output, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+    
+    if ( fstat( pp -> fd, &st ) == -1 ||
+         st.st_size > PREFETCH_LIMIT ||
+         ( pp -> buf = ( char* )malloc( st.st_size + 1 ) ) == NULL ) {
+        drop_prefetch( pp );
+        return 0;
+    }
+
+    strcpy( pp -> path, output );
+    pp -> len = st.st_size;
+    uring_read( rt -> ring, pp -> fd, pp -> buf, pp -> len, &(pp -> done) );
+    uring_submit( rt -> ring );
+    
+    return 1;
+}
+
+void close_input( struct sys_arg_t* parg )
+{
+    struct runtime_t* rt = parg -> rt;
+    int i;
+
+    if ( rt -> gen_pool == NULL ) return;
+
+    // Cases made ahead but never judged
+    for ( i = 0; i < rt -> gen_slots; ++i )
+        if ( rt -> gen_pool[i].pid != -1 ) {
+            kill( rt -> gen_pool[i].pid, SIGKILL );
+            while ( waitpid( rt -> gen_pool[i].pid, NULL, 0 ) == -1 && errno == EINTR );
+            unlink( rt -> gen_pool[i].file );
+        }
+
+    free( rt -> gen_pool );
+    rt -> gen_pool = NULL;
+    rt -> gen_slots = rt -> gen_started = rt -> gen_taken = 0;
+}
+
+int wait_io( struct sys_arg_t* parg )
+{
+    int failed = uring_wait( parg -> rt -> ring );
+
+#ifdef DEBUG
+    if ( failed > 0 )
+        fprintf( stderr, "%d file operations failed.\n", failed );
+#endif
+
+    return failed == 0;
+}
+
+void close_io( struct sys_arg_t* parg )
+{
+    struct runtime_t* rt = parg -> rt;
+    int i;
+
+    uring_close( rt -> ring );
+    rt -> ring = NULL;
+    rt -> ring_tried = 0;
+
+    for ( i = 0; i < rt -> num_prefetched; ++i ) drop_prefetch( rt -> prefetched + i );
+    free( rt -> prefetched );
+    rt -> prefetched = NULL;
+    rt -> num_prefetched = 0;
+}
+
+int phase_of_input( struct sys_arg_t* parg )
+{
+    return parg -> rt -> input_phase;
+}
+
+int phase_of_result( struct sys_arg_t* parg )
+{
+    return parg -> rt -> result_phase;
+}
+
+void load_checker( struct sys_arg_t* parg, int mode )
+{
+    struct runtime_t* rt = parg -> rt;
+    
+    if ( mode == CHECK_BY_PLUGIN )
+        rt -> checker = check_result_by_plugin;
+    else if ( mode == CHECK_BY_TOKENS )
+        rt -> checker = check_result_by_tokens;
+    else if ( mode == CHECK_BY_STORE )
+        rt -> checker = check_result_by_store;
+    else
+        rt -> checker = ( mode == CHECK_BY_COMPARISON ?
+                          check_result_by_comparison :
+                          check_result_by_checker );
+}
+
+int load_checker_plugin( struct sys_arg_t* parg, const char* path )
+{
+    struct runtime_t* rt = parg -> rt;
+    FP_CHECKER_INIT init;
+    void* handle;
+    
+    if ( ( handle = dlopen( path, RTLD_NOW | RTLD_LOCAL ) ) == NULL )
+        return 0;
+
+    if ( dlsym( handle, CHECKER_CHECK_SYM ) == NULL ) {
+        dlclose( handle );
+        return 0;
+    }
+
+    init = ( FP_CHECKER_INIT )dlsym( handle, CHECKER_INIT_SYM );
+    if ( init != NULL && init() != 0 ) {
+#ifdef DEBUG
+        fprintf( stderr, "Checker %s failed to initialize.\n", path );
+#endif
+        dlclose( handle );
+        return 0;
+    }
+
+    unload_checker_plugin( parg );
+    
+    rt -> checker_handle = handle;
+    rt -> checker_check = ( FP_CHECKER_CHECK )dlsym( handle, CHECKER_CHECK_SYM );
+    rt -> checker_fini = ( FP_CHECKER_FINI )dlsym( handle, CHECKER_FINI_SYM );
+
+    return 1;
+}
+
+void unload_checker_plugin( struct sys_arg_t* parg )
+{
+    struct runtime_t* rt = parg -> rt;
+    
+    if ( rt == NULL || rt -> checker_handle == NULL ) return;
+
+    if ( rt -> checker_fini != NULL ) rt -> checker_fini();
+    dlclose( rt -> checker_handle );
+    
+    rt -> checker_handle = NULL;
+    rt -> checker_check = NULL;
+    rt -> checker_fini = NULL;
+}
+
+struct stream_ctx_t
+{
+    struct answer_hash_t h;
+    int fd;
+};
+
+static int stream_to_hash( void* ctx, const char* buf, int len )
+{
+    struct stream_ctx_t* pc = ( struct stream_ctx_t* )ctx;
+
+    answer_hash_update( &pc -> h, buf, len );
+    if ( pc -> fd != -1 ) write( pc -> fd, buf, len );
+    return len;
+}
+
+/*
+ * Digest the output as it streams.
+ * It is only written to the output file if it is going to be dumped.
+ */
+static int
+run_program_hashed( int inx, const char* output, struct sys_arg_t* parg )
+{
+    struct stream_ctx_t ctx;
+    int ret;
+
+    ctx.fd = ( parg -> dump_dir[0] ?
+               open( output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR ) :
+               -1 );
+    answer_hash_init( &ctx.h );
+
+    ret = run_program_sink( parg -> progs[inx], parg -> input_file, NULL,
+                            &(parg -> case_cons), parg -> resp[inx],
+                            NULL, NULL, stream_to_hash, &ctx );
+
+    answer_hash_final( &ctx.h, &(parg -> rt -> last_output) );
+    if ( ctx.fd != -1 ) close( ctx.fd );
+
+    return ret;
+}
+
+/*
+ * Build the answer store by the loaded strategies.
+ */
+int build_answer_store( struct sys_arg_t* parg, const char* fname )
+{
+    struct answer_store_t* ps;
+    char base[ FILE_NAME_LEN + 1 ];
+    int ok = 1;
+
+    if ( ( ps = create_store() ) == NULL ) return 0;
+
+    while ( ok && get_next_input( parg ) ) {
+        case_name( parg, base );
+        
+        ok = get_standard_result( parg ) &&
+            store_add( ps, base, parg -> output_file );
+    }
+
+    ok = ok && save_store( ps, fname );
+    close_store( ps );
+
+    // Start over
+    if ( parg -> pack != NULL ) parg -> pack -> cur = 0;
+    else reopen_folder( parg -> di_in );
+    parg -> passed_cases = 0;
+    
+    return ok;
+}
+
+static int cmp_ll( const void* a, const void* b )
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return x < y ? -1 : ( x > y );
+}
+
+/*
+ * Time a program that does nothing, compiled as the tested ones are.
+ * The CPU overhead is the mean, since a short run is charged to user or
+ * system time by ticks; the wall clock one is the median, to resist preemption.
+ * It runs isolated as the tested programs do, without their limits.
+ */
+int calibrate_overhead( struct sys_arg_t* parg, int runs )
+{
+    char src[ FILE_NAME_LEN + 1 ], bin[ FILE_NAME_LEN + 1 ], *argv[2];
+    long long *wall, cpu = 0, t;
+    struct RESCONS rc;
+    struct RESUSE ru;
+    FILE* fp;
+    int i, ret, ok = 1;
+
+    sprintf( src, "%s/null_prog.c", parg -> di_temp -> folder_name );
+    if ( ( fp = fopen( src, "we" ) ) == NULL ) return 0;
+    fprintf( fp, "int main() { return 0; }\n" );
+    fclose( fp );
+
+    ok = compile( src );
+    unlink( src );
+    if ( !ok || ( wall = ( long long* )malloc( runs * sizeof( long long ) ) ) == NULL )
+        return 0;
+
+    sprintf( bin, "%s/null_prog", parg -> di_temp -> folder_name );
+    argv[0] = bin;
+    argv[1] = NULL;
+
+    memset( &rc, 0, sizeof( rc ) );
+    rc.time_limit = DEFAULT_WAIT_TIME;
+    rc.mem_limit = DEFAULT_MEMORY_SIZE;
+    rc.isolate = parg -> res_cons.isolate;
+    rc.cpu = parg -> res_cons.cpu;
+    rc.priority = parg -> res_cons.priority;
+
+    for ( i = 0; ok && i < runs; ++i ) {
+        t = phase_clock();
+        ok = ( run_program( argv[0], "/dev/null", "/dev/null", "/dev/null",
+                            &rc, &ru, &ret, argv ) == RES_NORMAL );
+        wall[i] = ( phase_clock() - t ) / 1000;
+        cpu += time_used_us( &ru );
+    }
+
+    if ( ok ) {
+        qsort( wall, runs, sizeof( long long ), cmp_ll );
+        parg -> res_cons.cpu_overhead = cpu / runs;
+        parg -> res_cons.wall_overhead = wall[ runs / 2 ];
+    }
+
+    unlink( bin );
+    free( wall );
+    return ok;
+}
+
+/*
+ * Talk to the interactor, its exit code is the result.
+ * The output file receives the transcript if asked for.
+ */
+static int
+run_interactive_program( int inx, const char* output, struct sys_arg_t* parg )
+{
+    char *argv[2], *iargv[4];
+    int ret, status, res;
+
+    argv[0] = parg -> progs[inx];
+    argv[1] = NULL;
+
+    iargv[0] = parg -> interactor_prog;
+    iargv[1] = parg -> input_file;
+    iargv[2] = ( parg -> output_file[0] ? parg -> output_file : "/dev/null" );
+    iargv[3] = NULL;
+
+    ret = run_interactive( argv[0], argv, iargv[0], iargv,
+                           &(parg -> case_cons), parg -> resp[inx], &status,
+                           parg -> transcript ? output : NULL );
+
+    if ( ret == RES_TLE || ret == RES_MLE ) return ret;
+
+    res = ( WIFEXITED( status ) ? WEXITSTATUS( status ) : RES_VE );
+    
+    // The program may be killed by a broken pipe once the interactor has decided
+    if ( res == RES_WA || res == RES_PE ) return res;
+    if ( ret != RES_NORMAL ) return ret;
+    
+    return res == RES_AC ? RES_AC : RES_VE;
 }
 
 /*
@@ -259,7 +1132,7 @@ int run_user_program( int inx, const char* output, struct sys_arg_t* parg )
 {
     int ret;
     
-    if ( answer_from_user_program &&
+    if ( parg -> rt -> answer_from_user_program &&
          inx == parg -> std_inx ) {
 
         /*
@@ -275,10 +1148,17 @@ int run_user_program( int inx, const char* output, struct sys_arg_t* parg )
 
         ret = RES_NORMAL;
     }
-    else {
+    else if ( parg -> interactor_prog[0] ) {
+        ret = run_interactive_program( inx, output, parg );
+    }
+    else if ( parg -> store != NULL ) {
+        ret = run_program_hashed( inx, output, parg );
+    }
+    else if ( ( ret = warm_run( inx, parg -> input_file, output,
+                                &(parg -> case_cons), parg -> resp[inx] ) ) == -1 ) {
         ret = run_program( parg -> progs[inx], parg -> input_file,
                            output, NULL,
-                           &(parg -> res_cons), parg -> resp[inx],
+                           &(parg -> case_cons), parg -> resp[inx],
                            NULL, NULL );
     }
     
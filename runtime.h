@@ -11,12 +11,18 @@
 
 #define INPUT_BY_GENERATOR	1
 #define INPUT_BY_FOLDER		2
+#define INPUT_BY_PACK		3
 
 #define RESULT_BY_GENERATOR	1
 #define RESULT_BY_FOLDER	2
+#define RESULT_BY_STORE		3
+#define RESULT_BY_PACK		4
 
 #define CHECK_BY_COMPARISON	1
 #define CHECK_BY_JUDGE		2
+#define CHECK_BY_PLUGIN		3
+#define CHECK_BY_TOKENS		4
+#define CHECK_BY_STORE		5
 
 #define OOPS			100
 
@@ -28,23 +34,102 @@ typedef int (*FP_STD_RES)( struct sys_arg_t* );
 typedef int (*FP_CHK_RES)( struct sys_arg_t*, char* );
 
 /*
- * Funtion handlers to different testing mode:
+ * The runtime of a judge lives in Arg1: the loaded strategies, the generators
+ * running ahead, the file work in flight and the checker plugin.
+ * Judges with their own sys_arg_t and scratch folders can run in concurrent threads.
+ * Return 0 if out of memory.
+ */
+extern int runtime_open( struct sys_arg_t* );
+
+/* Stop and release everything of the runtime, nothing if it is not opened */
+extern void runtime_close( struct sys_arg_t* );
+
+/*
+ * Testing steps, by the loaded strategies:
  * get_next_input:      open a input file
+ * skip_next_input:     pass over an input, only its name or seed is known after
  * get_standard_result: get result from this input file
  * check_result:        check the result
  */
-extern FP_NEXT_INPUT get_next_input;
-extern FP_STD_RES   get_standard_result;
-extern FP_CHK_RES   check_result;
+extern int get_next_input( struct sys_arg_t* );
+extern int skip_next_input( struct sys_arg_t* );
+extern int get_standard_result( struct sys_arg_t* );
+extern int check_result( struct sys_arg_t*, char* );
 
 /*
  * Loaders
  */
-extern void load_input( int );
-extern void load_res_gen( int );
-extern void load_checker( int );
+extern void load_input( struct sys_arg_t*, int );
+extern void load_res_gen( struct sys_arg_t*, int );
+extern void load_checker( struct sys_arg_t*, int );
+
+/*
+ * The timing phase (see report.h) of the loaded input and answer strategies.
+ */
+extern int phase_of_input( struct sys_arg_t* );
+extern int phase_of_result( struct sys_arg_t* );
+
+/*
+ * Load a special judge built as a shared object into the runtime of Arg1, see checker.h.
+ * Return 0 if Arg2 is not such a checker, otherwise 1.
+ */
+extern int load_checker_plugin( struct sys_arg_t*, const char* );
+extern void unload_checker_plugin( struct sys_arg_t* );
+
+/*
+ * Record the digest of every standard answer into an answer store.
+ * Inputs and answers come from the loaded strategies, the input folder or pack is rewound after.
+ * Return 0 if failed.
+ */
+extern int build_answer_store( struct sys_arg_t*, const char* );
+
+/*
+ * Measure the launch overhead by running a null program Arg2 times,
+ * the result is kept in the resource constraint of Arg1.
+ * Return 0 if failed.
+ */
+extern int calibrate_overhead( struct sys_arg_t*, int );
+
+/*
+ * Make a data file readable whatever its compression.
+ * Arg1 is the file, Arg2 the name telling its compression (usually Arg1 itself);
+ * Arg3 receives the path to read the data from, a compressed file is
+ * decompressed into a memory file whose descriptor replaces the one in Arg4.
+ * Return 0 if failed.
+ */
+extern int stage_file( const char*, const char*, char*, int* );
+
+/* Release a memory file made by stage_file */
+extern void unstage_file( int* );
+
+/*
+ * Name of the current case as listed in the input folder or pack,
+ * without the compression suffix.
+ */
+extern void case_name( struct sys_arg_t*, char* );
 
 /* Run user's program */
 extern int run_user_program( int, const char*, struct sys_arg_t* );
 
+/*
+ * Start reading the output Arg3 of program Arg2 for the built-in comparators,
+ * check_result() then compares it from memory.
+ * Return 0 if it is not read ahead, it should be checked at once then.
+ */
+extern int prefetch_output( struct sys_arg_t*, int, const char* );
+
+/*
+ * Stop the generators making cases ahead, the next case is generator number 1 again.
+ */
+extern void close_input( struct sys_arg_t* );
+
+/*
+ * Wait for the queued file work (links, reads), see uring.h.
+ * Return 0 if some of it failed.
+ */
+extern int wait_io( struct sys_arg_t* );
+
+/* Wait and release the ring */
+extern void close_io( struct sys_arg_t* );
+
 #endif
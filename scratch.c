@@ -0,0 +1,152 @@
+/*
+ * The trash of scratch folders and the thread emptying it.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "file.h"
+#include "scratch.h"
+
+#define TRASH_NAME		".trash"
+
+// Once started, the thread looks at the trash this often (seconds) by itself
+#define SWEEP_INTERVAL	1
+
+static char trash[ FILE_NAME_LEN + 1 ] = "";
+static int retired = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+static pthread_t sweeper;
+static int started = 0, requested = 0, busy = 0, stopping = 0;
+
+int scratch_init( const char* base )
+{
+    int len = strlen( base );
+
+    if ( snprintf( trash, sizeof( trash ), "%s%s%s", base,
+                   len > 0 && base[ len - 1 ] == '/' ? "" : "/",
+                   TRASH_NAME ) >= (int)sizeof( trash ) ) {
+        trash[0] = 0;
+        return 0;
+    }
+
+    if ( mkdir( trash, S_IRWXU ) == -1 && !folder_exist( trash ) ) {
+        trash[0] = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+int scratch_retire( const char* path )
+{
+    char dest[ FILE_NAME_LEN + 1 ];
+
+    if ( trash[0] &&
+         snprintf( dest, sizeof( dest ), "%s/%d_%d",
+                   trash, getpid(), retired++ ) < (int)sizeof( dest ) &&
+         rename( path, dest ) == 0 ) return 1;
+
+    remove_folder( path );
+    return 0;
+}
+
+// Remove whatever is in the trash now
+static void empty_trash()
+{
+    char path[ FILE_NAME_LEN + 1 ];
+    struct dirent* pe;
+    DIR* pdir;
+
+    if ( ( pdir = opendir( trash ) ) == NULL ) return;
+
+    while ( ( pe = readdir( pdir ) ) != NULL ) {
+        if ( strcmp( pe -> d_name, "." ) == 0 ||
+             strcmp( pe -> d_name, ".." ) == 0 ) continue;
+
+        if ( snprintf( path, sizeof( path ), "%s/%s",
+                       trash, pe -> d_name ) < (int)sizeof( path ) )
+            remove_folder( path );
+    }
+
+    closedir( pdir );
+}
+
+static void* sweep_loop( void* arg )
+{
+    struct timespec ts;
+
+    (void)arg;
+
+    pthread_mutex_lock( &lock );
+
+    while ( 1 ) {
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec += SWEEP_INTERVAL;
+        
+        while ( !requested && !stopping )
+            if ( pthread_cond_timedwait( &wake, &lock, &ts ) == ETIMEDOUT ) {
+                requested = 1;
+                break;
+            }
+        if ( !requested ) break;
+
+        requested = 0;
+        busy = 1;
+        pthread_mutex_unlock( &lock );
+
+        empty_trash();
+
+        pthread_mutex_lock( &lock );
+        busy = 0;
+        pthread_cond_broadcast( &idle );
+    }
+
+    pthread_mutex_unlock( &lock );
+    return NULL;
+}
+
+void scratch_sweep()
+{
+    if ( !trash[0] ) return;
+
+    pthread_mutex_lock( &lock );
+
+    if ( !started ) {
+        started = ( pthread_create( &sweeper, NULL, sweep_loop, NULL ) == 0 );
+        if ( !started ) {
+            pthread_mutex_unlock( &lock );
+            empty_trash();
+            return;
+        }
+    }
+
+    requested = 1;
+    pthread_cond_signal( &wake );
+    pthread_mutex_unlock( &lock );
+}
+
+void scratch_drain()
+{
+    if ( !started ) return;
+
+    pthread_mutex_lock( &lock );
+    stopping = 1;
+    pthread_cond_signal( &wake );
+    while ( requested || busy )
+        pthread_cond_wait( &idle, &lock );
+    pthread_mutex_unlock( &lock );
+
+    pthread_join( sweeper, NULL );
+    started = stopping = 0;
+}
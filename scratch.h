@@ -0,0 +1,34 @@
+/*
+ * Scratch folders are retired into a trash folder by a rename, which is
+ * instant, and the trash is emptied by a background thread.
+ * So deleting the data of a finished session never holds anybody up.
+ * By richardxx, 2009.6
+ */
+
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+/*
+ * Use the trash folder under Arg1, created if doesn't exist.
+ * Return 0 if failed.
+ */
+extern int scratch_init( const char* );
+
+/*
+ * Move the folder Arg1 into the trash, it can be created again at once.
+ * This doesn't need the thread, a forked child may call it.
+ * Return 0 if failed, the folder is removed in place then.
+ */
+extern int scratch_retire( const char* );
+
+/*
+ * Have the background thread empty the trash, without waiting.
+ * Once started, the thread also empties it every second by itself.
+ * It is emptied at once if the thread can't be started.
+ */
+extern void scratch_sweep();
+
+/* Wait until the trash is empty and stop the thread */
+extern void scratch_drain();
+
+#endif
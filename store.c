@@ -0,0 +1,230 @@
+/*
+ * The store is a text file, one answer per line:
+ *   <length> <hash> <pe hash> <input name>
+ * The name comes last so it may hold spaces.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "consts.h"
+#include "libprocs.h"
+#include "store.h"
+
+#define STORE_MAGIC		"# tester answer store 2"
+#define CHUNK_SIZE		65536
+#define LINE_LEN		( FILE_NAME_LEN + 256 )
+
+#define IS_SPACE( c )	( (c) == ' ' || (c) == '\n' || (c) == '\t' || \
+						  (c) == '\r' || (c) == '\v' || (c) == '\f' )
+
+void answer_hash_init( struct answer_hash_t* ph )
+{
+    hash_init( &ph -> exact );
+    hash_init( &ph -> pe );
+    ph -> len = 0;
+    ph -> in_line = 0;
+}
+
+void answer_hash_update( struct answer_hash_t* ph, const char* buf, int len )
+{
+    char norm[ 1024 ];
+    int i, n;
+
+    hash_update( &ph -> exact, buf, len );
+    ph -> len += len;
+
+    // Case folded, white spaces within lines and blank lines removed
+    for ( i = n = 0; i < len; ++i ) {
+        if ( buf[i] == '\n' ) {
+            if ( !ph -> in_line ) continue;
+            norm[ n++ ] = '\n';
+            ph -> in_line = 0;
+        }
+        else if ( IS_SPACE( buf[i] ) ) continue;
+        else {
+            norm[ n++ ] = ( buf[i] >= 'A' && buf[i] <= 'Z' ?
+                            buf[i] - 'A' + 'a' : buf[i] );
+            ph -> in_line = 1;
+        }
+
+        if ( n == sizeof( norm ) ) {
+            hash_update( &ph -> pe, norm, n );
+            n = 0;
+        }
+    }
+    hash_update( &ph -> pe, norm, n );
+}
+
+void answer_hash_final( struct answer_hash_t* ph, struct answer_t* pa )
+{
+    unsigned char digest[ HASH_LEN ];
+
+    // The last line counts the same with or without its line break
+    if ( ph -> in_line ) {
+        hash_update( &ph -> pe, "\n", 1 );
+        ph -> in_line = 0;
+    }
+
+    hash_final( &ph -> exact, digest );
+    hash_to_hex( digest, pa -> hash );
+    hash_final( &ph -> pe, digest );
+    hash_to_hex( digest, pa -> pe_hash );
+    pa -> len = ph -> len;
+}
+
+struct answer_store_t* create_store()
+{
+    struct answer_store_t* ps;
+
+    ps = ( struct answer_store_t* )malloc( sizeof( struct answer_store_t ) );
+    if ( ps == NULL ) return NULL;
+
+    ps -> items = NULL;
+    ps -> num = ps -> cap = 0;
+    ps -> sorted = 1;
+    return ps;
+}
+
+static struct answer_t* new_item( struct answer_store_t* ps, const char* name )
+{
+    struct answer_t* p;
+
+    if ( ps -> num == ps -> cap ) {
+        ps -> cap = ( ps -> cap == 0 ? 256 : ps -> cap * 2 );
+        p = ( struct answer_t* )realloc( ps -> items,
+                                         ps -> cap * sizeof( struct answer_t ) );
+        if ( p == NULL ) return NULL;
+        ps -> items = p;
+    }
+
+    p = ps -> items + ps -> num;
+    if ( ( p -> name = strdup( name ) ) == NULL ) return NULL;
+
+    ++ps -> num;
+    ps -> sorted = 0;
+    return p;
+}
+
+struct answer_store_t* load_store( const char* fname )
+{
+    struct answer_store_t* ps;
+    struct answer_t a, *p;
+    char line[ LINE_LEN ];
+    int n, len;
+    FILE* fp;
+
+    if ( ( fp = fopen( fname, "re" ) ) == NULL ) return NULL;
+
+    if ( fgets( line, LINE_LEN, fp ) == NULL ||
+         strncmp( line, STORE_MAGIC, strlen( STORE_MAGIC ) ) != 0 ||
+         ( ps = create_store() ) == NULL ) {
+        fclose( fp );
+        return NULL;
+    }
+
+    while ( fgets( line, LINE_LEN, fp ) != NULL ) {
+        len = strlen( line );
+        if ( len > 0 && line[ len - 1 ] == '\n' ) line[ --len ] = 0;
+
+        if ( sscanf( line, "%lld %64s %64s %n",
+                     &a.len, a.hash, a.pe_hash, &n ) != 3 ||
+             line[n] == 0 ||
+             ( p = new_item( ps, line + n ) ) == NULL ) {
+#ifdef DEBUG
+            fprintf( stderr, "Bad answer store line: %s\n", line );
+#endif
+            close_store( ps );
+            fclose( fp );
+            return NULL;
+        }
+
+        p -> len = a.len;
+        strcpy( p -> hash, a.hash );
+        strcpy( p -> pe_hash, a.pe_hash );
+    }
+
+    fclose( fp );
+    return ps;
+}
+
+int save_store( struct answer_store_t* ps, const char* fname )
+{
+    FILE* fp;
+    int i;
+
+    if ( ( fp = fopen( fname, "we" ) ) == NULL ) return 0;
+
+    fprintf( fp, "%s\n", STORE_MAGIC );
+    for ( i = 0; i < ps -> num; ++i )
+        fprintf( fp, "%lld %s %s %s\n", ps -> items[i].len,
+                 ps -> items[i].hash, ps -> items[i].pe_hash,
+                 ps -> items[i].name );
+
+    return fclose( fp ) == 0;
+}
+
+int store_add( struct answer_store_t* ps, const char* name, const char* fanswer )
+{
+    struct answer_hash_t h;
+    struct answer_t* p;
+    char buf[ CHUNK_SIZE ];
+    int fd, ret;
+
+    if ( ( fd = open( fanswer, O_RDONLY | O_CLOEXEC ) ) == -1 ) return 0;
+
+    answer_hash_init( &h );
+    while ( ( ret = read( fd, buf, CHUNK_SIZE ) ) > 0 )
+        answer_hash_update( &h, buf, ret );
+    close( fd );
+
+    if ( ret < 0 || ( p = new_item( ps, name ) ) == NULL ) return 0;
+
+    answer_hash_final( &h, p );
+    return 1;
+}
+
+static int cmp_item( const void* a, const void* b )
+{
+    return strcmp( ( (const struct answer_t*)a ) -> name,
+                   ( (const struct answer_t*)b ) -> name );
+}
+
+const struct answer_t* store_find( struct answer_store_t* ps, const char* name )
+{
+    struct answer_t key;
+
+    if ( !ps -> sorted ) {
+        qsort( ps -> items, ps -> num, sizeof( struct answer_t ), cmp_item );
+        ps -> sorted = 1;
+    }
+
+    key.name = (char*)name;
+    return ( const struct answer_t* )bsearch( &key, ps -> items, ps -> num,
+                                              sizeof( struct answer_t ),
+                                              cmp_item );
+}
+
+int store_check( const struct answer_t* pans, const struct answer_t* pout )
+{
+    if ( pans -> len == pout -> len &&
+         strcmp( pans -> hash, pout -> hash ) == 0 ) return RES_AC;
+
+    if ( strcmp( pans -> pe_hash, pout -> pe_hash ) == 0 ) return RES_PE;
+
+    return RES_WA;
+}
+
+void close_store( struct answer_store_t* ps )
+{
+    int i;
+
+    if ( ps == NULL ) return;
+
+    for ( i = 0; i < ps -> num; ++i ) free( ps -> items[i].name );
+    free( ps -> items );
+    free( ps );
+}
@@ -0,0 +1,80 @@
+/*
+ * Golden answer store.
+ * Instead of the expected outputs, only their digests are kept, so
+ * outputs can be checked while they stream without any expected file.
+ * By richardxx, 2009.6
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include "hash.h"
+
+/*
+ * What we know about the answer of one input.
+ * pe_hash digests the answer with case, the white spaces within lines and
+ * blank lines ignored, the relaxation 'diff -i -b -w -B' uses for presentation errors.
+ */
+struct answer_t
+{
+    char* name;
+    long long len;
+    char hash[ HASH_HEX_LEN + 1 ];
+    char pe_hash[ HASH_HEX_LEN + 1 ];
+};
+
+struct answer_store_t
+{
+    struct answer_t* items;
+    int num, cap;
+    int sorted;
+};
+
+/*
+ * Streaming digest of an output.
+ */
+struct answer_hash_t
+{
+    struct hash_ctx_t exact, pe;
+    long long len;
+    int in_line;        // The current line has more than white spaces
+};
+
+extern void answer_hash_init( struct answer_hash_t* );
+extern void answer_hash_update( struct answer_hash_t*, const char*, int );
+extern void answer_hash_final( struct answer_hash_t*, struct answer_t* );
+
+/*
+ * Create an empty store, or load one from file.
+ * Return NULL if failed.
+ */
+extern struct answer_store_t* create_store();
+extern struct answer_store_t* load_store( const char* );
+
+/*
+ * Write the store to file.
+ * Return 0 if failed.
+ */
+extern int save_store( struct answer_store_t*, const char* );
+
+/*
+ * Digest the answer file Arg3 and record it under the name Arg2.
+ * Return 0 if failed.
+ */
+extern int store_add( struct answer_store_t*, const char*, const char* );
+
+/*
+ * Look up the answer of an input by its name.
+ * Return NULL if unknown.
+ */
+extern const struct answer_t* store_find( struct answer_store_t*, const char* );
+
+/*
+ * Compare a digested output to the answer.
+ * Return RES_AC, RES_PE or RES_WA.
+ */
+extern int store_check( const struct answer_t*, const struct answer_t* );
+
+extern void close_store( struct answer_store_t* );
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Every worker is a forked tester judging its own share of the cases in its
+ * own scratch folder, and writes one message per case to a pipe.
+ * The parent merges the messages, shows the progress and stops everybody.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "consts.h"
+#include "file.h"
+#include "libsys.h"
+#include "libprocs.h"
+#include "runtime.h"
+#include "judge.h"
+#include "report.h"
+#include "stress.h"
+
+// The progress line is refreshed this often (ms)
+#define PROGRESS_INTERVAL	1000
+
+/*
+ * A judged case, followed by one stress_res_t per program.
+ * failed is 1 if some program is wrong, -1 if the case couldn't be judged.
+ */
+struct stress_msg_t
+{
+    int index, failed;
+    unsigned long long seed;
+};
+
+struct stress_res_t
+{
+    int res, corrected, mem;
+    long long us, out;
+};
+
+// Workers of the running stress test, each leads its own process group
+static pid_t* workers = NULL;
+static int num_workers = 0;
+
+static int write_full( int fd, const char* buf, int len )
+{
+    int ret, done;
+
+    for ( done = 0; done < len; done += ret )
+        if ( ( ret = write( fd, buf + done, len - done ) ) <= 0 ) {
+            if ( ret == -1 && errno == EINTR ) { ret = 0; continue; }
+            return 0;
+        }
+
+    return 1;
+}
+
+static int read_full( int fd, char* buf, int len )
+{
+    int ret, done;
+
+    for ( done = 0; done < len; done += ret )
+        if ( ( ret = read( fd, buf + done, len - done ) ) <= 0 ) {
+            if ( ret == -1 && errno == EINTR ) { ret = 0; continue; }
+            return 0;
+        }
+
+    return 1;
+}
+
+static void stress_worker( struct sys_arg_t* parg, int w, int fd )
+{
+    char path[ FILE_NAME_LEN + 1 ], *msg;
+    struct stress_msg_t* pm;
+    struct stress_res_t* pr;
+    int* verdicts;
+    int i, k, len;
+
+    // The parent cleans up, not us
+    signal( SIGINT, SIG_DFL );
+    signal( SIGTERM, SIG_DFL );
+    signal( SIGSEGV, SIG_DFL );
+    setpgid( 0, 0 );
+
+    sprintf( path, "%sstress%d", parg -> di_temp -> folder_name, w );
+    len = sizeof( struct stress_msg_t ) + parg -> num_of_progs * sizeof( struct stress_res_t );
+
+    if ( ( parg -> di_temp = open_folder( path ) ) == NULL ||
+         ( verdicts = ( int* )malloc( parg -> num_of_progs * sizeof( int ) ) ) == NULL ||
+         ( msg = ( char* )malloc( len ) ) == NULL ) _exit( -1 );
+
+    pm = ( struct stress_msg_t* )msg;
+    pr = ( struct stress_res_t* )( pm + 1 );
+
+    parg -> case_first = w + 1;
+    parg -> case_step = num_workers;
+    parg -> gen_jobs = 1;
+    parg -> runs = INT_MAX;
+    parg -> report.fp = NULL;
+
+    for ( k = 0; get_next_input( parg ); ++k ) {
+        memset( msg, 0, len );
+        pm -> index = w + 1 + k * num_workers;
+        pm -> seed = parg -> case_seed;
+
+        if ( !judge_case( parg, verdicts ) )
+            pm -> failed = -1;
+        else
+            for ( i = 0; i < parg -> num_of_progs; ++i ) {
+                pr[i].res = verdicts[i];
+                pr[i].corrected = ( parg -> calib_runs > 0 ?
+                                    time_corrected( parg -> resp[i], &(parg -> res_cons) ) : -1 );
+                pr[i].mem = mem_used( parg -> resp[i] );
+                pr[i].us = time_used_us( parg -> resp[i] );
+                pr[i].out = out_used( parg -> resp[i] );
+                if ( verdicts[i] != RES_AC ) pm -> failed = 1;
+            }
+
+        // The folder is left as it is, to be dumped
+        if ( !write_full( fd, msg, len ) || pm -> failed ) break;
+    }
+
+    _exit( 0 );
+}
+
+void stress_stop()
+{
+    int i;
+
+    for ( i = 0; i < num_workers; ++i )
+        if ( workers[i] > 0 ) kill( -workers[i], SIGKILL );
+
+    for ( i = 0; i < num_workers; ++i )
+        if ( workers[i] > 0 )
+            while ( waitpid( workers[i], NULL, 0 ) == -1 && errno == EINTR );
+
+    free( workers );
+    workers = NULL;
+    num_workers = 0;
+}
+
+int stress_judge( struct sys_arg_t* parg, int seconds, int nw )
+{
+    struct pollfd* pfds = NULL;
+    struct prog_stat_t* stats = NULL;
+    struct stress_msg_t* pm;
+    struct stress_res_t* pr;
+    char *msg = NULL, *fail_msg = NULL, path[ FILE_NAME_LEN + 1 ];
+    const char* interp = interpreter_of( parg -> gen_prog );
+    long long start, now, deadline, next_show, cases = 0;
+    int i, j, len, alive, fail_w = -1, tty, p[2];
+    double rate;
+
+    len = sizeof( struct stress_msg_t ) + parg -> num_of_progs * sizeof( struct stress_res_t );
+
+    if ( ( workers = ( pid_t* )calloc( nw, sizeof( pid_t ) ) ) == NULL ||
+         ( pfds = ( struct pollfd* )calloc( nw, sizeof( struct pollfd ) ) ) == NULL ||
+         ( stats = ( struct prog_stat_t* )malloc( parg -> num_of_progs *
+                                                  sizeof( struct prog_stat_t ) ) ) == NULL ||
+         ( msg = ( char* )malloc( len ) ) == NULL ||
+         ( fail_msg = ( char* )malloc( len ) ) == NULL ) {
+#ifdef DEBUG
+        fprintf( stderr, "Out of memory: %s(%d)\n",
+                 __FILE__, __LINE__ );
+#endif
+        goto error_code;
+    }
+
+    for ( i = 0; i < parg -> num_of_progs; ++i )
+        stat_init( stats + i, parg -> calib_runs > 0 );
+
+    printf( "Stress testing with %d workers for %ds\n", nw, seconds );
+    fflush( stdout );
+
+    num_workers = nw;
+    for ( i = 0; i < nw; ++i ) {
+        pfds[i].fd = -1;
+        if ( pipe( p ) == -1 ) break;
+
+        workers[i] = fork();
+        if ( workers[i] == 0 ) {
+            close( p[0] );
+            for ( j = 0; j < i; ++j ) close( pfds[j].fd );
+            stress_worker( parg, i, p[1] );
+        }
+
+        close( p[1] );
+        if ( workers[i] == -1 ) {
+            fprintf( stderr, "The system call fork failed.\n" );
+            close( p[0] );
+            break;
+        }
+
+        // The parent may signal the group before the worker joins it
+        setpgid( workers[i], workers[i] );
+        pfds[i].fd = p[0];
+        pfds[i].events = POLLIN;
+    }
+
+    tty = isatty( 1 );
+    start = phase_clock();
+    deadline = start + seconds * 1000000000LL;
+    next_show = start + PROGRESS_INTERVAL * 1000000LL;
+    alive = i;
+
+    while ( alive > 0 && fail_w == -1 ) {
+        now = phase_clock();
+        if ( now >= deadline ) break;
+
+        if ( now >= next_show ) {
+            printf( "%sCases = %lld, %.1f cases/s, %llds left%s",
+                    tty ? "\r" : "", cases,
+                    cases / ( ( now - start ) / 1e9 ),
+                    ( deadline - now ) / 1000000000LL, tty ? "   " : "\n" );
+            fflush( stdout );
+            next_show += PROGRESS_INTERVAL * 1000000LL;
+        }
+
+        now = ( next_show < deadline ? next_show : deadline ) - now;
+        if ( poll( pfds, num_workers, now / 1000000 + 1 ) <= 0 ) continue;
+
+        for ( i = 0; i < num_workers && fail_w == -1; ++i ) {
+            if ( pfds[i].fd == -1 || pfds[i].revents == 0 ) continue;
+
+            if ( !read_full( pfds[i].fd, msg, len ) ) {
+                // Worker finished, only a broken generator does
+                close( pfds[i].fd );
+                pfds[i].fd = -1;
+                --alive;
+                continue;
+            }
+
+            pm = ( struct stress_msg_t* )msg;
+            pr = ( struct stress_res_t* )( pm + 1 );
+            ++cases;
+
+            parg -> case_seed = pm -> seed;
+            report_case( parg, pm -> index, NULL );
+            for ( j = 0; j < parg -> num_of_progs && pm -> failed >= 0; ++j ) {
+                report_result( parg, j, pr[j].res, pr[j].us / 1000, pr[j].corrected,
+                               pr[j].mem, pr[j].out, NULL );
+                stat_add( stats + j, pr[j].us, pr[j].corrected, pr[j].mem, NULL,
+                          pm -> index, NULL );
+            }
+            report_case_end( parg );
+
+            if ( pm -> failed ) {
+                fail_w = i;
+                memcpy( fail_msg, msg, len );
+            }
+        }
+    }
+
+    now = phase_clock();
+    parg -> judge_ns += now - start;
+    stress_stop();
+    if ( tty && now >= start + PROGRESS_INTERVAL * 1000000LL ) putchar( '\n' );
+    putchar( '\n' );
+
+    if ( fail_w != -1 ) {
+        pm = ( struct stress_msg_t* )fail_msg;
+        pr = ( struct stress_res_t* )( pm + 1 );
+
+        printf( "Test %d:\n", pm -> index );
+        if ( pm -> failed < 0 )
+            printf( "Get standard answer error, terminated.\n" );
+        else
+            for ( j = 0; j < parg -> num_of_progs; ++j )
+                print_result( j, pr[j].us / 1000, pr[j].corrected, pr[j].mem,
+                              pr[j].out, pr[j].res );
+
+        printf( "Reproduce the input of test %d by: %s%s%s %llu %d\n\n",
+                pm -> index, interp ? interp : "", interp ? " " : "",
+                parg -> gen_prog, pm -> seed, pm -> index );
+
+        if ( parg -> dump_dir[0] ) {
+            sprintf( path, "%sstress%d", parg -> di_temp -> folder_name, fail_w );
+            rename_folder( path, parg -> dump_dir );
+        }
+    }
+    else if ( alive == 0 )
+        printf( "Workers stopped early, check the generator.\n\n" );
+
+    printf( "Summary:\n" );
+    for ( j = 0; j < parg -> num_of_progs; ++j )
+        print_summary( stats[j].time_us / 1000, stats[j].corrected,
+                       stats[j].mem_kb, stats[j].runs );
+    for ( j = 0; j < parg -> num_of_progs; ++j )
+        print_stat( j, stats + j );
+
+    rate = ( now > start ? cases / ( ( now - start ) / 1e9 ) : 0 );
+    printf( "Cases = %lld in %.1fs, %.1f cases/s\n", cases, ( now - start ) / 1e9, rate );
+    report_close( parg, stats );
+
+    for ( i = 0; i < nw; ++i )
+        if ( pfds[i].fd != -1 ) close( pfds[i].fd );
+    free( pfds );
+    free( stats );
+    free( msg );
+    free( fail_msg );
+    return 1;
+
+  error_code:
+    free( workers );
+    workers = NULL;
+    free( pfds );
+    free( stats );
+    free( msg );
+    free( fail_msg );
+    return 0;
+}
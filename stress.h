@@ -0,0 +1,24 @@
+/*
+ * Stress testing against a time budget: generated cases are judged on every
+ * core until the budget is spent or a program goes wrong.
+ * By richardxx, 2009.6
+ */
+
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "type_def.h"
+
+/*
+ * Judge generated cases with Arg3 workers for Arg2 seconds, stop at the first failed case.
+ * Worker w judges cases w+1, w+1+Arg3, ..., so any case is made again by its seed.
+ * Return 0 if unexpected errors occurred, otherwise 1.
+ */
+extern
+int stress_judge( struct sys_arg_t*, int, int );
+
+/* Kill the workers and whatever they run, for an interrupted run */
+extern
+void stress_stop();
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Binary trace format shared by instrument.c and trace2json.
+ * A trace file is a header followed by fixed size records in the order
+ * they were flushed; records of one thread are in time order.
+ * By richardxx, 2009.6
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC		"TSTTRACE"
+#define TRACE_MAGIC_LEN	8
+#define TRACE_VERSION	1
+#define TRACE_FILE		"trace_tester.bin"
+#define TRACE_PATH_LEN	1024
+
+// Record types
+#define TRACE_ENTER		0
+#define TRACE_EXIT		1
+#define TRACE_DROP		2	// fn holds the number of records lost by a full ring
+
+/*
+ * anchor is the run time address of trace_anchor(),
+ * the converter finds the load bias of exe by it.
+ */
+struct trace_header_t
+{
+    char magic[ TRACE_MAGIC_LEN ];
+    uint32_t version;
+    uint32_t pid;
+    uint64_t anchor;
+    char exe[ TRACE_PATH_LEN ];
+};
+
+/*
+ * ts is CLOCK_MONOTONIC_RAW in nanoseconds.
+ */
+struct trace_rec_t
+{
+    uint64_t ts;
+    uint64_t fn;
+    uint32_t tid;
+    uint32_t type;
+};
+
+#define TRACE_ANCHOR_SYM	"trace_anchor"
+
+#endif
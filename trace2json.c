@@ -0,0 +1,166 @@
+/*
+ * Convert a binary trace written by instrument.c to the Chrome trace
+ * event format, which chrome://tracing and Perfetto display as a timeline.
+ * Addresses are resolved by the symbol table of the traced executable, read by nm.
+ * Usage: trace2json [trace file] [json file]
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "trace.h"
+
+#define LINE_LEN		1024
+
+struct symbol_t
+{
+    uint64_t addr;
+    char* name;
+};
+
+static struct symbol_t* syms = NULL;
+static int num_syms = 0;
+
+static int cmp_symbol( const void* a, const void* b )
+{
+    uint64_t x = ( (const struct symbol_t*)a ) -> addr;
+    uint64_t y = ( (const struct symbol_t*)b ) -> addr;
+    return x < y ? -1 : ( x > y );
+}
+
+/*
+ * Read the code symbols of exe, and shift them by where it was loaded.
+ * Return 0 if nothing can be resolved.
+ */
+static int load_symbols( const struct trace_header_t* ph )
+{
+    char cmd[ TRACE_PATH_LEN + 64 ], line[ LINE_LEN ], name[ LINE_LEN ];
+    struct symbol_t* p;
+    uint64_t addr, anchor = 0, bias;
+    int cap = 0, i;
+    char type;
+    FILE* fp;
+
+    sprintf( cmd, "nm --defined-only '%s' 2>/dev/null", ph -> exe );
+    if ( ( fp = popen( cmd, "r" ) ) == NULL ) return 0;
+
+    while ( fgets( line, LINE_LEN, fp ) != NULL ) {
+        if ( sscanf( line, "%" SCNx64 " %c %1023s", &addr, &type, name ) != 3 )
+            continue;
+        if ( type != 't' && type != 'T' && type != 'w' && type != 'W' ) continue;
+
+        if ( strcmp( name, TRACE_ANCHOR_SYM ) == 0 ) anchor = addr;
+
+        if ( num_syms == cap ) {
+            cap = ( cap == 0 ? 1024 : cap * 2 );
+            p = ( struct symbol_t* )realloc( syms, cap * sizeof( struct symbol_t ) );
+            if ( p == NULL ) break;
+            syms = p;
+        }
+
+        syms[ num_syms ].addr = addr;
+        if ( ( syms[ num_syms ].name = strdup( name ) ) == NULL ) break;
+        ++num_syms;
+    }
+
+    pclose( fp );
+    if ( anchor == 0 ) return 0;
+
+    // Position independent executables are loaded at a random base
+    bias = ph -> anchor - anchor;
+    for ( i = 0; i < num_syms; ++i ) syms[i].addr += bias;
+
+    qsort( syms, num_syms, sizeof( struct symbol_t ), cmp_symbol );
+    return 1;
+}
+
+// The function containing addr
+static const char* resolve( uint64_t addr, char* buf )
+{
+    int lo = 0, hi = num_syms - 1, mid;
+
+    while ( lo <= hi ) {
+        mid = ( lo + hi ) / 2;
+        if ( syms[ mid ].addr <= addr ) lo = mid + 1;
+        else hi = mid - 1;
+    }
+
+    if ( hi >= 0 ) return syms[ hi ].name;
+
+    sprintf( buf, "0x%" PRIx64, addr );
+    return buf;
+}
+
+int main( int argc, char** argv )
+{
+    struct trace_header_t header;
+    struct trace_rec_t rec;
+    const char *fin, *fout;
+    uint64_t base = UINT64_MAX, last = 0;
+    char buf[32];
+    long n = 0;
+    FILE *fp, *out;
+
+    fin = ( argc > 1 ? argv[1] : TRACE_FILE );
+    fout = ( argc > 2 ? argv[2] : NULL );
+
+    if ( ( fp = fopen( fin, "rb" ) ) == NULL ) {
+        fprintf( stderr, "Open %s failed.\n", fin );
+        return -1;
+    }
+
+    if ( fread( &header, sizeof( header ), 1, fp ) != 1 ||
+         memcmp( header.magic, TRACE_MAGIC, TRACE_MAGIC_LEN ) != 0 ||
+         header.version != TRACE_VERSION ) {
+        fprintf( stderr, "%s is not a tester trace.\n", fin );
+        fclose( fp );
+        return -1;
+    }
+    header.exe[ TRACE_PATH_LEN - 1 ] = 0;
+
+    if ( !load_symbols( &header ) )
+        fprintf( stderr, "Symbols of %s are not available, raw addresses are kept.\n",
+                 header.exe );
+
+    // Time starts from the first record
+    while ( fread( &rec, sizeof( rec ), 1, fp ) == 1 )
+        if ( rec.type != TRACE_DROP && rec.ts < base ) base = rec.ts;
+    fseek( fp, sizeof( header ), SEEK_SET );
+    last = base;
+
+    if ( fout == NULL ) out = stdout;
+    else if ( ( out = fopen( fout, "w" ) ) == NULL ) {
+        fprintf( stderr, "Create %s failed.\n", fout );
+        fclose( fp );
+        return -1;
+    }
+
+    fprintf( out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+    fprintf( out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+             "\"args\":{\"name\":\"tester\"}}", header.pid );
+
+    while ( fread( &rec, sizeof( rec ), 1, fp ) == 1 ) {
+        if ( rec.type == TRACE_DROP ) {
+            fprintf( out, ",\n{\"name\":\"%" PRIu64 " records dropped\",\"ph\":\"i\","
+                     "\"s\":\"t\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+                     rec.fn, ( last - base ) / 1000.0, header.pid, rec.tid );
+            continue;
+        }
+
+        fprintf( out, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+                 resolve( rec.fn, buf ), rec.type == TRACE_ENTER ? "B" : "E",
+                 ( rec.ts - base ) / 1000.0, header.pid, rec.tid );
+        last = rec.ts;
+        ++n;
+    }
+
+    fprintf( out, "\n]}\n" );
+
+    if ( out != stdout ) fclose( out );
+    fclose( fp );
+
+    fprintf( stderr, "%ld events converted.\n", n );
+    return 0;
+}
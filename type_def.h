@@ -10,14 +10,57 @@
 #include "consts.h"
 #include "libprocs.h"
 #include "file.h"
+#include "compare.h"
+#include "store.h"
+#include "pack.h"
+#include "report.h"
+
+#define MAX_SIZES		32
+
+// Strategies and state of a running judge, see runtime.h
+struct runtime_t;
 
 struct sys_arg_t
 {
     // Upper running times and already evaluated times
     int runs, passed_cases;
 
-    // Resource constraint
-    struct RESCONS res_cons;
+    // Resource constraint, and the one of the tested programs on the current case
+    struct RESCONS res_cons, case_cons;
+
+    /*
+     * Relative time limits: a case allows time_factor times the standard
+     * program's time on it, but at least time_floor ms; off if time_factor is 0.
+     */
+    double time_factor;
+    int time_floor;
+
+    /*
+     * Generated case k gets a seed derived from seed and k, both passed to the generator;
+     * gen_jobs generators make cases ahead of the judging.
+     */
+    unsigned long long seed, case_seed;
+    int gen_jobs;
+
+    // Numbers of the generated cases: case_first, then every case_step
+    int case_first, case_step;
+
+    // Seconds of a stress test, see stress.h; 0 if the runs are counted
+    int budget;
+
+    /*
+     * Sizes of the complexity estimation, see growth.h; none if num_sizes is 0.
+     * case_size is given to the generator as its third argument, 0 for none.
+     */
+    long long sizes[ MAX_SIZES ];
+    int num_sizes, size_reps;
+    long long predict_size, case_size;
+
+    // Runs of the null program to measure the launch overhead, 0 if not calibrated
+    int calib_runs;
+
+    // Python programs run in warm runtimes, see warm.h
+    int warm;
     
     // Number of testing programs
     int num_of_progs;
@@ -31,10 +74,34 @@ struct sys_arg_t
     // Data generator and checking program
     char gen_prog[ FILE_NAME_LEN+1 ], checker_prog[ FILE_NAME_LEN+1 ];
 
+    // Interactor of interactive problems, and whether to record conversations
+    char interactor_prog[ FILE_NAME_LEN+1 ];
+    int transcript;
+
     // Input and output files' name
     char input_file[ FILE_NAME_LEN + 1 ];
     char output_file[ FILE_NAME_LEN + 1 ];
 
+    /*
+     * The input file as listed in the input folder.
+     * A compressed case is decompressed into a memory file,
+     * input_file and output_file then name it, in_fd and out_fd hold it.
+     */
+    char case_file[ FILE_NAME_LEN + 1 ];
+    int in_fd, out_fd;
+
+    // How to compare outputs when there's no special judge
+    struct cmp_opt_t cmp_opt;
+
+    // Test pack given by -I, or the one -P writes and -U extracts
+    char pack_file[ FILE_NAME_LEN + 1 ];
+    struct pack_t* pack;
+    int pack_op;
+
+    // Answer store in use, and where it lives
+    char store_file[ FILE_NAME_LEN + 1 ];
+    struct answer_store_t* store;
+
     // Intermediate data storage place
     char dump_dir[ DIR_NAME_LEN + 1 ];
     
@@ -50,6 +117,35 @@ struct sys_arg_t
 
     // Resource detector
     struct RESUSE** resp;
+
+    // Workers of a distributed run, "host:port,host:port..."
+    char worker_hosts[ FILE_NAME_LEN + 1 ];
+
+    // Address served when running as a worker, port 0 otherwise
+    char worker_host[ OPTION_LEN + 1 ];
+    int worker_port;
+
+    // Time spent in each phase and in judging as a whole, printed by -S
+    struct phase_stat_t phases[ NUM_PHASES ];
+    long long judge_ns;
+    int show_phases;
+
+    // JSON report given by -R, not written if fp is NULL
+    char report_file[ FILE_NAME_LEN + 1 ];
+    struct report_t report;
+
+    // Whether judge() journals the cases, see journal.h
+    int journaled;
+
+    /*
+     * Called by judge() after each case with the case number and the verdicts,
+     * judging stops if it returns 0; hook_ctx is left to its owner.
+     */
+    int (*case_hook)( struct sys_arg_t*, int, const int* );
+    void* hook_ctx;
+
+    // Opened by runtime_open()
+    struct runtime_t* rt;
 };
 
 #endif
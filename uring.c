@@ -0,0 +1,354 @@
+/*
+ * io_uring by hand: the rings are mapped after io_uring_setup(),
+ * submission and completion go through io_uring_enter().
+ * We are the only producer of the submission queue and the only
+ * consumer of the completion queue.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "consts.h"
+#include "file.h"
+#include "uring.h"
+
+#define OP_UNLINK		1
+#define OP_SYMLINK		2
+#define OP_READ			3
+
+// A read request is split into pieces of at most this size
+#define READ_PIECE		( 1 << 30 )
+
+struct uring_op_t
+{
+    int type, next_free;
+    char target[ FILE_NAME_LEN + 1 ], path[ FILE_NAME_LEN + 1 ];
+    int fd;
+    char* buf;
+    long long len, *pdone;
+};
+
+struct uring_t
+{
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+
+    // Queued but not submitted, submitted but not completed
+    unsigned pending, inflight;
+    int failed;
+
+    struct uring_op_t ops[ URING_ENTRIES ];
+    int free_op, num_free;
+};
+
+static int sys_setup( unsigned entries, struct io_uring_params* p )
+{
+    return syscall( __NR_io_uring_setup, entries, p );
+}
+
+static int sys_enter( int fd, unsigned to_submit, unsigned min_complete, unsigned flags )
+{
+    return syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+struct uring_t* uring_open( int entries )
+{
+    struct io_uring_params p;
+    struct uring_t* r;
+    char* sq;
+    char* cq;
+    int i;
+
+    if ( entries > URING_ENTRIES ) entries = URING_ENTRIES;
+    if ( ( r = ( struct uring_t* )calloc( 1, sizeof( struct uring_t ) ) ) == NULL )
+        return NULL;
+
+    memset( &p, 0, sizeof( p ) );
+    if ( ( r -> fd = sys_setup( entries, &p ) ) == -1 ) {
+        free( r );
+        return NULL;
+    }
+    fcntl( r -> fd, F_SETFD, FD_CLOEXEC );
+
+    r -> entries = p.sq_entries;
+    r -> sq_len = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+    r -> cq_len = p.cq_off.cqes + p.cq_entries * sizeof( struct io_uring_cqe );
+    r -> sqes_len = p.sq_entries * sizeof( struct io_uring_sqe );
+
+    // Both rings may live in one mapping
+    if ( p.features & IORING_FEAT_SINGLE_MMAP ) {
+        if ( r -> cq_len > r -> sq_len ) r -> sq_len = r -> cq_len;
+        r -> cq_len = 0;
+    }
+
+    r -> sq_ptr = mmap( NULL, r -> sq_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r -> fd, IORING_OFF_SQ_RING );
+    r -> cq_ptr = ( r -> cq_len == 0 ? r -> sq_ptr :
+                    mmap( NULL, r -> cq_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r -> fd, IORING_OFF_CQ_RING ) );
+    r -> sqes = mmap( NULL, r -> sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r -> fd, IORING_OFF_SQES );
+
+    if ( r -> sq_ptr == MAP_FAILED || r -> cq_ptr == MAP_FAILED ||
+         r -> sqes == MAP_FAILED ) {
+        if ( r -> sqes != MAP_FAILED ) munmap( r -> sqes, r -> sqes_len );
+        if ( r -> cq_len != 0 && r -> cq_ptr != MAP_FAILED ) munmap( r -> cq_ptr, r -> cq_len );
+        if ( r -> sq_ptr != MAP_FAILED ) munmap( r -> sq_ptr, r -> sq_len );
+        close( r -> fd );
+        free( r );
+        return NULL;
+    }
+
+    sq = r -> sq_ptr;
+    cq = r -> cq_ptr;
+    r -> sq_head = (unsigned*)( sq + p.sq_off.head );
+    r -> sq_tail = (unsigned*)( sq + p.sq_off.tail );
+    r -> sq_mask = (unsigned*)( sq + p.sq_off.ring_mask );
+    r -> sq_array = (unsigned*)( sq + p.sq_off.array );
+    r -> cq_head = (unsigned*)( cq + p.cq_off.head );
+    r -> cq_tail = (unsigned*)( cq + p.cq_off.tail );
+    r -> cq_mask = (unsigned*)( cq + p.cq_off.ring_mask );
+    r -> cqes = (struct io_uring_cqe*)( cq + p.cq_off.cqes );
+
+    // No more operations than entries, so the completion queue can't overflow
+    if ( r -> entries > URING_ENTRIES ) r -> entries = URING_ENTRIES;
+    for ( i = 0; i < (int)r -> entries; ++i ) r -> ops[i].next_free = i + 1;
+    r -> ops[ r -> entries - 1 ].next_free = -1;
+    r -> free_op = 0;
+    r -> num_free = r -> entries;
+
+    return r;
+}
+
+void uring_close( struct uring_t* r )
+{
+    if ( r == NULL ) return;
+
+    uring_wait( r );
+
+    munmap( r -> sqes, r -> sqes_len );
+    if ( r -> cq_len != 0 ) munmap( r -> cq_ptr, r -> cq_len );
+    munmap( r -> sq_ptr, r -> sq_len );
+    close( r -> fd );
+    free( r );
+}
+
+static struct uring_op_t* alloc_op( struct uring_t* r )
+{
+    struct uring_op_t* op = r -> ops + r -> free_op;
+
+    r -> free_op = op -> next_free;
+    --r -> num_free;
+    return op;
+}
+
+static void free_op( struct uring_t* r, struct uring_op_t* op )
+{
+    op -> next_free = r -> free_op;
+    r -> free_op = op - r -> ops;
+    ++r -> num_free;
+}
+
+/*
+ * Next free entry of the submission queue, there's always one
+ * since no more operations than entries are outstanding.
+ */
+static struct io_uring_sqe* get_sqe( struct uring_t* r, struct uring_op_t* op )
+{
+    unsigned tail = *r -> sq_tail, idx;
+    struct io_uring_sqe* sqe;
+
+    idx = tail & *r -> sq_mask;
+    sqe = r -> sqes + idx;
+    memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+    sqe -> user_data = (unsigned long long)( op - r -> ops );
+
+    r -> sq_array[ idx ] = idx;
+    __atomic_store_n( r -> sq_tail, tail + 1, __ATOMIC_RELEASE );
+    ++r -> pending;
+
+    return sqe;
+}
+
+static void queue_read( struct uring_t* r, struct uring_op_t* op )
+{
+    struct io_uring_sqe* sqe = get_sqe( r, op );
+    long long left = op -> len - *op -> pdone;
+
+    sqe -> opcode = IORING_OP_READ;
+    sqe -> fd = op -> fd;
+    sqe -> addr = (unsigned long long)(uintptr_t)( op -> buf + *op -> pdone );
+    sqe -> len = ( left > READ_PIECE ? READ_PIECE : left );
+    sqe -> off = *op -> pdone;
+}
+
+void uring_submit( struct uring_t* r )
+{
+    int ret;
+
+    if ( r == NULL || r -> pending == 0 ) return;
+
+    do {
+        ret = sys_enter( r -> fd, r -> pending, 0, 0 );
+    } while ( ret == -1 && errno == EINTR );
+
+    if ( ret > 0 ) {
+        r -> pending -= ret;
+        r -> inflight += ret;
+    }
+}
+
+static void complete( struct uring_t* r, struct uring_op_t* op, int res )
+{
+    switch ( op -> type ) {
+        case OP_SYMLINK:
+            if ( res < 0 &&
+                 link( op -> target, op -> path ) == -1 &&
+                 !file_copy( op -> target, op -> path ) ) ++r -> failed;
+            break;
+
+        case OP_READ:
+            if ( res < 0 ) {
+                *op -> pdone = -1;
+                ++r -> failed;
+                break;
+            }
+
+            *op -> pdone += res;
+            if ( res > 0 && *op -> pdone < op -> len ) {
+                // The rest, by the same operation
+                queue_read( r, op );
+                return;
+            }
+            break;
+    }
+
+    free_op( r, op );
+}
+
+// Handle whatever has completed
+static void reap( struct uring_t* r )
+{
+    unsigned head = *r -> cq_head, tail;
+    struct io_uring_cqe* cqe;
+
+    tail = __atomic_load_n( r -> cq_tail, __ATOMIC_ACQUIRE );
+    while ( head != tail ) {
+        cqe = r -> cqes + ( head & *r -> cq_mask );
+        ++head;
+        --r -> inflight;
+        __atomic_store_n( r -> cq_head, head, __ATOMIC_RELEASE );
+
+        complete( r, r -> ops + cqe -> user_data, cqe -> res );
+    }
+}
+
+int uring_wait( struct uring_t* r )
+{
+    int ret, failed;
+
+    if ( r == NULL ) return 0;
+
+    for ( ;; ) {
+        reap( r );
+        if ( r -> pending == 0 && r -> inflight == 0 ) break;
+
+        ret = sys_enter( r -> fd, r -> pending, 1, IORING_ENTER_GETEVENTS );
+        if ( ret == -1 ) {
+            if ( errno == EINTR ) continue;
+            break;
+        }
+
+        r -> pending -= ret;
+        r -> inflight += ret;
+    }
+
+    failed = r -> failed;
+    r -> failed = 0;
+    return failed;
+}
+
+// Make room for n operations
+static void reserve( struct uring_t* r, int n )
+{
+    if ( r -> num_free < n ) uring_wait( r );
+}
+
+int uring_link_file( struct uring_t* r, const char* target, const char* path )
+{
+    struct uring_op_t *op1, *op2;
+    struct io_uring_sqe* sqe;
+
+    if ( r == NULL ) {
+        unlink( path );
+        return ( symlink( target, path ) == 0 ||
+                 link( target, path ) == 0 ||
+                 file_copy( target, path ) );
+    }
+
+    reserve( r, 2 );
+    op1 = alloc_op( r );
+    op2 = alloc_op( r );
+
+    op1 -> type = OP_UNLINK;
+    strcpy( op1 -> path, path );
+    op2 -> type = OP_SYMLINK;
+    strcpy( op2 -> target, target );
+    strcpy( op2 -> path, path );
+
+    // The link is made whether the unlink succeeded or not
+    sqe = get_sqe( r, op1 );
+    sqe -> opcode = IORING_OP_UNLINKAT;
+    sqe -> fd = AT_FDCWD;
+    sqe -> addr = (unsigned long long)(uintptr_t)op1 -> path;
+    sqe -> flags = IOSQE_IO_HARDLINK;
+
+    sqe = get_sqe( r, op2 );
+    sqe -> opcode = IORING_OP_SYMLINKAT;
+    sqe -> fd = AT_FDCWD;
+    sqe -> addr = (unsigned long long)(uintptr_t)op2 -> target;
+    sqe -> addr2 = (unsigned long long)(uintptr_t)op2 -> path;
+
+    return 1;
+}
+
+int uring_read( struct uring_t* r, int fd, char* buf, long long len, long long* pdone )
+{
+    struct uring_op_t* op;
+    long long ret = 0;
+
+    *pdone = 0;
+
+    if ( r == NULL ) {
+        while ( *pdone < len &&
+                ( ret = pread( fd, buf + *pdone, len - *pdone, *pdone ) ) > 0 )
+            *pdone += ret;
+        if ( ret == -1 ) *pdone = -1;
+        return *pdone != -1;
+    }
+
+    reserve( r, 1 );
+    op = alloc_op( r );
+    op -> type = OP_READ;
+    op -> fd = fd;
+    op -> buf = buf;
+    op -> len = len;
+    op -> pdone = pdone;
+    queue_read( r, op );
+
+    return 1;
+}
@@ -0,0 +1,48 @@
+/*
+ * A small io_uring backend driven by raw system calls.
+ * Operations are queued, submitted in one go and completed later on the
+ * calling thread, so file work goes on while the children run.
+ * Every function accepts a NULL ring and then does the work at once,
+ * which is what happens where io_uring is not available.
+ * By richardxx, 2009.6
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#define URING_ENTRIES		64
+
+struct uring_t;
+
+/*
+ * Set up a ring of Arg1 entries.
+ * Return NULL if the kernel refuses.
+ */
+extern struct uring_t* uring_open( int );
+
+/* Complete everything in flight and release the ring */
+extern void uring_close( struct uring_t* );
+
+/*
+ * Replace Arg3 by a symbolic link to Arg2, a hard link or a copy if that fails.
+ * Paths are copied, the caller may reuse them.
+ * Return 0 if failed (known at once only without a ring).
+ */
+extern int uring_link_file( struct uring_t*, const char*, const char* );
+
+/*
+ * Read Arg4 bytes from the beginning of Arg2 into Arg3.
+ * Arg5 receives the bytes read once completed, -1 on errors.
+ */
+extern int uring_read( struct uring_t*, int, char*, long long, long long* );
+
+/* Submit what is queued, without waiting */
+extern void uring_submit( struct uring_t* );
+
+/*
+ * Wait until everything queued has completed.
+ * Return the number of operations that failed.
+ */
+extern int uring_wait( struct uring_t* );
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Servers talk lines over a socket:
+ *   server: READY                           once the program is loaded
+ *   tester: RUN <input> <output> <cpu s> <file size>
+ *   server: PID <pid>                       what to kill if out of time
+ *   server: DONE <status> <user us> <system us> <memory KB> <peak RSS KB>
+ * The server forks a child per case, so the limits and the usage are
+ * the child's own.
+ * By richardxx, 2009.6
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "consts.h"
+#include "libprocs.h"
+#include "report.h"
+#include "warm.h"
+
+#define LINE_LEN		( FILE_NAME_LEN * 2 + 64 )
+
+// Time a server may take to load its program (ms)
+#define STARTUP_WAIT	30000
+
+/*
+ * Python server, argv[1] is the script.
+ * The common modules are imported ahead, and the objects made so far are
+ * frozen so that the children don't copy them when collecting garbage.
+ */
+static const char* py_server =
+    "import os, sys, gc, resource\n"
+    "src = sys.argv[1]\n"
+    "code = compile(open(src).read(), src, 'exec')\n"
+    "for m in ('math', 're', 'collections', 'heapq', 'bisect', 'itertools', 'functools'):\n"
+    "    __import__(m)\n"
+    "gc.collect()\n"
+    "if hasattr(gc, 'freeze'):\n"
+    "    gc.freeze()\n"
+    "page = resource.getpagesize()\n"
+    "def run(inp, outp, cpu, fsize):\n"
+    "    fds = [os.open(inp, os.O_RDONLY),\n"
+    "           os.open(outp, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644),\n"
+    "           os.open(os.devnull, os.O_WRONLY)]\n"
+    "    for i in range(3):\n"
+    "        os.dup2(fds[i], i)\n"
+    "        os.close(fds[i])\n"
+    "    resource.setrlimit(resource.RLIMIT_CPU, (cpu, cpu + 1))\n"
+    "    if fsize > 0:\n"
+    "        resource.setrlimit(resource.RLIMIT_FSIZE, (fsize, fsize))\n"
+    "    sys.stdin = open(0, 'r', closefd=False)\n"
+    "    sys.stdout = open(1, 'w', closefd=False)\n"
+    "    sys.stderr = open(2, 'w', closefd=False)\n"
+    "    status = 0\n"
+    "    try:\n"
+    "        exec(code, {'__name__': '__main__', '__file__': src, '__builtins__': __builtins__})\n"
+    "    except SystemExit as e:\n"
+    "        status = e.code if isinstance(e.code, int) else (e.code is not None)\n"
+    "    sys.stdout.flush()\n"
+    "    os._exit(status & 255)\n"
+    "ctl = sys.stdout\n"
+    "ctl.write('READY\\n')\n"
+    "ctl.flush()\n"
+    "while True:\n"
+    "    f = sys.stdin.readline().rstrip('\\n').split('\\t')\n"
+    "    if f[0] != 'RUN':\n"
+    "        break\n"
+    "    pid = os.fork()\n"
+    "    if pid == 0:\n"
+    "        try:\n"
+    "            run(f[1], f[2], int(f[3]), int(f[4]))\n"
+    "        except BaseException:\n"
+    "            os.abort()\n"
+    "    ctl.write('PID %d\\n' % pid)\n"
+    "    ctl.flush()\n"
+    "    status, ru = os.wait4(pid, 0)[1:]\n"
+    "    ctl.write('DONE %d %d %d %d %d\\n' % (status, ru.ru_utime * 1e6, ru.ru_stime * 1e6,\n"
+    "                                        ru.ru_minflt * page // 1024, ru.ru_maxrss))\n"
+    "    ctl.flush()\n";
+
+struct warm_t
+{
+    int kind;
+    pid_t pid;                  // the server, 0 if not running
+    int fd;
+    char buf[ LINE_LEN ];       // what the server said beyond the last line
+    int len;
+    long long startup_us;
+};
+
+static struct warm_t* servers = NULL;
+static int num_servers = 0;
+
+static char** progs = NULL;
+
+int warm_kind( const char* prog )
+{
+    int len = strlen( prog );
+
+    return ( len > 3 && strcmp( prog + len - 3, ".py" ) == 0 ? WARM_PYTHON : WARM_NONE );
+}
+
+/*
+ * Read a line of the server into Arg2, waiting at most Arg3 ms ( -1 for ever ).
+ * Return 1 if read, -1 if out of time, 0 if the server is gone.
+ */
+static int read_line( struct warm_t* w, char* line, int timeout )
+{
+    struct pollfd pfd;
+    char* p;
+    int ret;
+
+    while ( ( p = memchr( w -> buf, '\n', w -> len ) ) == NULL ) {
+        if ( w -> len == LINE_LEN ) return 0;
+
+        pfd.fd = w -> fd;
+        pfd.events = POLLIN;
+        ret = poll( &pfd, 1, timeout );
+        if ( ret == 0 ) return -1;
+
+        if ( ret > 0 ) ret = read( w -> fd, w -> buf + w -> len, LINE_LEN - w -> len );
+        if ( ret <= 0 ) {
+            if ( ret == -1 && errno == EINTR ) continue;
+            return 0;
+        }
+        w -> len += ret;
+    }
+
+    *p = 0;
+    strcpy( line, w -> buf );
+    w -> len -= p + 1 - w -> buf;
+    memmove( w -> buf, p + 1, w -> len );
+    return 1;
+}
+
+// Return the wait status of the server
+static int kill_server( struct warm_t* w )
+{
+    int status = 0;
+
+    if ( w -> pid > 0 ) {
+        kill( w -> pid, SIGKILL );
+        while ( waitpid( w -> pid, &status, 0 ) == -1 && errno == EINTR );
+        close( w -> fd );
+    }
+
+    w -> pid = 0;
+    w -> len = 0;
+    return status;
+}
+
+static int start_server( int inx )
+{
+    struct warm_t* w = servers + inx;
+    char line[ LINE_LEN ], *argv[5];
+    long long start;
+    int sv[2], fd_null;
+
+    argv[0] = "python3";
+    argv[1] = "-c";
+    argv[2] = (char*)py_server;
+    argv[3] = progs[inx];
+    argv[4] = NULL;
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv ) == -1 ) return 0;
+
+    start = phase_clock();
+    w -> pid = fork();
+    if ( w -> pid == 0 ) {
+        fd_null = open( "/dev/null", O_WRONLY | O_CLOEXEC );
+        dup2( sv[1], 0 );
+        dup2( sv[1], 1 );
+        if ( fd_null != -1 ) dup2( fd_null, 2 );
+        execvp( argv[0], argv );
+        _exit( -1 );
+    }
+
+    close( sv[1] );
+    if ( w -> pid == -1 ) {
+        w -> pid = 0;
+        close( sv[0] );
+        return 0;
+    }
+
+    w -> fd = sv[0];
+    w -> len = 0;
+    if ( read_line( w, line, STARTUP_WAIT ) != 1 || strcmp( line, "READY" ) != 0 ) {
+        kill_server( w );
+        return 0;
+    }
+
+    w -> startup_us = ( phase_clock() - start ) / 1000;
+    return 1;
+}
+
+int warm_start( struct sys_arg_t* parg )
+{
+    int i;
+
+    servers = ( struct warm_t* )calloc( parg -> num_of_progs, sizeof( struct warm_t ) );
+    if ( servers == NULL ) return 0;
+
+    num_servers = parg -> num_of_progs;
+    progs = parg -> progs;
+
+    for ( i = 0; i < num_servers; ++i ) {
+        servers[i].kind = warm_kind( progs[i] );
+        servers[i].startup_us = -1;
+    }
+
+    for ( i = 0; i < num_servers; ++i ) {
+        if ( servers[i].kind == WARM_NONE ) continue;
+
+        if ( !start_server( i ) ) {
+            fprintf( stderr, "Start the warm runtime of %s failed.\n", progs[i] );
+            return 0;
+        }
+
+        printf( "Prog %5d: warm runtime started in %.3fms\n",
+                i, servers[i].startup_us / 1000.0 );
+    }
+
+    fflush( stdout );
+    return 1;
+}
+
+static void set_tv( struct timeval* tv, long long us )
+{
+    tv -> tv_sec = us / 1000000;
+    tv -> tv_usec = us % 1000000;
+}
+
+int warm_run( int inx, const char* input, const char* output,
+              struct RESCONS* rc, struct RESUSE* resp )
+{
+    struct warm_t* w;
+    struct stat st;
+    char line[ LINE_LEN ];
+    long long deadline, user, sys, mem, rss;
+    int pid, status, len, ret, killed = 0;
+
+    if ( inx >= num_servers || servers[inx].kind == WARM_NONE ) return -1;
+    w = servers + inx;
+
+    // A server killed with its program is started again, quietly
+    if ( w -> pid == 0 && !start_server( inx ) ) return RES_SE;
+
+    len = snprintf( line, LINE_LEN, "RUN\t%s\t%s\t%d\t%lld\n", input, output,
+                    rc -> time_limit / 1000 + 1,
+                    rc -> out_limit > 0 ? ( (long long)rc -> out_limit << 10 ) + 1 : 0 );
+
+    resuse_start( resp );
+    if ( len >= LINE_LEN || send( w -> fd, line, len, MSG_NOSIGNAL ) != len ||
+         read_line( w, line, -1 ) != 1 || sscanf( line, "PID %d", &pid ) != 1 ) {
+        kill_server( w );
+        return RES_SE;
+    }
+
+    deadline = phase_clock() / 1000000 + rc -> time_limit +
+        ( rc -> corrected ? rc -> wall_overhead / 1000 : 0 );
+
+    while ( ( ret = read_line( w, line, killed ? -1 :
+                               deadline - phase_clock() / 1000000 + 1 ) ) == -1 ) {
+        kill( pid, SIGKILL );
+        killed = 1;
+    }
+
+    gettimeofday( &( resp -> end ), NULL );
+    if ( ret == 0 || sscanf( line, "DONE %d %lld %lld %lld %lld",
+                                  &status, &user, &sys, &mem, &rss ) != 5 ) {
+        // The server is gone
+        status = kill_server( w );
+        user = ( resp -> end.tv_sec - resp -> start.tv_sec ) * 1000000LL +
+            resp -> end.tv_usec - resp -> start.tv_usec;
+        sys = mem = rss = 0;
+    }
+
+    set_tv( &( resp -> ru.ru_utime ), user );
+    set_tv( &( resp -> ru.ru_stime ), sys );
+    resp -> ru.ru_minflt = mem * 1024 / getpagesize();
+    resp -> ru.ru_maxrss = rss;
+    if ( stat( output, &st ) == 0 ) resp -> out_bytes = st.st_size;
+
+    if ( killed ) return RES_TLE;
+
+    ret = WIFEXITED( status ) ? RES_NORMAL : RES_SE;
+    if ( ret == RES_NORMAL ) {
+        if ( ( rc -> corrected ? time_corrected( resp, rc ) : time_used( resp ) ) >= rc -> time_limit )
+            return RES_TLE;
+        if ( mem_used( resp ) >= rc -> mem_limit ) return RES_MLE;
+    }
+
+    if ( rc -> out_limit > 0 && resp -> out_bytes > ( (long long)rc -> out_limit << 10 ) )
+        return RES_OLE;
+
+    return ret;
+}
+
+long long warm_startup( int inx )
+{
+    return ( inx < num_servers ? servers[inx].startup_us : -1 );
+}
+
+void warm_stop()
+{
+    int i;
+
+    for ( i = 0; i < num_servers; ++i )
+        kill_server( servers + i );
+
+    free( servers );
+    servers = NULL;
+    num_servers = 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Warm runtimes: a Python program is loaded once by a server process,
+ * which then runs every case in a fresh context with the case's input and output.
+ * Each case pays for the program only, the startup is paid and shown once.
+ * By richardxx, 2009.6
+ */
+
+#ifndef WARM_H
+#define WARM_H
+
+#include "type_def.h"
+
+struct RESCONS;
+struct RESUSE;
+
+// Kinds of programs
+#define WARM_NONE		0
+#define WARM_PYTHON		1
+
+// Which runtime Arg1 needs: a .py script is Python, others run cold
+extern
+int warm_kind( const char* );
+
+/*
+ * Start a server for every program having a runtime, and print its startup time.
+ * Return 0 if one of them couldn't be started.
+ */
+extern
+int warm_start( struct sys_arg_t* );
+
+/*
+ * Run program Arg1 on the input Arg2, writing the output Arg3, in its warm runtime.
+ * Limits and usage are the ones of run_program.
+ * Return -1 if the program has no warm runtime, otherwise the system code.
+ */
+extern
+int warm_run( int, const char*, const char*, struct RESCONS*, struct RESUSE* );
+
+// Startup time of the runtime of program Arg1 in us, -1 if it has none
+extern
+long long warm_startup( int );
+
+// Kill all servers
+extern
+void warm_stop();
+
+#endif